@@ -0,0 +1,68 @@
+#ifndef ALIGNED_ALLOCATOR_H_
+#define ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace ogle
+{
+    // Wide enough for a full AVX-512 register, and a cache line.
+    static const size_t SimdAlignment = 64;
+    // floats per SimdAlignment bytes, streams are padded to a multiple of this
+    static const size_t SimdWidth = SimdAlignment / sizeof(float);
+
+    /**
+    *   std::vector allocator that hands out Alignment aligned storage, so
+    *   kernels can use aligned loads from the first element on.
+    */
+    template <typename T, size_t Alignment = SimdAlignment>
+    class AlignedAllocator
+    {
+    public:
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+        AlignedAllocator() {}
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+        T* allocate(size_t count)
+        {
+            if (count == 0)
+                return 0;
+            void* data = 0;
+#ifdef _WIN32
+            data = _aligned_malloc(count * sizeof(T), Alignment);
+#else
+            if (posix_memalign(&data, Alignment, count * sizeof(T)) != 0)
+                data = 0;
+#endif
+            if (!data)
+                throw std::bad_alloc();
+            return static_cast<T*>(data);
+        }
+
+        void deallocate(T* data, size_t)
+        {
+#ifdef _WIN32
+            _aligned_free(data);
+#else
+            free(data);
+#endif
+        }
+    };
+
+    template <typename T, typename U, size_t Alignment>
+    bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return true; }
+    template <typename T, typename U, size_t Alignment>
+    bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return false; }
+}
+
+#endif // ALIGNED_ALLOCATOR_H_
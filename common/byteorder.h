@@ -0,0 +1,21 @@
+#ifndef BYTE_ORDER_H_
+#define BYTE_ORDER_H_
+
+#include <stdint.h>
+
+namespace ogle
+{
+    // For binary files written in a fixed byte order (ply says which, stl is little endian).
+    inline bool hostIsLittleEndian()
+    {
+        const uint16_t one = 1;
+        return *(const uint8_t*)&one == 1;
+    }
+
+    inline uint32_t swapBytes(uint32_t v)
+    {
+        return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+    }
+}
+
+#endif // BYTE_ORDER_H_
@@ -0,0 +1,99 @@
+#include "framearena.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+
+using namespace ogle;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameArena::FrameArena(size_t capacity)
+    : Block(0)
+    , Capacity(capacity)
+    , Used(0)
+    , FrameAllocations(0)
+    , OverflowBytes(0)
+{
+    memset(&Counters, 0, sizeof(Counters));
+    Block = static_cast<char*>(malloc(Capacity));
+    if (!Block)
+        throw std::bad_alloc();
+}
+
+FrameArena::~FrameArena()
+{
+    for (size_t i = 0; i < Overflow.size(); ++i)
+        free(Overflow[i]);
+    free(Block);
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment)
+{
+    if (bytes == 0)
+        return 0;
+
+    ++Counters.allocations;
+    ++FrameAllocations;
+
+    alignment = std::max(alignment, (size_t)1);
+    uintptr_t base = (uintptr_t)Block;
+    size_t offset = alignUp(base + Used, alignment) - base;
+    if (offset + bytes <= Capacity) {
+        Used = offset + bytes;
+        return Block + offset;
+    }
+
+    // doesn't fit this frame, the next reset makes room for it
+    void* spill = malloc(bytes + alignment);
+    if (!spill)
+        throw std::bad_alloc();
+    Overflow.push_back(spill);
+    OverflowBytes += bytes + alignment;
+    ++Counters.overflowAllocations;
+    return (void*)alignUp((uintptr_t)spill, alignment);
+}
+
+void FrameArena::reset()
+{
+    size_t frameBytes = Used + OverflowBytes;
+    Counters.highWater = std::max(Counters.highWater, frameBytes);
+    Counters.frameAllocations = FrameAllocations;
+    ++Counters.frames;
+
+    if (!Overflow.empty()) {
+        for (size_t i = 0; i < Overflow.size(); ++i)
+            free(Overflow[i]);
+        Overflow.clear();
+
+        // room for the worst frame so far plus alignment slack, in one block
+        size_t capacity = std::max(Capacity * 2, alignUp(Counters.highWater + Counters.highWater / 8, 4096));
+        char* block = static_cast<char*>(malloc(capacity));
+        if (block) {
+            free(Block);
+            Block = block;
+            Capacity = capacity;
+        }
+    }
+
+    Used = 0;
+    OverflowBytes = 0;
+    FrameAllocations = 0;
+}
+
+size_t FrameArena::getUsed() const
+{
+    return Used + OverflowBytes;
+}
+
+FrameArena::Stats FrameArena::getStats() const
+{
+    Stats stats = Counters;
+    stats.capacity = Capacity;
+    return stats;
+}
@@ -0,0 +1,103 @@
+#ifndef FRAME_ARENA_H_
+#define FRAME_ARENA_H_
+
+#include <cstddef>
+#include <vector>
+#include <string>
+
+namespace ogle
+{
+    /**
+    *   Linear scratch memory for things that only live until the end of the
+    *   frame. Allocating bumps a pointer, freeing does nothing, and reset()
+    *   at the end of the frame hands everything back at once.
+    *
+    *   A frame that needs more than the block holds spills into heap blocks,
+    *   the next reset() grows the block to the high-water mark and frees
+    *   them, so a steady frame settles into the one block and never mallocs.
+    *
+    *   Not thread safe, it belongs to the thread running the frame loop.
+    */
+    class FrameArena
+    {
+    public:
+        struct Stats
+        {
+            size_t frames;              // resets so far
+            size_t allocations;         // over every frame
+            size_t frameAllocations;    // in the last finished frame
+            size_t overflowAllocations; // ones that didn't fit the block and went to the heap
+            size_t highWater;           // most bytes any frame has used
+            size_t capacity;            // size of the block
+        };
+
+        explicit FrameArena(size_t capacity = DefaultCapacity);
+        ~FrameArena();
+
+        // Null only when bytes is 0.
+        void* allocate(size_t bytes, size_t alignment = DefaultAlignment);
+
+        template <typename T>
+        T* allocate(size_t count)
+        {
+            return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        }
+
+        // Ends the frame, everything handed out since the last reset is gone.
+        void reset();
+
+        size_t getUsed() const;
+        Stats getStats() const;
+
+        static const size_t DefaultCapacity = 1024 * 1024;
+        static const size_t DefaultAlignment = 16;
+
+    private:
+        FrameArena(const FrameArena& other);
+        FrameArena& operator=(const FrameArena& other);
+
+        char* Block;
+        size_t Capacity;
+        size_t Used;
+        size_t FrameAllocations;
+        std::vector<void*> Overflow;
+        size_t OverflowBytes;
+        Stats Counters;
+    };
+
+    /**
+    *   Standard allocator drawing from a FrameArena, for containers that
+    *   don't outlive the frame. deallocate() is a no-op, the arena gets the
+    *   memory back on reset.
+    */
+    template <typename T>
+    class FrameAllocator
+    {
+    public:
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind { typedef FrameAllocator<U> other; };
+
+        explicit FrameAllocator(FrameArena& arena) : Arena(&arena) {}
+        template <typename U>
+        FrameAllocator(const FrameAllocator<U>& other) : Arena(other.getArena()) {}
+
+        T* allocate(size_t count) { return Arena->allocate<T>(count); }
+        void deallocate(T*, size_t) {}
+
+        FrameArena* getArena() const { return Arena; }
+
+    private:
+        FrameArena* Arena;
+    };
+
+    template <typename T, typename U>
+    bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.getArena() == b.getArena(); }
+    template <typename T, typename U>
+    bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.getArena() != b.getArena(); }
+
+    typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char> > FrameString;
+}
+
+#endif // FRAME_ARENA_H_
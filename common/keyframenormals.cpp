@@ -0,0 +1,100 @@
+#include "keyframenormals.h"
+
+#include <cmath>
+#include <vector>
+
+#include "meshbuffer.h"
+#include "normalengine.h"
+
+using namespace ogle;
+
+const float KeyframeNormals::QuantizedErrorBound = 1.0f / 1024.0f;
+
+static void normalizeAll(glm::vec3* norms, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i) {
+        glm::vec3& n = norms[i];
+        float lengthSq = n.x * n.x + n.y * n.y + n.z * n.z;
+        float scale = lengthSq > 0 ? 1.0f / std::sqrt(lengthSq) : 0.0f;
+        n *= scale;
+    }
+}
+
+KeyframeNormals::KeyframeNormals()
+{
+}
+
+void KeyframeNormals::build(const MeshSequence& keyframes, NormalEngine& engine, float errorBound)
+{
+    clear();
+
+    unsigned int vertCnt = keyframes.getVertCnt();
+    unsigned int frameCnt = keyframes.getFrameCnt();
+    if (frameCnt == 0)
+        return;
+
+    engine.setTopology(keyframes.getIndices().data(), keyframes.getIdxCnt(), vertCnt);
+
+    // kept like the positions, so sampling both goes the same way
+    if (errorBound <= 0)
+        Frames.setLayout(keyframes.getLayout());
+    Frames.reserve(frameCnt);
+
+    std::vector<glm::vec3> verts;
+    MeshBuffer normals;
+    for (unsigned int f = 0; f < frameCnt; ++f) {
+        keyframes.getFrame(f, verts);
+        normals.setVerts(vertCnt, (const float*)verts.data());
+        normals.setIndices(keyframes.getIdxCnt(), keyframes.getIndices().data());
+        // the normals go where the positions were, they are what the sequence blends
+        engine.generate(verts.data(), normals.getWritableVerts());
+        Frames.addFrame(normals);
+    }
+
+    if (errorBound > 0) {
+        QuantizedFrames.encode(Frames, errorBound);
+        Frames.clear();
+    }
+}
+
+void KeyframeNormals::clear()
+{
+    Frames.clear();
+    QuantizedFrames.clear();
+}
+
+unsigned int KeyframeNormals::getFrameCnt() const
+{
+    return QuantizedFrames.getFrameCnt() ? QuantizedFrames.getFrameCnt() : Frames.getFrameCnt();
+}
+
+unsigned int KeyframeNormals::getVertCnt() const
+{
+    return QuantizedFrames.getFrameCnt() ? QuantizedFrames.getVertCnt() : Frames.getVertCnt();
+}
+
+void KeyframeNormals::sample(float frame, bool loop, glm::vec3* norms) const
+{
+    if (QuantizedFrames.getFrameCnt())
+        QuantizedFrames.sample(frame, loop, norms);
+    else if (Frames.getFrameCnt())
+        Frames.sample(frame, loop, norms);
+    else
+        return;
+
+    normalizeAll(norms, getVertCnt());
+}
+
+void KeyframeNormals::sample(float frame, bool loop, VertexStreams& norms) const
+{
+    if (Frames.getFrameCnt() == 0)
+        return;
+
+    Frames.sample(frame, loop, norms);
+    normalizeStreams(norms);
+}
+
+size_t KeyframeNormals::getMemoryUsage() const
+{
+    return Frames.getMemoryUsage() + QuantizedFrames.getReport().encodedBytes;
+}
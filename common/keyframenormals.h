@@ -0,0 +1,54 @@
+#ifndef KEYFRAME_NORMALS_H_
+#define KEYFRAME_NORMALS_H_
+
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "meshsequence.h"
+#include "quantizedsequence.h"
+#include "vertexstreams.h"
+
+namespace ogle
+{
+    class NormalEngine;
+
+    /**
+    *   Normals of every keyframe of a sequence, worked out once when the
+    *   keyframes are in. Sampling blends the two keyframes' normals and
+    *   renormalizes (nlerp), instead of working normals out again from the
+    *   blended positions every frame.
+    *
+    *   The normals are kept as a sequence of their own, float in the same
+    *   layout as the positions, or quantized when those are.
+    */
+    class KeyframeNormals
+    {
+    public:
+        KeyframeNormals();
+
+        // Normals come from engine, in whatever mode it is set to. errorBound > 0
+        // keeps them quantized, any normal within that distance of its original.
+        void build(const MeshSequence& keyframes, NormalEngine& engine, float errorBound = 0);
+        void clear();
+
+        unsigned int getFrameCnt() const;
+        unsigned int getVertCnt() const;
+
+        // Same frame meaning as MeshSequence::sample. Unit length normals, zero
+        // where both keyframes' normals cancel out. Neither allocates.
+        void sample(float frame, bool loop, glm::vec3* norms) const;
+        // Float normals only, as sampling positions into streams is.
+        void sample(float frame, bool loop, VertexStreams& norms) const;
+
+        size_t getMemoryUsage() const;
+
+        // Error bound used for normals when the positions are quantized.
+        static const float QuantizedErrorBound;
+
+    private:
+        MeshSequence Frames;
+        QuantizedSequence QuantizedFrames;
+    };
+}
+
+#endif // KEYFRAME_NORMALS_H_
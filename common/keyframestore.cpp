@@ -0,0 +1,525 @@
+#include "keyframestore.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "meshbuffer.h"
+#include "meshsequence.h"
+#include "meshcache.h"
+
+using namespace std;
+using namespace ogle;
+
+const size_t KeyframeStore::FrameAlignment;
+
+namespace
+{
+    const char Magic[8] = {'O','G','L','E','K','E','Y','S'};
+    const uint32_t Version = 3;
+
+    struct PackHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t frameCount;
+        uint32_t vertCount;
+        uint32_t indexCount;
+        uint64_t framesOffset;
+        uint64_t frameStride;
+        // the sub-mesh table sits between the indices and the frames
+        uint32_t subMeshCount;
+        uint32_t subMeshBytes;
+    };
+    static_assert(sizeof(PackHeader) == 48, "keyframe pack header layout changed, bump Version");
+
+    // one per frame after the header, the file each was read from
+    struct PackSource
+    {
+        uint64_t size;
+        uint64_t hash;
+    };
+
+    const size_t DefaultBudget = 64 * 1024 * 1024;
+    const unsigned int DefaultPrefetchDistance = 4;
+    const unsigned int MinimumSlots = 3;
+}
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Whether the pack was built from exactly these sources, checked by size and content
+// the way MeshCache checks its sources (a time stamp can't tell edits in the same second apart).
+static bool packIsCurrent(const std::string& packFile, const std::vector<std::string>& sourceFiles)
+{
+    MappedFile pack;
+    if (!pack.open(packFile) || pack.size() < sizeof(PackHeader) + sourceFiles.size() * sizeof(PackSource))
+        return false;
+
+    PackHeader header;
+    memcpy(&header, pack.data(), sizeof(PackHeader));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.frameCount != sourceFiles.size())
+        return false;
+
+    for (size_t i = 0; i < sourceFiles.size(); ++i) {
+        PackSource recorded;
+        memcpy(&recorded, pack.data() + sizeof(PackHeader) + i * sizeof(PackSource), sizeof(PackSource));
+        uint64_t size, hash;
+        if (!MeshCache::fingerprint(sourceFiles[i], size, hash) || size != recorded.size || hash != recorded.hash)
+            return false;
+    }
+    return true;
+}
+
+// Whether frame is one of the count frames starting at first, wrapping when looping.
+static bool inWindow(unsigned int frame, unsigned int first, unsigned int count, unsigned int frameCnt, bool loop)
+{
+    unsigned int distance = (frame >= first) ? frame - first : (loop ? frame + frameCnt - first : frameCnt);
+    return distance < count;
+}
+
+bool KeyframeStore::build(const std::string& packFile, const std::vector<std::string>& sourceFiles)
+{
+    if (sourceFiles.empty())
+        return false;
+
+    if (packIsCurrent(packFile, sourceFiles))
+        return true;
+
+    std::string tempName = packFile + ".tmp";
+    ofstream outf(tempName.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+    if (!outf.is_open()) {
+        cerr << "[!] Failed to write keyframe pack: " << packFile << endl;
+        return false;
+    }
+
+    PackHeader header;
+    memset(&header, 0, sizeof(PackHeader));
+    std::vector<PackSource> sources(sourceFiles.size());
+    size_t sourceBytes = sources.size() * sizeof(PackSource);
+    std::vector<uint32_t> indices;
+    std::vector<char> subMeshes;
+    std::vector<char> padding(FrameAlignment, 0);
+
+    // only one frame is ever held in memory
+    bool ok = true;
+    for (size_t i = 0; i < sourceFiles.size() && ok; ++i) {
+        // taken before the load, a source that changes under it gets the pack rebuilt next time
+        MeshBuffer frame;
+        if (!MeshCache::fingerprint(sourceFiles[i], sources[i].size, sources[i].hash) || !frame.loadFile(sourceFiles[i].c_str())) {
+            cerr << "[!] Failed to load keyframe: " << sourceFiles[i] << endl;
+            ok = false;
+            break;
+        }
+
+        if (i == 0) {
+            memcpy(header.magic, Magic, sizeof(Magic));
+            header.version = Version;
+            header.frameCount = (uint32_t)sourceFiles.size();
+            header.vertCount = frame.getVertCnt();
+            header.indexCount = frame.getIdxCnt();
+            packSubMeshes(frame.getSubMeshes(), subMeshes);
+            header.subMeshCount = (uint32_t)frame.getSubMeshes().size();
+            header.subMeshBytes = (uint32_t)subMeshes.size();
+            size_t tableEnd = sizeof(PackHeader) + sourceBytes + header.indexCount * sizeof(uint32_t) + subMeshes.size();
+            header.framesOffset = alignUp(tableEnd, FrameAlignment);
+            header.frameStride = alignUp(header.vertCount * sizeof(glm::vec3), FrameAlignment);
+            indices = frame.getIndices();
+
+            outf.write((const char*)&header, sizeof(PackHeader));
+            // filled in once every source has been read
+            outf.write((const char*)sources.data(), sourceBytes);
+            outf.write((const char*)indices.data(), indices.size() * sizeof(uint32_t));
+            outf.write(subMeshes.data(), subMeshes.size());
+            outf.write(padding.data(), header.framesOffset - tableEnd);
+        }
+        else if (frame.getVertCnt() != header.vertCount || frame.getIndices() != indices) {
+            cerr << "[!] Keyframe does not share the topology of the first: " << sourceFiles[i] << endl;
+            ok = false;
+            break;
+        }
+
+        size_t frameBytes = header.vertCount * sizeof(glm::vec3);
+        outf.write((const char*)frame.getVerts().data(), frameBytes);
+        outf.write(padding.data(), header.frameStride - frameBytes);
+    }
+
+    if (ok) {
+        outf.seekp(sizeof(PackHeader));
+        outf.write((const char*)sources.data(), sourceBytes);
+    }
+    ok = ok && outf.good();
+    outf.close();
+
+#ifdef _WIN32
+    // rename does not replace an existing file on windows
+    if (ok)
+        remove(packFile.c_str());
+#endif
+    if (!ok || rename(tempName.c_str(), packFile.c_str()) != 0) {
+        remove(tempName.c_str());
+        cerr << "[!] Failed to write keyframe pack: " << packFile << endl;
+        return false;
+    }
+    return true;
+}
+
+KeyframeStore::KeyframeStore()
+    : FrameCnt(0)
+    , VertCnt(0)
+    , FramesOffset(0)
+    , FrameStride(0)
+    , Budget(DefaultBudget)
+    , PrefetchDistance(DefaultPrefetchDistance)
+    , UseClock(0)
+    , PlayheadFrame(0)
+    , PlayheadLoops(true)
+    , PlayheadMoved(false)
+    , Stopping(false)
+{
+    memset(&Counters, 0, sizeof(Counters));
+}
+
+KeyframeStore::~KeyframeStore()
+{
+    close();
+}
+
+bool KeyframeStore::open(const std::string& packFile)
+{
+    close();
+
+    if (!File.open(packFile) || File.size() < sizeof(PackHeader)) {
+        cerr << "[!] Failed to open keyframe pack: " << packFile << endl;
+        File.close();
+        return false;
+    }
+
+    PackHeader header;
+    memcpy(&header, File.data(), sizeof(PackHeader));
+    uint64_t indexStart = sizeof(PackHeader) + (uint64_t)header.frameCount * sizeof(PackSource);
+    uint64_t indexEnd = indexStart + (uint64_t)header.indexCount * sizeof(uint32_t);
+    uint64_t tableEnd = indexEnd + header.subMeshBytes;
+    uint64_t frameBytes = (uint64_t)header.vertCount * sizeof(glm::vec3);
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version
+        || header.framesOffset < tableEnd || header.frameStride < frameBytes
+        || header.framesOffset + header.frameCount * header.frameStride > File.size()) {
+        cerr << "[!] Keyframe pack is damaged or out of date: " << packFile << endl;
+        File.close();
+        return false;
+    }
+
+    FrameCnt = header.frameCount;
+    VertCnt = header.vertCount;
+    FramesOffset = (size_t)header.framesOffset;
+    FrameStride = (size_t)header.frameStride;
+    Indices.resize(header.indexCount);
+    if (header.indexCount)
+        memcpy(&Indices[0], File.data() + indexStart, header.indexCount * sizeof(uint32_t));
+    if (!unpackSubMeshes(File.data() + indexEnd, header.subMeshBytes, header.subMeshCount, SubMeshes)
+        || !validSubMeshes(SubMeshes, header.indexCount)) {
+        cerr << "[!] Keyframe pack is damaged or out of date: " << packFile << endl;
+        File.close();
+        std::vector<uint32_t>().swap(Indices);
+        return false;
+    }
+    File.release(0, FramesOffset);
+
+    memset(&Counters, 0, sizeof(Counters));
+    UseClock = 0;
+    PlayheadFrame = 0;
+    PlayheadMoved = false;
+    Stopping = false;
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        resize(lock);
+    }
+    Prefetcher = std::thread(&KeyframeStore::prefetchLoop, this);
+    return true;
+}
+
+void KeyframeStore::close()
+{
+    if (Prefetcher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Stopping = true;
+        }
+        Condition.notify_all();
+        Prefetcher.join();
+    }
+
+    File.close();
+    FrameCnt = 0;
+    VertCnt = 0;
+    std::vector<uint32_t>().swap(Indices);
+    SubMeshList().swap(SubMeshes);
+    std::vector<Slot>().swap(Slots);
+}
+
+void KeyframeStore::setMemoryBudget(size_t bytes)
+{
+    std::unique_lock<std::mutex> lock(Mutex);
+    Budget = bytes;
+    resize(lock);
+}
+
+void KeyframeStore::setPrefetchDistance(unsigned int frames)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        PrefetchDistance = frames;
+        PlayheadMoved = true;
+    }
+    Condition.notify_all();
+}
+
+unsigned int KeyframeStore::getFrameCnt() const
+{
+    return FrameCnt;
+}
+
+unsigned int KeyframeStore::getVertCnt() const
+{
+    return VertCnt;
+}
+
+const std::vector<uint32_t>& KeyframeStore::getIndices() const
+{
+    return Indices;
+}
+
+const SubMeshList& KeyframeStore::getSubMeshes() const
+{
+    return SubMeshes;
+}
+
+void KeyframeStore::resize(std::unique_lock<std::mutex>& lock)
+{
+    if (FrameCnt == 0)
+        return;
+
+    // slots can't move while one is being filled or read
+    Condition.wait(lock, [this]() {
+        for (size_t i = 0; i < Slots.size(); ++i)
+            if (Slots[i].loading || Slots[i].pins) return false;
+        return true;
+    });
+
+    size_t frameBytes = std::max<size_t>(1, VertCnt * sizeof(glm::vec3));
+    size_t slotCount = std::min<size_t>(FrameCnt, Budget / frameBytes);
+    slotCount = std::max<size_t>(slotCount, MinimumSlots);
+    if (slotCount == Slots.size())
+        return;
+
+    // keep the most recently used frames when shrinking
+    std::sort(Slots.begin(), Slots.end(), [](const Slot& a, const Slot& b) {
+        return a.lastUse > b.lastUse;
+    });
+    for (size_t i = slotCount; i < Slots.size(); ++i)
+        if (Slots[i].frame >= 0)
+            ++Counters.evictions;
+    Slots.resize(slotCount);
+}
+
+int KeyframeStore::findSlot(unsigned int frame) const
+{
+    for (size_t i = 0; i < Slots.size(); ++i)
+        if (Slots[i].frame == (int)frame)
+            return (int)i;
+    return -1;
+}
+
+int KeyframeStore::pickVictim(unsigned int keepFirst, unsigned int keepCount, bool loop) const
+{
+    int victim = -1;
+    for (size_t i = 0; i < Slots.size(); ++i) {
+        const Slot& slot = Slots[i];
+        if (slot.loading || slot.pins)
+            continue;
+        if (slot.frame < 0)
+            return (int)i;
+        if (inWindow(slot.frame, keepFirst, keepCount, FrameCnt, loop))
+            continue;
+        if (victim < 0 || slot.lastUse < Slots[victim].lastUse)
+            victim = (int)i;
+    }
+    return victim;
+}
+
+void KeyframeStore::readFrame(unsigned int frame, std::vector<glm::vec3>& positions)
+{
+    size_t offset = FramesOffset + frame * FrameStride;
+    positions.resize(VertCnt);
+    if (VertCnt)
+        memcpy(&positions[0], File.data() + offset, VertCnt * sizeof(glm::vec3));
+
+    // the copy is what counts against the budget, not the mapping
+    File.release(offset, FrameStride);
+}
+
+int KeyframeStore::acquire(unsigned int frame, std::unique_lock<std::mutex>& lock, unsigned int keepFirst, unsigned int keepCount, bool loop)
+{
+    bool waited = false;
+    while (true) {
+        int found = findSlot(frame);
+        if (found >= 0 && Slots[found].loading) {
+            waited = true;
+            Condition.wait(lock);
+            continue;
+        }
+        if (found >= 0) {
+            if (waited) ++Counters.waits;
+            else ++Counters.hits;
+            Slots[found].lastUse = ++UseClock;
+            ++Slots[found].pins;
+            return found;
+        }
+
+        int victim = pickVictim(keepFirst, keepCount, loop);
+        if (victim < 0) {
+            // every slot is pinned or being filled, one frees up when the prefetch lands
+            Condition.wait(lock);
+            continue;
+        }
+
+        // read it right here, holding the lock keeps the prefetch thread from racing for the frame
+        Slot& slot = Slots[victim];
+        if (slot.frame >= 0)
+            ++Counters.evictions;
+        slot.frame = (int)frame;
+        readFrame(frame, slot.positions);
+        slot.lastUse = ++UseClock;
+        ++slot.pins;
+        ++Counters.misses;
+        return victim;
+    }
+}
+
+void KeyframeStore::setPlayhead(float frame, bool loop)
+{
+    if (FrameCnt == 0)
+        return;
+
+    unsigned int frameA, frameB;
+    float tween;
+    MeshSequence::findKeyframes(frame, loop, FrameCnt, frameA, frameB, tween);
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (frameA == PlayheadFrame && loop == PlayheadLoops)
+            return;
+        PlayheadFrame = frameA;
+        PlayheadLoops = loop;
+        PlayheadMoved = true;
+    }
+    Condition.notify_all();
+}
+
+void KeyframeStore::prefetchLoop()
+{
+    std::unique_lock<std::mutex> lock(Mutex);
+    while (true) {
+        Condition.wait(lock, [this]() { return Stopping || PlayheadMoved; });
+        if (Stopping)
+            return;
+        PlayheadMoved = false;
+
+        // leave at least one slot for whatever gets sampled off the playhead
+        unsigned int first = PlayheadFrame;
+        bool loop = PlayheadLoops;
+        unsigned int count = std::min<unsigned int>(PrefetchDistance + 1, (unsigned int)Slots.size() - 1);
+        count = std::min(count, FrameCnt);
+
+        for (unsigned int k = 0; k < count && !PlayheadMoved && !Stopping; ++k) {
+            unsigned int frame = first + k;
+            if (frame >= FrameCnt) {
+                if (!loop) break;
+                frame -= FrameCnt;
+            }
+            if (findSlot(frame) >= 0)
+                continue;
+
+            int victim = pickVictim(first, count, loop);
+            if (victim < 0)
+                break;
+
+            Slot& slot = Slots[victim];
+            if (slot.frame >= 0)
+                ++Counters.evictions;
+            slot.frame = (int)frame;
+            slot.loading = true;
+
+            lock.unlock();
+            readFrame(frame, slot.positions);
+            lock.lock();
+
+            slot.loading = false;
+            slot.lastUse = ++UseClock;
+            ++Counters.prefetches;
+            Condition.notify_all();
+        }
+    }
+}
+
+void KeyframeStore::sample(float frame, bool loop, std::vector<glm::vec3>& verts)
+{
+    verts.resize(FrameCnt ? VertCnt : 0);
+    if (FrameCnt)
+        sample(frame, loop, verts.data());
+}
+
+void KeyframeStore::sample(float frame, bool loop, glm::vec3* verts)
+{
+    if (FrameCnt == 0)
+        return;
+
+    unsigned int frameA, frameB;
+    float tween;
+    MeshSequence::findKeyframes(frame, loop, FrameCnt, frameA, frameB, tween);
+    unsigned int keepCount = (frameA == frameB) ? 1 : 2;
+
+    std::unique_lock<std::mutex> lock(Mutex);
+    int slotA = acquire(frameA, lock, frameA, keepCount, loop);
+    int slotB = acquire(frameB, lock, frameA, keepCount, loop);
+
+    const glm::vec3* vertsA = Slots[slotA].positions.data();
+    const glm::vec3* vertsB = Slots[slotB].positions.data();
+    for (unsigned int i = 0; i < VertCnt; ++i)
+        verts[i] = tween * (vertsB[i] - vertsA[i]) + vertsA[i];
+
+    --Slots[slotA].pins;
+    --Slots[slotB].pins;
+    Condition.notify_all();
+}
+
+void KeyframeStore::makeMesh(unsigned int frame, MeshBuffer& mesh)
+{
+    if (frame >= FrameCnt)
+        return;
+
+    std::unique_lock<std::mutex> lock(Mutex);
+    int slot = acquire(frame, lock, frame, 1, false);
+    mesh.setVerts(VertCnt, (const float*)Slots[slot].positions.data());
+    mesh.setIndices((unsigned int)Indices.size(), Indices.data());
+    mesh.setSubMeshes(SubMeshes);
+    --Slots[slot].pins;
+    Condition.notify_all();
+}
+
+KeyframeStore::Stats KeyframeStore::getStats() const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Stats stats = Counters;
+    for (size_t i = 0; i < Slots.size(); ++i) {
+        if (Slots[i].frame >= 0 && !Slots[i].loading) {
+            ++stats.residentFrames;
+            stats.residentBytes += Slots[i].positions.capacity() * sizeof(glm::vec3);
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,130 @@
+#ifndef KEYFRAME_STORE_H_
+#define KEYFRAME_STORE_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "mappedfile.h"
+#include "submesh.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    /**
+    *   Keyframes paged in from a memory mapped pack file, for sequences too
+    *   long to keep resident.
+    *
+    *   Only a budget's worth of frames is copied out of the mapping at a time,
+    *   the least recently used one makes room for the next. A background
+    *   thread keeps the frames ahead of the playhead resident, so steady
+    *   playback only ever hits frames that are already in.
+    *
+    *   Pack layout, all values in native byte order:
+    *       Header
+    *       sources     frameCount * (size, content hash) of the files the frames came from
+    *       indices     idxCount * uint32
+    *       sub-meshes  subMeshCount packed ranges
+    *       frames      frameCount * vertCount * 3 floats, each frame starting on a FrameAlignment boundary
+    */
+    class KeyframeStore
+    {
+    public:
+        struct Stats
+        {
+            size_t hits;            // frame was resident when sampled
+            size_t misses;          // frame had to be read in by the sampling thread
+            size_t waits;           // frame was still being prefetched when sampled
+            size_t prefetches;      // frames read in by the prefetch thread
+            size_t evictions;
+            unsigned int residentFrames;
+            size_t residentBytes;
+        };
+
+        KeyframeStore();
+        ~KeyframeStore();
+
+        // Writes a pack from obj (or cached) keyframes, reading one at a time.
+        // Skipped when the pack was built from sources of the same size and content.
+        static bool build(const std::string& packFile, const std::vector<std::string>& sourceFiles);
+
+        bool open(const std::string& packFile);
+        void close();
+
+        // Bytes of frame data kept resident, never less than the two frames a blend needs.
+        void setMemoryBudget(size_t bytes);
+        // How many frames past the playhead the prefetch thread keeps resident.
+        void setPrefetchDistance(unsigned int frames);
+
+        unsigned int getFrameCnt() const;
+        unsigned int getVertCnt() const;
+        const std::vector<uint32_t>& getIndices() const;
+        const SubMeshList& getSubMeshes() const;
+
+        // Tells the prefetch thread where playback is, frame is fractional as in MeshSequence::sample.
+        void setPlayhead(float frame, bool loop);
+
+        void sample(float frame, bool loop, std::vector<glm::vec3>& verts);
+        // Into caller owned storage of getVertCnt() positions, doesn't allocate once the resident set is warm.
+        void sample(float frame, bool loop, glm::vec3* verts);
+        void makeMesh(unsigned int frame, MeshBuffer& mesh);
+
+        Stats getStats() const;
+
+        static const size_t FrameAlignment = 4096;
+
+    private:
+        KeyframeStore(const KeyframeStore& other);
+        KeyframeStore& operator=(const KeyframeStore& other);
+
+        struct Slot
+        {
+            Slot() : frame(-1), loading(false), pins(0), lastUse(0) {}
+
+            int frame;              // -1 when empty
+            bool loading;           // being filled by the prefetch thread
+            unsigned int pins;      // being read by sample or makeMesh
+            uint64_t lastUse;
+            std::vector<glm::vec3> positions;
+        };
+
+        // all of these expect Mutex to be held
+        int findSlot(unsigned int frame) const;
+        int pickVictim(unsigned int keepFirst, unsigned int keepCount, bool loop) const;
+        int acquire(unsigned int frame, std::unique_lock<std::mutex>& lock, unsigned int keepFirst, unsigned int keepCount, bool loop);
+        void resize(std::unique_lock<std::mutex>& lock);
+
+        void readFrame(unsigned int frame, std::vector<glm::vec3>& positions);
+        void prefetchLoop();
+
+        MappedFile File;
+        unsigned int FrameCnt;
+        unsigned int VertCnt;
+        size_t FramesOffset;
+        size_t FrameStride;
+        std::vector<uint32_t> Indices;
+        SubMeshList SubMeshes;
+
+        size_t Budget;
+        unsigned int PrefetchDistance;
+        std::vector<Slot> Slots;
+        uint64_t UseClock;
+        Stats Counters;
+
+        unsigned int PlayheadFrame;
+        bool PlayheadLoops;
+        bool PlayheadMoved;
+        bool Stopping;
+
+        mutable std::mutex Mutex;
+        std::condition_variable Condition;
+        std::thread Prefetcher;
+    };
+}
+
+#endif // KEYFRAME_STORE_H_
@@ -0,0 +1,438 @@
+#include "lodchain.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "meshbuffer.h"
+#include "meshsequence.h"
+
+using namespace ogle;
+
+const unsigned int LodChain::DefaultLevels;
+const unsigned int LodChain::MaxErrorFrames;
+const float LodChain::Hysteresis = 0.25f;
+
+namespace
+{
+    // Sum of squared distances to planes, p'Ap + 2b.p + c, each plane weighted
+    // by its face's area. Divided by weight it is the mean squared distance.
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+    };
+
+    void addPlane(Quadric& q, const glm::vec3& normal, const glm::vec3& point, double weight)
+    {
+        double x = normal.x, y = normal.y, z = normal.z;
+        double d = -(x * point.x + y * point.y + z * point.z);
+        q.a00 += weight * x * x; q.a01 += weight * x * y; q.a02 += weight * x * z;
+        q.a11 += weight * y * y; q.a12 += weight * y * z; q.a22 += weight * z * z;
+        q.b0 += weight * d * x; q.b1 += weight * d * y; q.b2 += weight * d * z;
+        q.c += weight * d * d;
+        q.weight += weight;
+    }
+
+    void addQuadric(Quadric& q, const Quadric& other)
+    {
+        q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+        q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+        q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+        q.c += other.c;
+        q.weight += other.weight;
+    }
+
+    double evaluate(const Quadric& q, const glm::vec3& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+                 + 2 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+                 + 2 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+        return std::fabs(r);
+    }
+
+    uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+    }
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double error;       // mean squared distance
+        bool operator<(const Collapse& other) const { return error < other.error; }
+    };
+
+    // Edge collapses over a set of poses that share triangles, quadrics carry on from one call to the next.
+    class Simplifier
+    {
+    public:
+        Simplifier(const std::vector<std::vector<glm::vec3> >& poses, unsigned int vertCnt)
+            : Poses(poses)
+            , VertCnt(vertCnt)
+        {
+        }
+
+        void setTriangles(const std::vector<uint32_t>& tris)
+        {
+            Quadric zero = Quadric();
+            Quadrics.assign(Poses.size() * VertCnt, zero);
+            findBorders(tris);
+
+            for (size_t p = 0; p < Poses.size(); ++p) {
+                const glm::vec3* verts = Poses[p].data();
+                Quadric* quadrics = &Quadrics[p * VertCnt];
+
+                for (size_t i = 0; i < tris.size(); i += 3) {
+                    const uint32_t* tri = &tris[i];
+                    glm::vec3 n = glm::cross(verts[tri[1]] - verts[tri[0]], verts[tri[2]] - verts[tri[0]]);
+                    float area = glm::length(n);
+                    if (area == 0)
+                        continue;
+                    n /= area;
+
+                    Quadric face = Quadric();
+                    addPlane(face, n, verts[tri[0]], area * 0.5);
+                    for (int k = 0; k < 3; ++k)
+                        addQuadric(quadrics[tri[k]], face);
+
+                    // borders also keep to the plane standing up from them, so they hold their shape
+                    for (int k = 0; k < 3; ++k) {
+                        uint32_t a = tri[k], b = tri[(k + 1) % 3];
+                        if (!isBorderEdge(a, b))
+                            continue;
+                        glm::vec3 edge = verts[b] - verts[a];
+                        float length = glm::length(edge);
+                        if (length == 0)
+                            continue;
+                        glm::vec3 side = glm::normalize(glm::cross(edge, n));
+                        Quadric border = Quadric();
+                        addPlane(border, side, verts[a], length * length);
+                        addQuadric(quadrics[a], border);
+                        addQuadric(quadrics[b], border);
+                    }
+                }
+            }
+        }
+
+        // Collapses edges until tris is down to target triangles, or the next
+        // collapse would be off by more than maxError. Returns the largest error made.
+        // Triangles that stay keep their order, origins (one per triangle) is
+        // dropped along with them when given.
+        float simplify(std::vector<uint32_t>& tris, unsigned int target, float maxError, std::vector<uint32_t>* origins = 0)
+        {
+            double maxErrorSq = (double)maxError * maxError;
+            double worst = 0;
+            std::vector<uint32_t> remap(VertCnt);
+            std::vector<bool> locked(VertCnt);
+            std::vector<Collapse> collapses;
+
+            while (tris.size() / 3 > target) {
+                findBorders(tris);
+                buildAdjacency(tris);
+
+                collapses.clear();
+                for (uint32_t u = 0; u < VertCnt; ++u) {
+                    Collapse best = { u, u, 0 };
+                    for (uint32_t k = FaceStart[u]; k < FaceStart[u + 1]; ++k) {
+                        const uint32_t* tri = &tris[3 * (size_t)VertexFaces[k]];
+                        for (int j = 0; j < 3; ++j) {
+                            uint32_t v = tri[j];
+                            if (v == u || (Border[u] && !isBorderEdge(u, v)))
+                                continue;
+                            double error = collapseError(u, v);
+                            if (best.to == u || error < best.error) {
+                                best.to = v;
+                                best.error = error;
+                            }
+                        }
+                    }
+                    if (best.to != u)
+                        collapses.push_back(best);
+                }
+                std::sort(collapses.begin(), collapses.end());
+
+                for (uint32_t v = 0; v < VertCnt; ++v)
+                    remap[v] = v;
+                locked.assign(VertCnt, false);
+
+                // a collapse takes two faces with it on a closed surface
+                size_t needed = tris.size() / 3 - target;
+                size_t removed = 0;
+                unsigned int made = 0;
+                for (size_t c = 0; c < collapses.size() && removed < needed; ++c) {
+                    const Collapse& collapse = collapses[c];
+                    if (maxErrorSq > 0 && collapse.error > maxErrorSq)
+                        break;
+                    uint32_t u = collapse.from;
+                    uint32_t v = collapse.to;
+                    if (locked[u] || locked[v] || flips(tris, u, v))
+                        continue;
+
+                    remap[u] = v;
+                    for (size_t p = 0; p < Poses.size(); ++p)
+                        addQuadric(Quadrics[p * VertCnt + v], Quadrics[p * VertCnt + u]);
+
+                    // nothing around u moves again this pass, its faces were checked as they are
+                    for (uint32_t k = FaceStart[u]; k < FaceStart[u + 1]; ++k) {
+                        const uint32_t* tri = &tris[3 * (size_t)VertexFaces[k]];
+                        removed += tri[0] == v || tri[1] == v || tri[2] == v;
+                        for (int j = 0; j < 3; ++j)
+                            locked[tri[j]] = true;
+                    }
+                    worst = std::max(worst, collapse.error);
+                    ++made;
+                }
+
+                if (made == 0)
+                    break;
+
+                size_t kept = 0;
+                for (size_t i = 0; i < tris.size(); i += 3) {
+                    uint32_t a = remap[tris[i]], b = remap[tris[i + 1]], c = remap[tris[i + 2]];
+                    if (a == b || b == c || a == c)
+                        continue;
+                    if (origins)
+                        (*origins)[kept / 3] = (*origins)[i / 3];
+                    tris[kept++] = a;
+                    tris[kept++] = b;
+                    tris[kept++] = c;
+                }
+                tris.resize(kept);
+                if (origins)
+                    origins->resize(kept / 3);
+            }
+
+            return (float)std::sqrt(worst);
+        }
+
+    private:
+        double collapseError(uint32_t u, uint32_t v) const
+        {
+            double error = 0;
+            double weight = 0;
+            for (size_t p = 0; p < Poses.size(); ++p) {
+                Quadric q = Quadrics[p * VertCnt + u];
+                addQuadric(q, Quadrics[p * VertCnt + v]);
+                error += evaluate(q, Poses[p][v]);
+                weight += q.weight;
+            }
+            return weight > 0 ? error / weight : 0;
+        }
+
+        // Would moving u onto v turn any of u's other faces over, in any pose.
+        bool flips(const std::vector<uint32_t>& tris, uint32_t u, uint32_t v) const
+        {
+            for (uint32_t k = FaceStart[u]; k < FaceStart[u + 1]; ++k) {
+                const uint32_t* tri = &tris[3 * (size_t)VertexFaces[k]];
+                if (tri[0] == v || tri[1] == v || tri[2] == v)
+                    continue;
+
+                int at = tri[0] == u ? 0 : tri[1] == u ? 1 : 2;
+                uint32_t a = tri[(at + 1) % 3];
+                uint32_t b = tri[(at + 2) % 3];
+                for (size_t p = 0; p < Poses.size(); ++p) {
+                    const glm::vec3* verts = Poses[p].data();
+                    glm::vec3 before = glm::cross(verts[a] - verts[u], verts[b] - verts[u]);
+                    glm::vec3 after = glm::cross(verts[a] - verts[v], verts[b] - verts[v]);
+                    if (glm::dot(before, after) <= 0)
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        void buildAdjacency(const std::vector<uint32_t>& tris)
+        {
+            FaceStart.assign(VertCnt + 1, 0);
+            for (size_t i = 0; i < tris.size(); ++i)
+                ++FaceStart[tris[i] + 1];
+            for (uint32_t v = 0; v < VertCnt; ++v)
+                FaceStart[v + 1] += FaceStart[v];
+
+            VertexFaces.resize(tris.size());
+            std::vector<uint32_t> fill(FaceStart.begin(), FaceStart.end() - 1);
+            for (size_t i = 0; i < tris.size(); ++i)
+                VertexFaces[fill[tris[i]]++] = (uint32_t)(i / 3);
+        }
+
+        // edges that don't have exactly two faces, and the vertices on them
+        void findBorders(const std::vector<uint32_t>& tris)
+        {
+            std::vector<uint64_t> edges(tris.size());
+            for (size_t i = 0; i < tris.size(); i += 3) {
+                for (int k = 0; k < 3; ++k)
+                    edges[i + k] = edgeKey(tris[i + k], tris[i + (k + 1) % 3]);
+            }
+            std::sort(edges.begin(), edges.end());
+
+            BorderEdges.clear();
+            Border.assign(VertCnt, false);
+            for (size_t i = 0; i < edges.size();) {
+                size_t end = i + 1;
+                while (end < edges.size() && edges[end] == edges[i])
+                    ++end;
+                if (end - i != 2) {
+                    BorderEdges.push_back(edges[i]);
+                    Border[(uint32_t)(edges[i] >> 32)] = true;
+                    Border[(uint32_t)edges[i]] = true;
+                }
+                i = end;
+            }
+        }
+
+        bool isBorderEdge(uint32_t a, uint32_t b) const
+        {
+            return std::binary_search(BorderEdges.begin(), BorderEdges.end(), edgeKey(a, b));
+        }
+
+        const std::vector<std::vector<glm::vec3> >& Poses;
+        unsigned int VertCnt;
+        std::vector<Quadric> Quadrics;      // every vertex's, pose after pose
+        std::vector<uint32_t> FaceStart;
+        std::vector<uint32_t> VertexFaces;
+        std::vector<uint64_t> BorderEdges;  // sorted
+        std::vector<bool> Border;
+    };
+}
+
+LodChain::LodChain()
+    : PixelError(1.0f)
+    , Current(0)
+{
+}
+
+void LodChain::build(const MeshBuffer& mesh, unsigned int levels, float ratio, float maxError)
+{
+    std::vector<std::vector<glm::vec3> > poses(1, mesh.getVerts());
+    build(mesh.getIndices().data(), mesh.getIdxCnt(), mesh.getVertCnt(), mesh.getSubMeshes(), poses, levels, ratio, maxError);
+}
+
+void LodChain::build(const MeshSequence& keyframes, unsigned int levels, float ratio, float maxError)
+{
+    // keyframes spread evenly over the sequence, first and last included
+    unsigned int frameCnt = keyframes.getFrameCnt();
+    unsigned int poseCnt = std::min(frameCnt, MaxErrorFrames);
+    std::vector<std::vector<glm::vec3> > poses(poseCnt);
+    for (unsigned int p = 0; p < poseCnt; ++p) {
+        unsigned int frame = poseCnt > 1 ? (p * (frameCnt - 1) + (poseCnt - 1) / 2) / (poseCnt - 1) : 0;
+        keyframes.getFrame(frame, poses[p]);
+    }
+
+    build(keyframes.getIndices().data(), keyframes.getIdxCnt(), keyframes.getVertCnt(), keyframes.getSubMeshes(), poses, levels, ratio, maxError);
+}
+
+void LodChain::build(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, const SubMeshList& subMeshes,
+    const std::vector<std::vector<glm::vec3> >& poses, unsigned int levels, float ratio, float maxError)
+{
+    clear();
+    idxCnt -= idxCnt % 3;
+    Indices.assign(indices, indices + idxCnt);
+    Level full = { 0, idxCnt, 0.0f };
+    Levels.push_back(full);
+    bool ranges = !subMeshes.empty() && validSubMeshes(subMeshes, idxCnt);
+    LevelSubMeshes.push_back(ranges ? subMeshes : SubMeshList());
+    if (poses.empty() || idxCnt == 0)
+        return;
+
+    std::vector<uint32_t> tris(Indices);
+    Simplifier simplifier(poses, vertCnt);
+    simplifier.setTriangles(tris);
+
+    // level 0 triangle every one of tris is, collapses keep the order so
+    // every structure's triangles stay together
+    std::vector<uint32_t> origins;
+    if (ranges) {
+        origins.resize(idxCnt / 3);
+        for (uint32_t t = 0; t < idxCnt / 3; ++t)
+            origins[t] = t;
+    }
+
+    for (unsigned int l = 1; l < levels; ++l) {
+        unsigned int target = (unsigned int)(tris.size() / 3 * ratio);
+        std::vector<uint32_t> next(tris);
+        std::vector<uint32_t> nextOrigins(origins);
+        float error = simplifier.simplify(next, target, maxError, ranges ? &nextOrigins : 0);
+
+        // not worth a level of its own
+        if (next.empty() || next.size() > tris.size() * 9 / 10)
+            break;
+
+        Level level = { (uint32_t)Indices.size(), (uint32_t)next.size(), std::max(Levels.back().error, error) };
+        Levels.push_back(level);
+        Indices.insert(Indices.end(), next.begin(), next.end());
+        tris.swap(next);
+        origins.swap(nextOrigins);
+
+        LevelSubMeshes.push_back(SubMeshList());
+        if (ranges) {
+            std::vector<uint32_t> keptBefore(idxCnt / 3 + 1, 0);
+            for (size_t t = 0; t < origins.size(); ++t)
+                keptBefore[origins[t] + 1] = 1;
+            for (size_t t = 1; t < keptBefore.size(); ++t)
+                keptBefore[t] += keptBefore[t - 1];
+
+            LevelSubMeshes.back() = shrinkSubMeshes(subMeshes, keptBefore);
+            for (size_t i = 0; i < LevelSubMeshes.back().size(); ++i)
+                LevelSubMeshes.back()[i].indexStart += level.indexStart;
+        }
+    }
+}
+
+void LodChain::clear()
+{
+    Levels.clear();
+    LevelSubMeshes.clear();
+    Indices.clear();
+    Current = 0;
+}
+
+unsigned int LodChain::getLevelCnt() const
+{
+    return (unsigned int)Levels.size();
+}
+
+const LodChain::Level& LodChain::getLevel(unsigned int level) const
+{
+    return Levels[level];
+}
+
+const SubMeshList& LodChain::getSubMeshes(unsigned int level) const
+{
+    return LevelSubMeshes[level];
+}
+
+const std::vector<uint32_t>& LodChain::getIndices() const
+{
+    return Indices;
+}
+
+void LodChain::setPixelError(float pixels)
+{
+    PixelError = pixels;
+}
+
+float LodChain::getPixelError() const
+{
+    return PixelError;
+}
+
+unsigned int LodChain::select(float pixelsPerUnit)
+{
+    if (Levels.empty())
+        return 0;
+
+    while (Current > 0 && Levels[Current].error * pixelsPerUnit > PixelError)
+        --Current;
+    while (Current + 1 < Levels.size() && Levels[Current + 1].error * pixelsPerUnit <= PixelError * (1 - Hysteresis))
+        ++Current;
+    return Current;
+}
+
+unsigned int LodChain::getCurrentLevel() const
+{
+    return Current;
+}
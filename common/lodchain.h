@@ -0,0 +1,87 @@
+#ifndef LOD_CHAIN_H_
+#define LOD_CHAIN_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "submesh.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    class MeshSequence;
+
+    /**
+    *   Coarser levels of detail of a mesh, each one another index buffer
+    *   over the same vertices.
+    *
+    *   Levels come from quadric error edge collapses where a vertex moves
+    *   onto one of its neighbours (half edge collapses), so no vertex is
+    *   ever made up and every level keeps working with whatever positions
+    *   the vertices are given, the keyframes of a sequence and the blends
+    *   between them included. For a sequence the error of a collapse is
+    *   the sum over up to MaxErrorFrames keyframes spread across it.
+    *
+    *   Open borders only collapse along themselves, and collapses that
+    *   would flip a face in any of those keyframes are not made.
+    *
+    *   Triangles that survive a collapse keep their order, so a mesh with
+    *   sub-meshes gets them on every level, in the same order and under the
+    *   same names, still one range each.
+    */
+    class LodChain
+    {
+    public:
+        struct Level
+        {
+            uint32_t indexStart;        // into getIndices()
+            uint32_t indexCount;
+            float error;                // object space distance the level can be off by
+        };
+
+        LodChain();
+
+        // Level 0 is the mesh as given, each next one aims for ratio times the
+        // triangles of the one before. The chain stops early once a level would
+        // be off by more than maxError (0 for no limit) or barely gets smaller.
+        void build(const MeshBuffer& mesh, unsigned int levels = DefaultLevels, float ratio = 0.5f, float maxError = 0);
+        void build(const MeshSequence& keyframes, unsigned int levels = DefaultLevels, float ratio = 0.5f, float maxError = 0);
+        void clear();
+
+        unsigned int getLevelCnt() const;
+        const Level& getLevel(unsigned int level) const;
+        // the mesh's sub-meshes on a level, starts are into getIndices() as well
+        const SubMeshList& getSubMeshes(unsigned int level) const;
+        // every level's indices, one after the other
+        const std::vector<uint32_t>& getIndices() const;
+
+        // How far off, in pixels, a level may be drawn. Default 1.
+        void setPixelError(float pixels);
+        float getPixelError() const;
+
+        // Picks the coarsest level whose error stays under the pixel error,
+        // pixelsPerUnit being how many pixels one object space unit covers at
+        // the mesh's distance. A coarser level is only taken once it fits with
+        // Hysteresis to spare, so a level sitting on the line doesn't flicker.
+        unsigned int select(float pixelsPerUnit);
+        unsigned int getCurrentLevel() const;
+
+        static const unsigned int DefaultLevels = 4;
+        static const unsigned int MaxErrorFrames = 8;
+        static const float Hysteresis;
+
+    private:
+        void build(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, const SubMeshList& subMeshes,
+            const std::vector<std::vector<glm::vec3> >& poses, unsigned int levels, float ratio, float maxError);
+
+        std::vector<Level> Levels;
+        std::vector<SubMeshList> LevelSubMeshes;
+        std::vector<uint32_t> Indices;
+        float PixelError;
+        unsigned int Current;
+    };
+}
+
+#endif // LOD_CHAIN_H_
@@ -0,0 +1,171 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace ogle;
+
+MappedFile::MappedFile()
+    : Data(0)
+    , Size(0)
+    , Opened(false)
+#ifdef _WIN32
+    , FileHandle(INVALID_HANDLE_VALUE)
+    , MappingHandle(0)
+#else
+    , FileDescriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    FileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(FileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    Size = (size_t)fileSize.QuadPart;
+    Opened = true;
+
+    // empty files can not be mapped, they are still valid to read though.
+    if (Size == 0)
+        return true;
+
+    MappingHandle = CreateFileMappingA(FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!MappingHandle) {
+        close();
+        return false;
+    }
+
+    Data = (const char*)MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!Data) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (Data)
+        UnmapViewOfFile(Data);
+    if (MappingHandle)
+        CloseHandle(MappingHandle);
+    if (FileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(FileHandle);
+
+    Data = 0;
+    Size = 0;
+    Opened = false;
+    MappingHandle = 0;
+    FileHandle = INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::release(size_t offset, size_t length)
+{
+    if (!Data || offset >= Size)
+        return;
+    length = (length < Size - offset) ? length : Size - offset;
+
+    // unlocking pages that were never locked takes them out of the working set
+    VirtualUnlock((LPVOID)(Data + offset), length);
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    FileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (FileDescriptor < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(FileDescriptor, &info) != 0) {
+        close();
+        return false;
+    }
+    Size = (size_t)info.st_size;
+    Opened = true;
+
+    // empty files can not be mapped, they are still valid to read though.
+    if (Size == 0)
+        return true;
+
+    void* mapped = mmap(0, Size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+    if (mapped == MAP_FAILED) {
+        close();
+        return false;
+    }
+    madvise(mapped, Size, MADV_SEQUENTIAL);
+    Data = (const char*)mapped;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (Data)
+        munmap((void*)Data, Size);
+    if (FileDescriptor >= 0)
+        ::close(FileDescriptor);
+
+    Data = 0;
+    Size = 0;
+    Opened = false;
+    FileDescriptor = -1;
+}
+
+void MappedFile::release(size_t offset, size_t length)
+{
+    if (!Data || offset >= Size)
+        return;
+    length = (length < Size - offset) ? length : Size - offset;
+
+    // madvise works on whole pages, only let go of the ones entirely in range
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t first = (offset + pageSize - 1) / pageSize * pageSize;
+    size_t last = (offset + length) / pageSize * pageSize;
+    if (first < last)
+        madvise((void*)(Data + first), last - first, MADV_DONTNEED);
+}
+
+#endif
+
+bool MappedFile::isOpen() const
+{
+    return Opened;
+}
+
+const char* MappedFile::data() const
+{
+    return Data;
+}
+
+size_t MappedFile::size() const
+{
+    return Size;
+}
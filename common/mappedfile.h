@@ -0,0 +1,47 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <string>
+#include <cstddef>
+
+namespace ogle
+{
+    /**
+    *   Read only view of a whole file mapped into memory.
+    *   The contents are NOT null terminated, always use size() to find the end.
+    */
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        bool open(const std::string& filename);
+        void close();
+
+        bool isOpen() const;
+        const char* data() const;
+        size_t size() const;
+
+        // Drops the pages fully inside [offset, offset + length) from this process's working set.
+        // The data stays readable, touching it again pages it back in from disk.
+        void release(size_t offset, size_t length);
+
+    private:
+        MappedFile(const MappedFile& other);
+        MappedFile& operator=(const MappedFile& other);
+
+        const char* Data;
+        size_t Size;
+        bool Opened;
+
+#ifdef _WIN32
+        void* FileHandle;
+        void* MappingHandle;
+#else
+        int FileDescriptor;
+#endif
+    };
+}
+
+#endif // MAPPED_FILE_H_
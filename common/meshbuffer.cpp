@@ -2,7 +2,21 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <iostream>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+#include <cctype>
 #include "vertexattributeindices.h"
+#include "objloader.h"
+#include "plyloader.h"
+#include "stlloader.h"
+#include "meshcache.h"
+
+// the raw float setters copy straight into the vectors
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 is expected to be tightly packed");
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "glm::vec2 is expected to be tightly packed");
+// or growing a std::vector<MeshBuffer> copies every mesh in it
+static_assert(std::is_nothrow_move_constructible<MeshBuffer>::value, "MeshBuffer moves are expected not to throw");
 
 MeshBuffer::MeshBuffer()
     : UsesNormals(false)
@@ -11,6 +25,9 @@ MeshBuffer::MeshBuffer()
     , UsesGenerics(5, false)
     , VertCnt(0)
     , IdxCnt(0)
+    , Layout(ArrayOfStructs)
+    , VertsStale(false)
+    , NormsStale(false)
     , Generics(5)
 {
 
@@ -25,33 +42,146 @@ MeshBuffer::MeshBuffer(const MeshBuffer & ref)
     : UsesNormals(false)
     , UsesUVs(false)
     , UsesIndices(false)
+    , UsesGenerics(5, false)
     , VertCnt(0)
     , IdxCnt(0)
+    , Layout(ArrayOfStructs)
+    , VertsStale(false)
+    , NormsStale(false)
+    , Generics(5)
 {
     this->operator =(ref);
 }
 
+// Takes ref's storage as it is, nothing is allocated so vectors of meshes move
+// their elements when they grow.
+MeshBuffer::MeshBuffer(MeshBuffer && ref) noexcept
+    : UsesNormals(ref.UsesNormals)
+    , UsesUVs(ref.UsesUVs)
+    , UsesIndices(ref.UsesIndices)
+    , UsesGenerics(std::move(ref.UsesGenerics))
+    , VertCnt(ref.VertCnt)
+    , IdxCnt(ref.IdxCnt)
+    , Verts(std::move(ref.Verts))
+    , Norms(std::move(ref.Norms))
+    , Layout(ref.Layout)
+    , VertStreams(std::move(ref.VertStreams))
+    , NormStreams(std::move(ref.NormStreams))
+    , VertsStale(ref.VertsStale)
+    , NormsStale(ref.NormsStale)
+    , TexCoords(std::move(ref.TexCoords))
+    , Generic0(std::move(ref.Generic0))
+    , Generics(std::move(ref.Generics))
+    , Indices(std::move(ref.Indices))
+    , SubMeshes(std::move(ref.SubMeshes))
+{
+    ref.cleanUp();
+}
+
 MeshBuffer& MeshBuffer::operator=(const MeshBuffer & ref)
 {
     if (this == &ref) return *this;
     cleanUp();
+    Layout = ArrayOfStructs;
 
-	setVerts(ref.VertCnt, (float*)ref.Verts.data());
-	setNorms(ref.VertCnt, (float*)ref.Norms.data());
+	setVerts(ref.VertCnt, (float*)ref.getVerts().data());
+	setNorms(ref.VertCnt, (float*)ref.getNorms().data());
 	setTexCoords(0, ref.VertCnt, (float*)ref.TexCoords.data());
 
-    for (size_t i=0; i<5; ++i)
+    for (size_t i=0; i<ref.UsesGenerics.size(); ++i)
         if (ref.UsesGenerics[i])
             setGenerics(i, ref.getGenerics(i));
 
     if (ref.IdxCnt)
         setIndices(ref.IdxCnt, (uint32_t*)&ref.Indices[0]);
+    SubMeshes = ref.SubMeshes;
+
+    setVertexLayout(ref.Layout);
+    return *this;
+}
+
+MeshBuffer& MeshBuffer::operator=(MeshBuffer && ref) noexcept
+{
+    if (this == &ref) return *this;
+
+    UsesNormals = ref.UsesNormals;
+    UsesUVs = ref.UsesUVs;
+    UsesIndices = ref.UsesIndices;
+    UsesGenerics.swap(ref.UsesGenerics);
+    VertCnt = ref.VertCnt;
+    IdxCnt = ref.IdxCnt;
+
+    Verts.swap(ref.Verts);
+    Norms.swap(ref.Norms);
+    TexCoords.swap(ref.TexCoords);
+    Generic0.swap(ref.Generic0);
+    Generics.swap(ref.Generics);
+    Indices.swap(ref.Indices);
+    SubMeshes.swap(ref.SubMeshes);
+
+    std::swap(Layout, ref.Layout);
+    std::swap(VertStreams, ref.VertStreams);
+    std::swap(NormStreams, ref.NormStreams);
+    VertsStale = ref.VertsStale;
+    NormsStale = ref.NormsStale;
+
+    // ref ends up empty, its old storage goes when it does
+    ref.cleanUp();
     return *this;
 }
 
-void MeshBuffer::loadFile(const char * fileName)
+// Lower case extension of a file name, without the dot.
+static std::string fileExtension(const char* fileName)
+{
+    std::string name(fileName);
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos || name.find_first_of("/\\", dot) != std::string::npos)
+        return std::string();
+
+    std::string extension = name.substr(dot + 1);
+    for (size_t i = 0; i < extension.size(); ++i)
+        extension[i] = (char)tolower((unsigned char)extension[i]);
+    return extension;
+}
+
+// Binary ply and stl load straight from the mapping, the cache would have to hash
+// the whole file before it is any use, so only obj goes through it.
+template <typename Loader>
+static bool loadBinary(MeshBuffer& mesh, const char* fileName)
 {
+    Loader loader;
+    if (!loader.load(fileName) || loader.getVertCount() == 0)
+        return false;
+
+    mesh.setVerts(loader.releasePositions());
+    mesh.setIndices(loader.releaseIndices());
+    mesh.setSubMeshes(ogle::SubMeshList());
+    return true;
+}
 
+bool MeshBuffer::loadFile(const char * fileName)
+{
+    std::string extension = fileExtension(fileName);
+    if (extension == "ply")
+        return loadBinary<ogle::PlyLoader>(*this, fileName);
+    if (extension == "stl")
+        return loadBinary<ogle::StlLoader>(*this, fileName);
+
+    if (ogle::MeshCache::read(fileName, *this))
+        return true;
+
+    ogle::ObjLoader loader;
+    loader.load(fileName);
+    if (loader.getVertCount() == 0)
+        return false;
+
+    setVerts(loader.releasePositions());
+    setIndices(loader.releaseIndices());
+    setSubMeshes(loader.releaseSubMeshes());
+
+    // a cache that can't be written only costs the next run a parse
+    ogle::MeshCache::write(fileName, *this);
+    return true;
 }
 
 void MeshBuffer::setVerts(unsigned int count, const float* verts)
@@ -60,16 +190,21 @@ void MeshBuffer::setVerts(unsigned int count, const float* verts)
 
     VertCnt = count;
     Verts.resize(VertCnt);
-    int src_num_componets = 3;
+    if (VertCnt)
+        memcpy((float*)&Verts[0], verts, VertCnt * sizeof(glm::vec3));
+    VertsStale = false;
+    if (Layout == StructOfArrays)
+        VertStreams.assign(Verts.data(), VertCnt);
+}
 
-    for (unsigned int i=0; i<VertCnt; ++i)
-    {
-        glm::vec3 vec;
-        vec[0] = verts[i * src_num_componets + 0];
-        vec[1] = verts[i * src_num_componets + 1];
-        vec[2] = verts[i * src_num_componets + 2];
-        Verts[i] = vec;
-    }
+void MeshBuffer::setVerts(std::vector<glm::vec3>&& verts)
+{
+    Verts = std::move(verts);
+    verts.clear();
+    VertCnt = (unsigned int)Verts.size();
+    VertsStale = false;
+    if (Layout == StructOfArrays)
+        VertStreams.assign(Verts.data(), VertCnt);
 }
 
 void MeshBuffer::setNorms(unsigned int count, const float* normals)
@@ -83,19 +218,12 @@ void MeshBuffer::setNorms(unsigned int count, const float* normals)
     if (!normals) return;  
     UsesNormals = true;
 
-    Norms.clear();
     Norms.resize(count);
-    int src_num_componets = 3;
-
-    for (unsigned int i=0; i<VertCnt; ++i)
-    {
-        glm::vec3 vec;
-        vec[0] = normals[i * src_num_componets + 0];
-        vec[1] = normals[i * src_num_componets + 1];
-        vec[2] = normals[i * src_num_componets + 2];
-
-        Norms[i] = vec;
-    }
+    if (count)
+        memcpy((float*)&Norms[0], normals, count * sizeof(glm::vec3));
+    NormsStale = false;
+    if (Layout == StructOfArrays)
+        NormStreams.assign(Norms.data(), count);
 }
 
 void MeshBuffer::setTexCoords(unsigned int layer, unsigned int count, const float* coords)
@@ -109,18 +237,9 @@ void MeshBuffer::setTexCoords(unsigned int layer, unsigned int count, const floa
     if (!coords) return;
     UsesUVs = true;
 
-    TexCoords.clear();
     TexCoords.resize(count);
-    int src_num_componets = 2;
-
-    for (unsigned int i=0; i<VertCnt; ++i)
-    {
-        glm::vec2 vec;
-        vec[0] = coords[i * src_num_componets + 0];
-        vec[1] = coords[i * src_num_componets + 1];
-
-        TexCoords[i] = vec;
-    }
+    if (count)
+        memcpy((float*)&TexCoords[0], coords, count * sizeof(glm::vec2));
 }
 
 void MeshBuffer::setGenerics(unsigned int index, const std::vector<glm::vec4>& values)
@@ -131,11 +250,16 @@ void MeshBuffer::setGenerics(unsigned int index, const std::vector<glm::vec4>& v
         exit(1);
     }
 
-    if (index >= (unsigned int)UsesGenerics.size())
+    if (index >= 5)
     {
         std::cout << "setGenerics index is not within the valid range of [0-4]" << std::endl;
         exit(1);
     }
+    // a mesh that was moved from has no slots left
+    if (UsesGenerics.size() < 5) {
+        UsesGenerics.resize(5, false);
+        Generics.resize(5);
+    }
     UsesGenerics[index] = true;
 
     Generics[index].clear();
@@ -149,21 +273,36 @@ void MeshBuffer::setIndices(unsigned int count, const unsigned int * indices)
     UsesIndices = true;
 
     IdxCnt = count;
-    Indices.clear();
     Indices.resize(IdxCnt);
-    for (unsigned int i=0; i<IdxCnt; ++i)
-    {
-        Indices[i] = indices[i];
-    }
+    if (IdxCnt)
+        memcpy(&Indices[0], indices, IdxCnt * sizeof(uint32_t));
+}
+
+void MeshBuffer::setIndices(std::vector<uint32_t>&& indices)
+{
+    UsesIndices = true;
+    Indices = std::move(indices);
+    indices.clear();
+    IdxCnt = (unsigned int)Indices.size();
 }
 
 const std::vector<glm::vec3>& MeshBuffer::getVerts() const
 {
+    if (VertsStale) {
+        Verts.resize(VertCnt);
+        VertStreams.copyTo(Verts.data());
+        VertsStale = false;
+    }
     return Verts;
 }
 
 const std::vector<glm::vec3>& MeshBuffer::getNorms() const
 {
+    if (NormsStale) {
+        Norms.resize(VertCnt);
+        NormStreams.copyTo(Norms.data());
+        NormsStale = false;
+    }
     return Norms;
 }
 
@@ -174,6 +313,9 @@ const std::vector<glm::vec2>& MeshBuffer::getTexCoords(unsigned int layer) const
 
 const std::vector<glm::vec4>& MeshBuffer::getGenerics(unsigned int index) const
 {
+    static const std::vector<glm::vec4> none;
+    if (index >= Generics.size())
+        return none;
     return Generics[index];
 }
 
@@ -182,11 +324,105 @@ const std::vector<uint32_t>& MeshBuffer::getIndices() const
     return Indices;
 }
 
+void MeshBuffer::setSubMeshes(const ogle::SubMeshList& subMeshes)
+{
+    SubMeshes = subMeshes;
+}
+
+const ogle::SubMeshList& MeshBuffer::getSubMeshes() const
+{
+    return SubMeshes;
+}
+
+glm::vec3* MeshBuffer::getWritableVerts()
+{
+    assert(Layout == ArrayOfStructs);
+    return Verts.data();
+}
+
+void MeshBuffer::setVertexLayout(VertexLayout layout)
+{
+    if (layout == Layout)
+        return;
+
+    if (layout == StructOfArrays) {
+        // the array of structs copy stays on as the up to date one
+        VertStreams.assign(Verts.data(), VertCnt);
+        if (UsesNormals)
+            NormStreams.assign(Norms.data(), VertCnt);
+    }
+    else {
+        getVerts();
+        getNorms();
+        VertStreams.clear();
+        NormStreams.clear();
+    }
+    Layout = layout;
+}
+
+MeshBuffer::VertexLayout MeshBuffer::getVertexLayout() const
+{
+    return Layout;
+}
+
+const ogle::VertexStreams& MeshBuffer::getVertStreams() const
+{
+    assert(Layout == StructOfArrays);
+    return VertStreams;
+}
+
+const ogle::VertexStreams& MeshBuffer::getNormStreams() const
+{
+    assert(Layout == StructOfArrays);
+    return NormStreams;
+}
+
+ogle::VertexStreams& MeshBuffer::getWritableVertStreams()
+{
+    assert(Layout == StructOfArrays);
+    VertsStale = true;
+    return VertStreams;
+}
+
+glm::vec3* MeshBuffer::getWritableNorms()
+{
+    assert(Layout == ArrayOfStructs);
+    UsesNormals = true;
+    Norms.resize(VertCnt);
+    return Norms.data();
+}
+
+ogle::VertexStreams& MeshBuffer::getWritableNormStreams()
+{
+    assert(Layout == StructOfArrays);
+    UsesNormals = true;
+    NormStreams.resize(VertCnt);
+    NormsStale = true;
+    return NormStreams;
+}
+
+MeshView MeshBuffer::getView() const
+{
+    MeshView view;
+    view.verts = getVerts().data();
+    view.norms = UsesNormals ? getNorms().data() : 0;
+    view.indices = UsesIndices ? Indices.data() : 0;
+    view.vertCnt = VertCnt;
+    view.idxCnt = IdxCnt;
+    return view;
+}
+
 void MeshBuffer::generateFaceNormals()
 {
     assert(IdxCnt);
 
     UsesNormals = true;
+    if (Layout == StructOfArrays) {
+        ogle::streamFaceNormals(VertStreams, Indices.data(), IdxCnt, NormStreams);
+        NormsStale = true;
+        return;
+    }
+
     Norms.clear();
     Norms.resize(VertCnt);
     for (unsigned int i=0; i<IdxCnt; i+=3){
@@ -222,6 +458,30 @@ unsigned int MeshBuffer::getIdxCnt() const
     return IdxCnt;
 }
 
+MeshBuffer::IndexType MeshBuffer::getIndexType() const
+{
+    // indices run up to VertCnt - 1
+    return VertCnt <= 65536 ? Index16 : Index32;
+}
+
+unsigned int MeshBuffer::getIndexSize() const
+{
+    return getIndexType() == Index16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void MeshBuffer::copyIndices(void* dest) const
+{
+    if (getIndexType() == Index32) {
+        if (IdxCnt)
+            memcpy(dest, Indices.data(), IdxCnt * sizeof(uint32_t));
+        return;
+    }
+
+    uint16_t* narrowed = static_cast<uint16_t*>(dest);
+    for (unsigned int i = 0; i < IdxCnt; ++i)
+        narrowed[i] = (uint16_t)Indices[i];
+}
+
 void MeshBuffer::cleanUp()
 {
     UsesNormals = false;
@@ -233,10 +493,18 @@ void MeshBuffer::cleanUp()
     Verts.clear();
     Norms.clear();
     TexCoords.clear();
+    // keeps however many slots there are, cleanUp runs from the moves and must not allocate
     for (auto& gen: Generics)
         gen.clear();
-    Generics.clear();
+    UsesGenerics.assign(UsesGenerics.size(), false);
 
     Indices.clear();
+    SubMeshes.clear();
+
+    // the layout is a setting and stays, the streams are data and go
+    VertStreams.clear();
+    NormStreams.clear();
+    VertsStale = false;
+    NormsStale = false;
 }
 
@@ -4,35 +4,107 @@
 #define MESH_BUFFER_H_
 
 #include <vector>
+#include <stdint.h>
 #include "glm/glm.hpp"
 
+#include "vertexstreams.h"
+#include "submesh.h"
+
+// Non-owning look at mesh data that lives somewhere else (a MeshBuffer, a
+// keyframe in a sequence, ...). Only valid while the owner is left alone.
+struct MeshView
+{
+    MeshView() : verts(0), norms(0), indices(0), vertCnt(0), idxCnt(0) {}
+
+    const glm::vec3* verts;
+    const glm::vec3* norms;         // null when there are none
+    const uint32_t* indices;        // null when there are none
+    unsigned int vertCnt;
+    unsigned int idxCnt;
+};
+
 class MeshBuffer
 {
 public:
+    // How positions and normals are kept. With StructOfArrays the
+    // per-vertex work (sampling, normals, bounds, vertex upload) runs on
+    // aligned x/y/z streams, getVerts() and getNorms() still work but build
+    // an array of structs copy when the streams have changed since.
+    enum VertexLayout
+    {
+        ArrayOfStructs,
+        StructOfArrays
+    };
+
+    // What indices are uploaded and drawn as, the narrowest that reaches every vertex.
+    enum IndexType
+    {
+        Index16,
+        Index32
+    };
+
     MeshBuffer();
     virtual ~MeshBuffer();
 
     MeshBuffer(const MeshBuffer & ref);
     MeshBuffer& operator=(const MeshBuffer & ref);
 
-    void loadFile(const char * fileName);
+    MeshBuffer(MeshBuffer && ref) noexcept;
+    MeshBuffer& operator=(MeshBuffer && ref) noexcept;
+
+    // Loads positions and indices from an obj, going through the binary mesh cache when it can,
+    // or from a binary ply or stl (by the extension).
+    bool loadFile(const char * fileName);
 
     void setVerts(unsigned int count, const float* verts);
     void setNorms(unsigned int count, const float* normals);
     void setTexCoords(unsigned int layer, unsigned int count, const float* coords);
     void setIndices(unsigned int count, const unsigned int * indices);
 
+    // Take over the storage instead of copying it, the arguments are left empty.
+    void setVerts(std::vector<glm::vec3>&& verts);
+    void setIndices(std::vector<uint32_t>&& indices);
+
     const std::vector<glm::vec3>& getVerts() const;
     const std::vector<glm::vec3>& getNorms() const;
     const std::vector<glm::vec2>& getTexCoords(unsigned int layer) const;
     const std::vector<uint32_t>& getIndices() const;
 
+    // Named ranges of the indices (obj groups and objects), none for a mesh
+    // that is one thing. Whatever sets new indices sets these to go with them.
+    void setSubMeshes(const ogle::SubMeshList& subMeshes);
+    const ogle::SubMeshList& getSubMeshes() const;
+
+    // For writers that fill the positions in place, holds getVertCnt() positions.
+    // ArrayOfStructs only, use getWritableVertStreams() otherwise.
+    glm::vec3* getWritableVerts();
+
+    void setVertexLayout(VertexLayout layout);
+    VertexLayout getVertexLayout() const;
+
+    // StructOfArrays only.
+    const ogle::VertexStreams& getVertStreams() const;
+    const ogle::VertexStreams& getNormStreams() const;
+    ogle::VertexStreams& getWritableVertStreams();
+
+    // For writers that fill the normals in place, sized to getVertCnt() and
+    // UsesNormals set. The first is ArrayOfStructs only, the second StructOfArrays.
+    glm::vec3* getWritableNorms();
+    ogle::VertexStreams& getWritableNormStreams();
+
+    MeshView getView() const;
+
     void setGenerics(unsigned int index, const std::vector<glm::vec4>& values);
     const std::vector<glm::vec4>& getGenerics(unsigned int index) const;
 
     unsigned int getVertCnt() const;
     unsigned int getIdxCnt() const;
 
+    IndexType getIndexType() const;
+    unsigned int getIndexSize() const;     // bytes per index
+    // Writes getIdxCnt() indices of getIndexType() to dest.
+    void copyIndices(void* dest) const;
+
     void generateFaceNormals();
 
     bool UsesNormals;
@@ -47,8 +119,16 @@ private:
     unsigned int VertCnt;
     unsigned int IdxCnt;
 
-    std::vector<glm::vec3> Verts;
-    std::vector<glm::vec3> Norms;
+    // With StructOfArrays the streams hold the data, Verts and Norms are
+    // rebuilt from them on demand.
+    mutable std::vector<glm::vec3> Verts;
+    mutable std::vector<glm::vec3> Norms;
+    VertexLayout Layout;
+    ogle::VertexStreams VertStreams;
+    ogle::VertexStreams NormStreams;
+    mutable bool VertsStale;
+    mutable bool NormsStale;
+
     std::vector<glm::vec2> TexCoords;
     std::vector<glm::vec4> Generic0;
 
@@ -56,6 +136,7 @@ private:
     std::vector<std::vector<glm::vec4>> Generics;
 
     std::vector<uint32_t>  Indices;
+    ogle::SubMeshList SubMeshes;
 };
 
 #endif // MESH_BUFFER_H_
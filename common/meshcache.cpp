@@ -0,0 +1,259 @@
+#include "meshcache.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "mappedfile.h"
+#include "meshbuffer.h"
+
+using namespace std;
+using namespace ogle;
+
+std::string MeshCache::Directory;
+
+namespace
+{
+    const char Magic[8] = {'O','G','L','E','M','E','S','H'};
+    const uint32_t Version = 2;
+
+    enum HeaderFlags
+    {
+        HasNormals = 1 << 0,
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+
+        // source file the cache was built from
+        uint64_t sourceSize;
+        int64_t sourceModified;
+        uint64_t sourceHash;
+
+        uint64_t payloadHash;
+        uint32_t vertCount;
+        uint32_t indexCount;
+        float aabbMin[3];
+        float aabbMax[3];
+
+        // the sub-mesh table goes after the indices
+        uint32_t subMeshCount;
+        uint32_t subMeshBytes;
+    };
+    // keeps the payload that follows 8 byte aligned in the mapping
+    static_assert(sizeof(Header) == 88, "mesh cache header layout changed, bump Version");
+}
+
+// Not cryptographic, only here to notice a source that changed or a cache that got damaged.
+// When data is the mapping of file, pages already hashed are let go as it goes.
+static uint64_t hashBytes(const char* data, size_t size, MappedFile* file = 0)
+{
+    const uint64_t mul = 0x9E3779B97F4A7C15ull;
+    const size_t ReleaseBlock = 1024 * 1024;
+    uint64_t h = 0xCBF29CE484222325ull ^ (size * mul);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * mul;
+        h ^= h >> 29;
+
+        if (file && i % ReleaseBlock == 0 && i >= ReleaseBlock)
+            file->release(i - ReleaseBlock, ReleaseBlock);
+    }
+    for (; i < size; ++i)
+        h = (h ^ (unsigned char)data[i]) * mul;
+
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return h;
+}
+
+static bool fileInfo(const std::string& fileName, uint64_t& size, int64_t& modified)
+{
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(fileName.c_str(), &info) != 0)
+        return false;
+#else
+    struct stat info;
+    if (stat(fileName.c_str(), &info) != 0)
+        return false;
+#endif
+    size = (uint64_t)info.st_size;
+    modified = (int64_t)info.st_mtime;
+    return true;
+}
+
+void MeshCache::setDirectory(const std::string& directory)
+{
+    Directory = directory;
+    if (!Directory.empty() && Directory[Directory.size() - 1] != '/' && Directory[Directory.size() - 1] != '\\')
+        Directory += '/';
+}
+
+std::string MeshCache::cacheFileName(const std::string& sourceFile)
+{
+    if (Directory.empty())
+        return sourceFile + ".meshcache";
+
+    size_t slash = sourceFile.find_last_of("/\\");
+    std::string baseName = (slash == std::string::npos) ? sourceFile : sourceFile.substr(slash + 1);
+    return Directory + baseName + ".meshcache";
+}
+
+bool MeshCache::fingerprint(const std::string& fileName, uint64_t& size, uint64_t& hash)
+{
+    MappedFile file;
+    if (!file.open(fileName))
+        return false;
+    size = file.size();
+    hash = hashBytes(file.data(), file.size(), &file);
+    return true;
+}
+
+bool MeshCache::read(const std::string& sourceFile, MeshBuffer& mesh)
+{
+    uint64_t sourceSize;
+    int64_t sourceModified;
+    if (!fileInfo(sourceFile, sourceSize, sourceModified))
+        return false;
+
+    MappedFile cache;
+    if (!cache.open(cacheFileName(sourceFile)) || cache.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    memcpy(&header, cache.data(), sizeof(Header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version)
+        return false;
+    if (header.sourceSize != sourceSize || header.sourceModified != sourceModified)
+        return false;
+
+    uint64_t normalCount = (header.flags & HasNormals) ? header.vertCount : 0;
+    uint64_t payloadSize = (uint64_t)header.vertCount * sizeof(glm::vec3)
+                         + normalCount * sizeof(glm::vec3)
+                         + (uint64_t)header.indexCount * sizeof(uint32_t)
+                         + header.subMeshBytes;
+    if (cache.size() != sizeof(Header) + payloadSize)
+        return false;
+
+    const char* payload = cache.data() + sizeof(Header);
+    if (hashBytes(payload, (size_t)payloadSize) != header.payloadHash)
+        return false;
+
+    // same size and time stamp is not enough, a tool may have rewritten the file in place
+    MappedFile source;
+    if (!source.open(sourceFile) || hashBytes(source.data(), source.size(), &source) != header.sourceHash)
+        return false;
+
+    const float* positions = (const float*)payload;
+    const float* normals = positions + header.vertCount * 3;
+    const uint32_t* indices = (const uint32_t*)(normals + normalCount * 3);
+
+    ogle::SubMeshList subMeshes;
+    if (!unpackSubMeshes((const char*)(indices + header.indexCount), header.subMeshBytes, header.subMeshCount, subMeshes)
+        || !validSubMeshes(subMeshes, header.indexCount))
+        return false;
+
+    mesh.setVerts(header.vertCount, positions);
+    if (normalCount)
+        mesh.setNorms(header.vertCount, normals);
+    if (header.indexCount)
+        mesh.setIndices(header.indexCount, indices);
+    mesh.setSubMeshes(subMeshes);
+    return true;
+}
+
+bool MeshCache::write(const std::string& sourceFile, const MeshBuffer& mesh)
+{
+    const std::vector<glm::vec3>& verts = mesh.getVerts();
+    if (verts.empty())
+        return false;
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    if (!fileInfo(sourceFile, header.sourceSize, header.sourceModified))
+        return false;
+
+    MappedFile source;
+    if (!source.open(sourceFile))
+        return false;
+    header.sourceHash = hashBytes(source.data(), source.size(), &source);
+    source.close();
+
+    bool writeNormals = mesh.UsesNormals && mesh.getNorms().size() == verts.size();
+    header.flags = writeNormals ? HasNormals : 0;
+    header.vertCount = (uint32_t)verts.size();
+    header.indexCount = mesh.getIdxCnt();
+
+    glm::vec3 aabbMin(verts[0]), aabbMax(verts[0]);
+    for (size_t i = 1; i < verts.size(); ++i) {
+        aabbMin = glm::min(aabbMin, verts[i]);
+        aabbMax = glm::max(aabbMax, verts[i]);
+    }
+    for (int i = 0; i < 3; ++i) {
+        header.aabbMin[i] = aabbMin[i];
+        header.aabbMax[i] = aabbMax[i];
+    }
+
+    size_t positionBytes = verts.size() * sizeof(glm::vec3);
+    size_t normalBytes = writeNormals ? positionBytes : 0;
+    size_t indexBytes = header.indexCount * sizeof(uint32_t);
+    std::vector<char> subMeshes;
+    packSubMeshes(mesh.getSubMeshes(), subMeshes);
+    header.subMeshCount = (uint32_t)mesh.getSubMeshes().size();
+    header.subMeshBytes = (uint32_t)subMeshes.size();
+
+    std::vector<char> payload(positionBytes + normalBytes + indexBytes + subMeshes.size());
+    memcpy(&payload[0], verts.data(), positionBytes);
+    if (normalBytes)
+        memcpy(&payload[positionBytes], mesh.getNorms().data(), normalBytes);
+    if (indexBytes)
+        memcpy(&payload[positionBytes + normalBytes], mesh.getIndices().data(), indexBytes);
+    if (!subMeshes.empty())
+        memcpy(&payload[positionBytes + normalBytes + indexBytes], subMeshes.data(), subMeshes.size());
+    header.payloadHash = hashBytes(payload.data(), payload.size());
+
+    // write to the side and move into place, a reader never sees half a cache.
+    std::string fileName = cacheFileName(sourceFile);
+    std::string tempName = fileName + ".tmp";
+    {
+        ofstream outf(tempName.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+        if (!outf.is_open()) {
+            cerr << "[!] Failed to write mesh cache: " << fileName << endl;
+            return false;
+        }
+        outf.write((const char*)&header, sizeof(Header));
+        outf.write(payload.data(), payload.size());
+        if (!outf.good()) {
+            outf.close();
+            remove(tempName.c_str());
+            cerr << "[!] Failed to write mesh cache: " << fileName << endl;
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // rename does not replace an existing file on windows
+    remove(fileName.c_str());
+#endif
+    if (rename(tempName.c_str(), fileName.c_str()) != 0) {
+        remove(tempName.c_str());
+        cerr << "[!] Failed to write mesh cache: " << fileName << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+
+#include <string>
+#include <stdint.h>
+
+class MeshBuffer;
+
+namespace ogle
+{
+    /**
+    *   Binary copy of a parsed mesh, kept next to its source file (or in a
+    *   cache directory) so later runs can skip parsing.
+    *
+    *   Layout, all values in native byte order:
+    *       Header
+    *       positions   vertCount  * 3 floats
+    *       normals     vertCount  * 3 floats, only if HasNormals is set
+    *       indices     indexCount * uint32
+    *
+    *   A cache is only used when the source's size, modification time and
+    *   content hash all match the header, and the payload hash checks out.
+    */
+    class MeshCache
+    {
+    public:
+        // Where cache files go, an empty directory (the default) puts them beside the source.
+        static void setDirectory(const std::string& directory);
+        static std::string cacheFileName(const std::string& sourceFile);
+
+        // Size and content hash of a file, what anything built from it is checked against.
+        static bool fingerprint(const std::string& fileName, uint64_t& size, uint64_t& hash);
+
+        // Fills mesh from the cache of sourceFile, false if there is no usable cache.
+        static bool read(const std::string& sourceFile, MeshBuffer& mesh);
+        static bool write(const std::string& sourceFile, const MeshBuffer& mesh);
+
+    private:
+        static std::string Directory;
+    };
+}
+
+#endif // MESH_CACHE_H_
@@ -0,0 +1,364 @@
+#include "meshlets.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "meshbuffer.h"
+#include "meshsequence.h"
+
+using namespace ogle;
+
+const uint32_t MeshletSet::NoSubMesh;
+
+// cones that spread wider than this (cos of the angle from the axis) never cull anything
+static const float MinConeSpread = 0.1f;
+
+static glm::vec3 faceNormal(const glm::vec3* verts, const uint32_t* tri, bool& degenerate)
+{
+    const glm::vec3& a = verts[tri[0]];
+    glm::vec3 n = glm::cross(verts[tri[1]] - a, verts[tri[2]] - a);
+    float length = glm::length(n);
+    degenerate = length == 0;
+    return degenerate ? n : n / length;
+}
+
+static glm::vec3 lerp(const glm::vec3& a, const glm::vec3& b, float t)
+{
+    return a + (b - a) * t;
+}
+
+// Every keyframe, then the blend halfway between each keyframe and the next
+// (the last going back to the first), what a sequence's cones have to cover.
+template <typename Visit>
+static void forEachPose(const MeshSequence& keyframes, Visit visit)
+{
+    std::vector<glm::vec3> verts;
+    unsigned int frameCnt = keyframes.getFrameCnt();
+    for (unsigned int f = 0; f < frameCnt; ++f) {
+        keyframes.getFrame(f, verts);
+        visit(verts.data());
+    }
+    for (unsigned int f = 0; frameCnt > 1 && f < frameCnt; ++f) {
+        keyframes.sample(f, (f + 1) % frameCnt, 0.5f, verts);
+        visit(verts.data());
+    }
+}
+
+MeshletSet::CullView::CullView()
+    : modelViewProjection(1.0f)
+    , eye(0, 0, 0)
+    , backFaces(false)
+    , depthRange(false)
+    , minDepth(0)
+    , maxDepth(0)
+    , subMeshMask(~0u)
+{
+}
+
+MeshletSet::MeshletSet()
+    : FrameCnt(0)
+{
+    memset(&LastCull, 0, sizeof(LastCull));
+}
+
+void MeshletSet::build(const MeshBuffer& mesh, float padding)
+{
+    clear();
+    split(mesh.getIndices().data(), mesh.getIdxCnt(), mesh.getVertCnt(), mesh.getSubMeshes());
+
+    const glm::vec3* verts = mesh.getVerts().data();
+    addFrameBounds(verts, padding);
+
+    std::vector<glm::vec3> axes(Meshlets.size(), glm::vec3(0, 0, 0));
+    std::vector<float> minDot(Meshlets.size(), 1.0f);
+    addConeNormals(verts, axes);
+    normalizeAxes(axes, minDot);
+    addConeSpread(verts, axes, minDot);
+    setCones(axes, minDot);
+    setFrame(0, false);
+}
+
+void MeshletSet::build(const MeshSequence& keyframes, float padding)
+{
+    clear();
+    if (keyframes.getFrameCnt() == 0)
+        return;
+
+    split(keyframes.getIndices().data(), keyframes.getIdxCnt(), keyframes.getVertCnt(), keyframes.getSubMeshes());
+
+    std::vector<glm::vec3> verts;
+    for (unsigned int f = 0; f < keyframes.getFrameCnt(); ++f) {
+        keyframes.getFrame(f, verts);
+        addFrameBounds(verts.data(), padding);
+    }
+
+    std::vector<glm::vec3> axes(Meshlets.size(), glm::vec3(0, 0, 0));
+    std::vector<float> minDot(Meshlets.size(), 1.0f);
+    forEachPose(keyframes, [&](const glm::vec3* pose) { addConeNormals(pose, axes); });
+    normalizeAxes(axes, minDot);
+    forEachPose(keyframes, [&](const glm::vec3* pose) { addConeSpread(pose, axes, minDot); });
+    setCones(axes, minDot);
+    setFrame(0, false);
+}
+
+void MeshletSet::clear()
+{
+    Meshlets.clear();
+    Indices.clear();
+    FrameBounds.clear();
+    Current.clear();
+    FrameCnt = 0;
+    memset(&LastCull, 0, sizeof(LastCull));
+}
+
+unsigned int MeshletSet::getMeshletCnt() const
+{
+    return (unsigned int)Meshlets.size();
+}
+
+unsigned int MeshletSet::getFrameCnt() const
+{
+    return FrameCnt;
+}
+
+const std::vector<MeshletSet::Meshlet>& MeshletSet::getMeshlets() const
+{
+    return Meshlets;
+}
+
+void MeshletSet::setFrame(float frame, bool loop)
+{
+    if (FrameCnt == 0)
+        return;
+
+    unsigned int frameA, frameB;
+    float tween;
+    MeshSequence::findKeyframes(frame, loop, FrameCnt, frameA, frameB, tween);
+
+    size_t count = Meshlets.size();
+    const Bounds* a = &FrameBounds[frameA * count];
+    const Bounds* b = &FrameBounds[frameB * count];
+    Current.resize(count);
+    for (size_t m = 0; m < count; ++m) {
+        // each blended vertex stays within the blend of its keyframes' spheres and boxes
+        Bounds& bounds = Current[m];
+        bounds.center = lerp(a[m].center, b[m].center, tween);
+        bounds.radius = a[m].radius + (b[m].radius - a[m].radius) * tween;
+        bounds.aabbMin = lerp(a[m].aabbMin, b[m].aabbMin, tween);
+        bounds.aabbMax = lerp(a[m].aabbMax, b[m].aabbMax, tween);
+    }
+}
+
+const std::vector<MeshletSet::Bounds>& MeshletSet::getBounds() const
+{
+    return Current;
+}
+
+unsigned int MeshletSet::cull(const CullView& view, unsigned int* starts, unsigned int* counts)
+{
+    const glm::mat4& mvp = view.modelViewProjection;
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; ++r)
+        rows[r] = glm::vec4(mvp[0][r], mvp[1][r], mvp[2][r], mvp[3][r]);
+
+    // inside is where w +- x, y, z are all positive
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    };
+    glm::vec3 depthAxis(rows[2]);
+    glm::vec3 depthSpread(std::fabs(depthAxis.x), std::fabs(depthAxis.y), std::fabs(depthAxis.z));
+
+    memset(&LastCull, 0, sizeof(LastCull));
+    LastCull.meshlets = (unsigned int)Meshlets.size();
+
+    unsigned int ranges = 0;
+    for (size_t m = 0; m < Meshlets.size(); ++m) {
+        const Meshlet& meshlet = Meshlets[m];
+        const Bounds& bounds = Current[m];
+
+        // left out of this pass altogether
+        if (meshlet.subMesh < 32 && !(view.subMeshMask & (1u << meshlet.subMesh))) {
+            ++LastCull.maskedOut;
+            continue;
+        }
+
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; ++p) {
+            const glm::vec4& plane = planes[p];
+            glm::vec3 corner(plane.x > 0 ? bounds.aabbMax.x : bounds.aabbMin.x,
+                             plane.y > 0 ? bounds.aabbMax.y : bounds.aabbMin.y,
+                             plane.z > 0 ? bounds.aabbMax.z : bounds.aabbMin.z);
+            outside = glm::dot(glm::vec3(plane), corner) + plane.w < 0;
+        }
+        if (outside) {
+            ++LastCull.outsideView;
+            continue;
+        }
+
+        if (view.backFaces) {
+            glm::vec3 toCenter = bounds.center - view.eye;
+            if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + bounds.radius) {
+                ++LastCull.backFacing;
+                continue;
+            }
+        }
+
+        if (view.depthRange) {
+            glm::vec3 boxCenter = (bounds.aabbMin + bounds.aabbMax) * 0.5f;
+            glm::vec3 halfExtent = (bounds.aabbMax - bounds.aabbMin) * 0.5f;
+            float depth = glm::dot(depthAxis, boxCenter) + rows[2].w;
+            float spread = glm::dot(depthSpread, halfExtent);
+            if (depth + spread < view.minDepth || depth - spread > view.maxDepth) {
+                ++LastCull.outsideDepth;
+                continue;
+            }
+        }
+
+        ++LastCull.drawn;
+        if (ranges && starts[ranges - 1] + counts[ranges - 1] == meshlet.indexStart) {
+            counts[ranges - 1] += meshlet.indexCount;
+        }
+        else {
+            starts[ranges] = meshlet.indexStart;
+            counts[ranges] = meshlet.indexCount;
+            ++ranges;
+        }
+    }
+
+    LastCull.ranges = ranges;
+    return ranges;
+}
+
+const MeshletSet::Stats& MeshletSet::getStats() const
+{
+    return LastCull;
+}
+
+void MeshletSet::split(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, const SubMeshList& subMeshes)
+{
+    idxCnt -= idxCnt % 3;
+    Indices.assign(indices, indices + idxCnt);
+
+    // where every sub-mesh, and every run of triangles in none, starts
+    std::vector<std::pair<uint32_t, uint32_t> > spans(1, std::make_pair(0u, NoSubMesh));
+    if (validSubMeshes(subMeshes, idxCnt)) {
+        for (uint32_t s = 0; s < (uint32_t)subMeshes.size(); ++s) {
+            spans.push_back(std::make_pair(subMeshes[s].indexStart, s));
+            spans.push_back(std::make_pair(subMeshes[s].indexStart + subMeshes[s].indexCount, NoSubMesh));
+        }
+    }
+    size_t span = 0;
+
+    // which meshlet last took each vertex, counting from 1
+    std::vector<uint32_t> takenBy(vertCnt, 0);
+    Meshlet current = { 0, 0, glm::vec3(0, 0, 1), 1.0f, NoSubMesh };
+    unsigned int vertices = 0;
+
+    for (unsigned int i = 0; i < idxCnt; i += 3) {
+        uint32_t id = (uint32_t)Meshlets.size() + 1;
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        unsigned int added = (takenBy[a] != id) + (b != a && takenBy[b] != id) + (c != a && c != b && takenBy[c] != id);
+
+        // a meshlet never takes triangles from two sub-meshes
+        uint32_t subMesh = current.subMesh;
+        for (; span < spans.size() && spans[span].first <= i; ++span)
+            subMesh = spans[span].second;
+
+        if (current.indexCount && (subMesh != current.subMesh || vertices + added > MaxVertices || current.indexCount / 3 >= MaxTriangles)) {
+            Meshlets.push_back(current);
+            current.indexStart = i;
+            current.indexCount = 0;
+            vertices = 0;
+            ++id;
+        }
+        current.subMesh = subMesh;
+
+        for (int k = 0; k < 3; ++k) {
+            if (takenBy[indices[i + k]] != id) {
+                takenBy[indices[i + k]] = id;
+                ++vertices;
+            }
+        }
+        current.indexCount += 3;
+    }
+
+    if (current.indexCount)
+        Meshlets.push_back(current);
+}
+
+void MeshletSet::addFrameBounds(const glm::vec3* verts, float padding)
+{
+    for (size_t m = 0; m < Meshlets.size(); ++m) {
+        const Meshlet& meshlet = Meshlets[m];
+        const uint32_t* indices = &Indices[meshlet.indexStart];
+
+        Bounds bounds;
+        bounds.aabbMin = bounds.aabbMax = verts[indices[0]];
+        for (uint32_t i = 1; i < meshlet.indexCount; ++i) {
+            const glm::vec3& v = verts[indices[i]];
+            bounds.aabbMin = glm::min(bounds.aabbMin, v);
+            bounds.aabbMax = glm::max(bounds.aabbMax, v);
+        }
+
+        bounds.center = (bounds.aabbMin + bounds.aabbMax) * 0.5f;
+        float radiusSq = 0;
+        for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+            glm::vec3 d = verts[indices[i]] - bounds.center;
+            radiusSq = std::max(radiusSq, glm::dot(d, d));
+        }
+        bounds.radius = std::sqrt(radiusSq) + padding;
+        bounds.aabbMin -= glm::vec3(padding);
+        bounds.aabbMax += glm::vec3(padding);
+
+        FrameBounds.push_back(bounds);
+    }
+    ++FrameCnt;
+}
+
+void MeshletSet::addConeNormals(const glm::vec3* verts, std::vector<glm::vec3>& axes) const
+{
+    for (size_t m = 0; m < Meshlets.size(); ++m) {
+        const Meshlet& meshlet = Meshlets[m];
+        for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+            bool degenerate;
+            axes[m] += faceNormal(verts, &Indices[meshlet.indexStart + i], degenerate);
+        }
+    }
+}
+
+void MeshletSet::addConeSpread(const glm::vec3* verts, const std::vector<glm::vec3>& axes, std::vector<float>& minDot) const
+{
+    for (size_t m = 0; m < Meshlets.size(); ++m) {
+        const Meshlet& meshlet = Meshlets[m];
+        for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+            bool degenerate;
+            glm::vec3 n = faceNormal(verts, &Indices[meshlet.indexStart + i], degenerate);
+            if (!degenerate)
+                minDot[m] = std::min(minDot[m], glm::dot(n, axes[m]));
+        }
+    }
+}
+
+void MeshletSet::normalizeAxes(std::vector<glm::vec3>& axes, std::vector<float>& minDot)
+{
+    for (size_t m = 0; m < axes.size(); ++m) {
+        float length = glm::length(axes[m]);
+        // faces that cancel out have no direction to cull by
+        if (length == 0)
+            minDot[m] = -1.0f;
+        else
+            axes[m] /= length;
+    }
+}
+
+void MeshletSet::setCones(const std::vector<glm::vec3>& axes, const std::vector<float>& minDot)
+{
+    for (size_t m = 0; m < Meshlets.size(); ++m) {
+        Meshlet& meshlet = Meshlets[m];
+        meshlet.coneAxis = axes[m];
+        meshlet.coneCutoff = minDot[m] <= MinConeSpread ? 1.0f : std::sqrt(1.0f - minDot[m] * minDot[m]);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef MESHLETS_H_
+#define MESHLETS_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "submesh.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    class MeshSequence;
+
+    /**
+    *   A mesh's index buffer cut into meshlets, runs of consecutive
+    *   triangles touching at most MaxVertices vertices, each with bounds
+    *   to cull it by. The index buffer itself is left as it is, so what
+    *   survives culling is drawn as index ranges of the buffer already
+    *   uploaded. Meshlets hold together best on an index order that is
+    *   already cache friendly (see MeshOptimizer).
+    *
+    *   For a keyframe sequence the bounds (sphere and box) of every
+    *   keyframe are kept and blended the same way the positions are, which
+    *   never makes them smaller than the blended triangles. The normal cone
+    *   is one for the whole sequence, covering every keyframe's faces and
+    *   the faces halfway between neighbouring keyframes.
+    *
+    *   Meshlets don't cross from one sub-mesh into another, so a pass can
+    *   leave whole structures out by their sub-mesh along with the culling.
+    */
+    class MeshletSet
+    {
+    public:
+        struct Meshlet
+        {
+            uint32_t indexStart;
+            uint32_t indexCount;
+            glm::vec3 coneAxis;
+            float coneCutoff;       // sine of the cone's spread, 1 when it is too wide to ever cull
+            uint32_t subMesh;       // the mesh's sub-mesh it is part of, NoSubMesh for none
+        };
+
+        struct Bounds
+        {
+            glm::vec3 center;
+            float radius;
+            glm::vec3 aabbMin;
+            glm::vec3 aabbMax;
+        };
+
+        // One pass' point of view, in the mesh's own space.
+        struct CullView
+        {
+            CullView();
+
+            glm::mat4 modelViewProjection;
+            glm::vec3 eye;
+            // only for passes that cull back faces, the others still draw them
+            bool backFaces;
+            // drop meshlets whose clip space z is all outside [minDepth, maxDepth]
+            bool depthRange;
+            float minDepth;
+            float maxDepth;
+            // bit n set draws sub-mesh n, only the first 32 can be left out
+            uint32_t subMeshMask;
+        };
+
+        // What the last cull() did.
+        struct Stats
+        {
+            unsigned int meshlets;
+            unsigned int drawn;
+            unsigned int outsideView;
+            unsigned int backFacing;
+            unsigned int outsideDepth;
+            unsigned int maskedOut;
+            unsigned int ranges;    // draws after neighbouring meshlets are merged
+        };
+
+        MeshletSet();
+
+        // padding grows every bound, for positions that end up drawn a little
+        // off the ones given here (keyframes that get quantized, say).
+        void build(const MeshBuffer& mesh, float padding = 0);
+        void build(const MeshSequence& keyframes, float padding = 0);
+        void clear();
+
+        unsigned int getMeshletCnt() const;
+        unsigned int getFrameCnt() const;
+        const std::vector<Meshlet>& getMeshlets() const;
+
+        // Same frame meaning as MeshSequence::sample, the bounds cull() goes by.
+        void setFrame(float frame, bool loop);
+        const std::vector<Bounds>& getBounds() const;
+
+        // Fills starts and counts, room for getMeshletCnt() each, with the index
+        // ranges left to draw. Returns how many there are.
+        unsigned int cull(const CullView& view, unsigned int* starts, unsigned int* counts);
+        const Stats& getStats() const;
+
+        static const unsigned int MaxVertices = 64;
+        static const unsigned int MaxTriangles = 124;
+        static const uint32_t NoSubMesh = 0xffffffff;
+
+    private:
+        void split(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, const SubMeshList& subMeshes);
+        void addFrameBounds(const glm::vec3* verts, float padding);
+        // cones take two looks at every pose, the mean face normal then the face furthest from it
+        void addConeNormals(const glm::vec3* verts, std::vector<glm::vec3>& axes) const;
+        void addConeSpread(const glm::vec3* verts, const std::vector<glm::vec3>& axes, std::vector<float>& minDot) const;
+        static void normalizeAxes(std::vector<glm::vec3>& axes, std::vector<float>& minDot);
+        void setCones(const std::vector<glm::vec3>& axes, const std::vector<float>& minDot);
+
+        std::vector<Meshlet> Meshlets;
+        std::vector<uint32_t> Indices;
+        std::vector<Bounds> FrameBounds;    // every keyframe's, frame after frame
+        std::vector<Bounds> Current;
+        unsigned int FrameCnt;
+        Stats LastCull;
+    };
+}
+
+#endif // MESHLETS_H_
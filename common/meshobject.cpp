@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 
 #include "meshobject.h"
+#include "framearena.h"
 
 #define bufferOffest(x) ((char*)NULL+(x))
 
@@ -14,12 +15,15 @@ MeshObject::MeshObject()
     , VAO(0)
     , VBO(0)
     , IBO(0)
+    , IndexType(GL_UNSIGNED_INT)
+    , IndexSize(sizeof(GLuint))
     , PivotPoint(0,0,0)
     , AABBMin( 9e23f)
     , AABBMax(-9e23f)
     , IndexRangeStart(0)
     , IndexRangeEnd(0)
     , VertArray(0)
+    , Scratch(0)
     , CleanedUp(true)
 {
     /************************************************************************************
@@ -79,7 +83,7 @@ void MeshObject::render()
     if (IndiceCnt)
     {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-        glDrawElements(GL_TRIANGLES, IndexRangeEnd, GL_UNSIGNED_INT, (const void*)(IndexRangeStart * sizeof(unsigned int)));
+        glDrawElements(GL_TRIANGLES, IndexRangeEnd, IndexType, (const void*)((size_t)IndexRangeStart * IndexSize));
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     else
@@ -90,6 +94,29 @@ void MeshObject::render()
     glBindVertexArray(0);
 }
 
+void MeshObject::render(const unsigned int* rangeStarts, const unsigned int* rangeCounts, unsigned int rangeCnt)
+{
+    if (!IndiceCnt || rangeCnt == 0)
+        return;
+
+    std::vector<const void*> heapOffsets;
+    const void** offsets = 0;
+    if (Scratch)
+        offsets = Scratch->allocate<const void*>(rangeCnt);
+    else {
+        heapOffsets.resize(rangeCnt);
+        offsets = heapOffsets.data();
+    }
+    for (unsigned int i = 0; i < rangeCnt; ++i)
+        offsets[i] = (const void*)((size_t)rangeStarts[i] * IndexSize);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+    glMultiDrawElements(GL_TRIANGLES, (const GLsizei*)rangeCounts, IndexType, offsets, (GLsizei)rangeCnt);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
 void MeshObject::shutdown()
 {
     if (CleanedUp)
@@ -143,28 +170,31 @@ void MeshObject::setMesh(const MeshBuffer& meshBuffer)
     const float* pos = (float*)meshBuffer.getVerts().data();
     const float* norm = (float*)meshBuffer.getNorms().data();
     const float* uv = (float*)meshBuffer.getTexCoords(0).data();
-    VertArray = new float[VertCnt*Stride];
+    // with uvs a copy is kept, updates only rewrite positions and normals
+    delete[] VertArray;
+    VertArray = 0;
+    float* staging = stagingArray(!UvOffset);
 
     for (unsigned int i=0, idx=0, uvidx=0; i<VertCnt; i++, idx+=3, uvidx+=2)
     {
         int vi = i*Stride;
-        VertArray[vi + 0] = pos[idx + 0];
-        VertArray[vi + 1] = pos[idx + 1];
-        VertArray[vi + 2] = pos[idx + 2];
+        staging[vi + 0] = pos[idx + 0];
+        staging[vi + 1] = pos[idx + 1];
+        staging[vi + 2] = pos[idx + 2];
 
         if (NormOffset)
         {
             int ni = i*Stride+NormOffset;
-            VertArray[ni + 0] = norm[idx + 0];
-            VertArray[ni + 1] = norm[idx + 1];
-            VertArray[ni + 2] = norm[idx + 2];
+            staging[ni + 0] = norm[idx + 0];
+            staging[ni + 1] = norm[idx + 1];
+            staging[ni + 2] = norm[idx + 2];
         }
 
         if (UvOffset)
         {
             int ti = i*Stride+UvOffset;
-            VertArray[ti + 0] = uv[uvidx + 0];
-            VertArray[ti + 1] = uv[uvidx + 1];
+            staging[ti + 0] = uv[uvidx + 0];
+            staging[ti + 1] = uv[uvidx + 1];
         }
     }
     // make values go from number of componets to number of bytes
@@ -186,7 +216,7 @@ void MeshObject::setMesh(const MeshBuffer& meshBuffer)
     // set vert buffer    
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, VertCnt*StrideBytes, 0, GL_DYNAMIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, VertCnt*StrideBytes, (const GLvoid*)VertArray);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, VertCnt*StrideBytes, (const GLvoid*)staging);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, StrideBytes, bufferOffest(0));
 
     if (Normalidx)
@@ -195,58 +225,127 @@ void MeshObject::setMesh(const MeshBuffer& meshBuffer)
     if (UVidx)
         glVertexAttribPointer(UVidx, 2, GL_FLOAT, GL_FALSE, StrideBytes, bufferOffest(UvOffset));
 
-    IndiceCnt = meshBuffer.getIdxCnt();
-    if (IndiceCnt)
-    {        
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            IndiceCnt * sizeof(GLuint),
-            (GLvoid*)meshBuffer.getIndices().data(),
-            GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    // small meshes get 16 bit indices, half the memory and fetch bandwidth
+    IndexSize = meshBuffer.getIndexSize();
+    IndexType = meshBuffer.getIndexType() == MeshBuffer::Index16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    IndiceCnt = 0;
+    if (meshBuffer.getIdxCnt())
+        setIndices(meshBuffer.getIndices().data(), meshBuffer.getIdxCnt());
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
 
-        IndexRangeStart = 0;
-        IndexRangeEnd = IndiceCnt;
+void MeshObject::setIndices(const uint32_t* indices, unsigned int count)
+{
+    IndiceCnt = count;
+    std::vector<uint16_t> narrowed;
+    const GLvoid* data = (const GLvoid*)indices;
+    if (IndexType == GL_UNSIGNED_SHORT)
+    {
+        narrowed.assign(indices, indices + count);
+        data = (const GLvoid*)narrowed.data();
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+        IndiceCnt * IndexSize,
+        data,
+        GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
+
+    IndexRangeStart = 0;
+    IndexRangeEnd = IndiceCnt;
 }
 
 void MeshObject::updateBuffers(const MeshBuffer& meshBuffer)
 {
-    const float* pos = (float*)meshBuffer.getVerts().data();
-    const float* norm = (float*)meshBuffer.getNorms().data();
+    if (meshBuffer.getVertexLayout() != MeshBuffer::StructOfArrays) {
+        updateBuffers(meshBuffer.getView());
+        return;
+    }
 
-    if (0 == VertArray)
-        VertArray = new float[VertCnt * Stride];
+    // straight from the streams, no array of structs copy in between
+    bool withNorms = NormOffset && meshBuffer.UsesNormals;
+    float* staging = stagingArray(!UvOffset && (withNorms || !NormOffset));
+
+    ogle::interleaveStreams(meshBuffer.getVertStreams(), staging, Stride, 0);
+    if (withNorms)
+        ogle::interleaveStreams(meshBuffer.getNormStreams(), staging, Stride, NormOffset / sizeof(float));
+    uploadVertArray(staging);
+}
+
+void MeshObject::updateBuffers(const MeshView& mesh)
+{
+    const float* pos = (const float*)mesh.verts;
+    const float* norm = (const float*)mesh.norms;
+    // NormOffset is in bytes once setMesh is done
+    unsigned int normOffset = NormOffset / sizeof(float);
+    float* staging = stagingArray(!UvOffset && (norm || !normOffset));
 
     for (unsigned int i = 0, idx = 0, uvidx = 0; i<VertCnt; i++, idx += 3, uvidx += 2)
     {
         int vi = i*Stride;
-        VertArray[vi + 0] = pos[idx + 0];
-        VertArray[vi + 1] = pos[idx + 1];
-        VertArray[vi + 2] = pos[idx + 2];
+        staging[vi + 0] = pos[idx + 0];
+        staging[vi + 1] = pos[idx + 1];
+        staging[vi + 2] = pos[idx + 2];
 
-        if (NormOffset)
+        if (normOffset && norm)
         {
-            int ni = i*Stride + NormOffset;
-            VertArray[ni + 0] = norm[idx + 0];
-            VertArray[ni + 1] = norm[idx + 1];
-            VertArray[ni + 2] = norm[idx + 2];
+            int ni = i*Stride + normOffset;
+            staging[ni + 0] = norm[idx + 0];
+            staging[ni + 1] = norm[idx + 1];
+            staging[ni + 2] = norm[idx + 2];
         }
     }
 
+    uploadVertArray(staging);
+}
+
+void MeshObject::setFrameArena(ogle::FrameArena* arena)
+{
+    Scratch = arena;
+}
+
+// Where to interleave vertices before uploading them. Frame scratch when
+// every attribute gets rewritten, otherwise the copy kept from last time so
+// the attributes that aren't keep their values.
+float* MeshObject::stagingArray(bool rewritesAll)
+{
+    if (Scratch && rewritesAll)
+        return Scratch->allocate<float>((size_t)VertCnt * Stride);
+
+    if (0 == VertArray)
+        VertArray = new float[VertCnt * Stride];
+    return VertArray;
+}
+
+void MeshObject::uploadVertArray(const float* verts)
+{
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, VertCnt*StrideBytes, 0, GL_DYNAMIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, VertCnt*StrideBytes, (const GLvoid*)VertArray);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, VertCnt*StrideBytes, (const GLvoid*)verts);
 }
 
 void MeshObject::computeBoundingBox(const MeshBuffer& meshBuffer)
 {
-    const std::vector<glm::vec3>& verts = meshBuffer.getVerts();
-    for (int i=0; i<(int)verts.size(); ++i)
+    if (meshBuffer.getVertexLayout() != MeshBuffer::StructOfArrays) {
+        computeBoundingBox(meshBuffer.getView());
+        return;
+    }
+
+    ogle::streamBounds(meshBuffer.getVertStreams(), AABBMin, AABBMax);
+    glm::vec3 diagonal = AABBMax - AABBMin;
+    PivotPoint = AABBMin + (diagonal * 0.5f);
+}
+
+void MeshObject::computeBoundingBox(const MeshView& mesh)
+{
+    const glm::vec3* verts = mesh.verts;
+    for (int i=0; i<(int)mesh.vertCnt; ++i)
     {
         if (verts[i][0] < AABBMin[0]) AABBMin[0] = verts[i][0];
         if (verts[i][1] < AABBMin[1]) AABBMin[1] = verts[i][1];
@@ -4,6 +4,8 @@
 #include "glm/glm.hpp"
 #include "meshbuffer.h"
 
+namespace ogle { class FrameArena; }
+
 class MeshObject
 {
 public:
@@ -14,12 +16,21 @@ public:
 
     void update();
     void render();
+    // Draws index ranges of the buffer (starts and counts in indices) in one multi draw.
+    void render(const unsigned int* rangeStarts, const unsigned int* rangeCounts, unsigned int rangeCnt);
     void shutdown();
 
     void setMesh(const MeshBuffer& meshBuffer);
+    // Replaces the index buffer over the same vertices, the draw range goes back to all of it.
+    void setIndices(const uint32_t* indices, unsigned int count);
     void updateBuffers(const MeshBuffer& meshBuffer);
+    void updateBuffers(const MeshView& mesh);
 
     void computeBoundingBox(const MeshBuffer& meshBuffer);
+    void computeBoundingBox(const MeshView& mesh);
+
+    // Stage vertex uploads in frame scratch memory instead of a copy kept per object.
+    void setFrameArena(ogle::FrameArena* arena);
 
     glm::vec3 PivotPoint;
     glm::vec3 AABBMin;
@@ -30,6 +41,9 @@ public:
     unsigned int IndiceCnt;
 
 private:
+    float* stagingArray(bool rewritesAll);
+    void uploadVertArray(const float* verts);
+
     bool Dirty;                     // If dirty re calculate the mesh buffer to be drawn
     unsigned int VertCnt;
     unsigned int EnabledArrays;
@@ -37,6 +51,8 @@ private:
     unsigned int VAO;
     unsigned int VBO;
     unsigned int IBO;
+    unsigned int IndexType;         // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    unsigned int IndexSize;
 
     unsigned int Normalidx;
     unsigned int UVidx;
@@ -52,6 +68,7 @@ private:
     unsigned int Color1Offset;
 
     float *VertArray;
+    ogle::FrameArena* Scratch;
 
     bool CleanedUp;
 };
@@ -0,0 +1,350 @@
+#include "meshoptimizer.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "meshbuffer.h"
+
+using namespace ogle;
+
+namespace
+{
+    // Forsyth's tuning, the cache being scored against is an LRU of ScoreCacheSize
+    const unsigned int ScoreCacheSize = 32;
+    const unsigned int MaxValence = 32;
+    const float CacheDecayPower = 1.5f;
+    const float LastTriScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+
+    const uint32_t Unmapped = ~0u;
+
+    struct ScoreTables
+    {
+        float cache[ScoreCacheSize];
+        float valence[MaxValence + 1];
+
+        ScoreTables()
+        {
+            for (unsigned int i = 0; i < ScoreCacheSize; ++i) {
+                // the last triangle's three vertices score the same, whichever order they went in
+                if (i < 3)
+                    cache[i] = LastTriScore;
+                else
+                    cache[i] = std::pow(1.0f - (float)(i - 3) / (ScoreCacheSize - 3), CacheDecayPower);
+            }
+
+            // vertices with few triangles left get them done, so they stop being looked at
+            valence[0] = 0;
+            for (unsigned int i = 1; i <= MaxValence; ++i)
+                valence[i] = ValenceBoostScale * std::pow((float)i, -ValenceBoostPower);
+        }
+    };
+
+    const ScoreTables Scores;
+
+    inline float vertexScore(int cachePos, unsigned int remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+
+        float score = cachePos >= 0 ? Scores.cache[cachePos] : 0.0f;
+        return score + Scores.valence[std::min(remaining, MaxValence)];
+    }
+}
+
+MeshOptimizer::MeshOptimizer()
+    : VertCnt(0)
+{
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+void MeshOptimizer::build(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, const SubMeshList& subMeshes)
+{
+    idxCnt -= idxCnt % 3;
+    VertCnt = vertCnt;
+    SourceIndices.assign(indices, indices + idxCnt);
+    SubMeshes = validSubMeshes(subMeshes, idxCnt) ? subMeshes : SubMeshList();
+
+    // triangles only move within their sub-mesh (or the run between two)
+    Indices.resize(idxCnt);
+    Remap.resize(VertCnt);
+    unsigned int start = 0;
+    for (size_t i = 0; i <= SubMeshes.size(); ++i) {
+        unsigned int end = i < SubMeshes.size() ? SubMeshes[i].indexStart : idxCnt;
+        if (end > start)
+            reorderTriangles(indices + start, end - start, VertCnt, Indices.data() + start);
+        if (i == SubMeshes.size())
+            break;
+
+        start = SubMeshes[i].indexStart;
+        end = start + SubMeshes[i].indexCount;
+        if (end > start)
+            reorderTriangles(indices + start, end - start, VertCnt, Indices.data() + start);
+        start = end;
+    }
+
+    Stats.cacheSize = FifoCacheSize;
+    Stats.before = analyze(indices, idxCnt, VertCnt);
+    Stats.after = analyze(Indices.data(), idxCnt, VertCnt);
+
+    // small meshes can already be about as good as it gets, those keep their triangle order
+    if (Stats.after.transforms >= Stats.before.transforms) {
+        Indices = SourceIndices;
+        Stats.after = Stats.before;
+    }
+    reorderVertices(Indices.data(), idxCnt, VertCnt, Remap.data());
+}
+
+void MeshOptimizer::build(const MeshBuffer& mesh)
+{
+    build(mesh.getIndices().data(), mesh.getIdxCnt(), mesh.getVertCnt(), mesh.getSubMeshes());
+}
+
+void MeshOptimizer::clear()
+{
+    VertCnt = 0;
+    SourceIndices.clear();
+    SubMeshes.clear();
+    Indices.clear();
+    Remap.clear();
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+static bool sameRanges(const SubMeshList& a, const SubMeshList& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].indexStart != b[i].indexStart || a[i].indexCount != b[i].indexCount)
+            return false;
+    }
+    return true;
+}
+
+template <typename T>
+static void permute(const std::vector<T>& values, const std::vector<uint32_t>& remap, std::vector<T>& out)
+{
+    out.resize(values.size());
+    for (size_t v = 0; v < values.size(); ++v)
+        out[remap[v]] = values[v];
+}
+
+bool MeshOptimizer::apply(MeshBuffer& mesh) const
+{
+    const std::vector<uint32_t>& indices = mesh.getIndices();
+    if (mesh.getVertCnt() != VertCnt || indices.size() != SourceIndices.size())
+        return false;
+    if (!indices.empty() && memcmp(indices.data(), SourceIndices.data(), indices.size() * sizeof(uint32_t)) != 0)
+        return false;
+    if (!sameRanges(mesh.getSubMeshes(), SubMeshes))
+        return false;
+
+    std::vector<glm::vec3> verts;
+    permute(mesh.getVerts(), Remap, verts);
+    mesh.setVerts(std::move(verts));
+
+    if (mesh.UsesNormals && mesh.getNorms().size() == VertCnt) {
+        std::vector<glm::vec3> norms;
+        permute(mesh.getNorms(), Remap, norms);
+        mesh.setNorms(VertCnt, (const float*)norms.data());
+    }
+
+    if (mesh.UsesUVs && mesh.getTexCoords(0).size() == VertCnt) {
+        std::vector<glm::vec2> coords;
+        permute(mesh.getTexCoords(0), Remap, coords);
+        mesh.setTexCoords(0, VertCnt, (const float*)coords.data());
+    }
+
+    for (unsigned int i = 0; i < (unsigned int)mesh.UsesGenerics.size(); ++i) {
+        if (!mesh.UsesGenerics[i])
+            continue;
+        std::vector<glm::vec4> values;
+        permute(mesh.getGenerics(i), Remap, values);
+        mesh.setGenerics(i, values);
+    }
+
+    std::vector<uint32_t> reordered(Indices);
+    mesh.setIndices(std::move(reordered));
+    return true;
+}
+
+unsigned int MeshOptimizer::getVertCnt() const
+{
+    return VertCnt;
+}
+
+unsigned int MeshOptimizer::getIdxCnt() const
+{
+    return (unsigned int)Indices.size();
+}
+
+const std::vector<uint32_t>& MeshOptimizer::getIndices() const
+{
+    return Indices;
+}
+
+const std::vector<uint32_t>& MeshOptimizer::getRemap() const
+{
+    return Remap;
+}
+
+const MeshOptimizer::Report& MeshOptimizer::getReport() const
+{
+    return Stats;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyze(const uint32_t* indices, unsigned int idxCnt,
+    unsigned int vertCnt, unsigned int cacheSize)
+{
+    CacheStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    // a vertex is in the FIFO while fewer than cacheSize misses came after its own
+    std::vector<uint32_t> missedAt(vertCnt, Unmapped);
+    unsigned int used = 0;
+    for (unsigned int i = 0; i < idxCnt; ++i) {
+        uint32_t v = indices[i];
+        if (missedAt[v] == Unmapped)
+            ++used;
+        else if (stats.transforms - missedAt[v] < cacheSize)
+            continue;
+
+        missedAt[v] = stats.transforms++;
+    }
+
+    unsigned int faceCnt = idxCnt / 3;
+    stats.acmr = faceCnt ? (float)stats.transforms / faceCnt : 0.0f;
+    stats.atvr = used ? (float)stats.transforms / used : 0.0f;
+    return stats;
+}
+
+void MeshOptimizer::reorderTriangles(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, uint32_t* out)
+{
+    unsigned int faceCnt = idxCnt / 3;
+
+    // faces of every vertex, the ones still to go kept at the front of its row
+    std::vector<uint32_t> faceStart(vertCnt + 1, 0);
+    for (unsigned int i = 0; i < faceCnt * 3; ++i)
+        ++faceStart[indices[i] + 1];
+    for (unsigned int v = 0; v < vertCnt; ++v)
+        faceStart[v + 1] += faceStart[v];
+
+    std::vector<uint32_t> vertexFaces(faceCnt * 3);
+    std::vector<uint32_t> remaining(vertCnt, 0);
+    for (unsigned int i = 0; i < faceCnt * 3; ++i) {
+        uint32_t v = indices[i];
+        vertexFaces[faceStart[v] + remaining[v]++] = i / 3;
+    }
+
+    std::vector<int> cachePos(vertCnt, -1);
+    std::vector<float> vertScore(vertCnt);
+    for (unsigned int v = 0; v < vertCnt; ++v)
+        vertScore[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<bool> emitted(faceCnt, false);
+    uint32_t best = Unmapped;
+    float bestScore = -1.0f;
+    for (unsigned int f = 0; f < faceCnt; ++f) {
+        const uint32_t* tri = &indices[3 * f];
+        float score = vertScore[tri[0]] + vertScore[tri[1]] + vertScore[tri[2]];
+        if (score > bestScore) {
+            bestScore = score;
+            best = f;
+        }
+    }
+
+    // room for the triangle being added on top of a full cache
+    uint32_t cache[ScoreCacheSize + 3];
+    uint32_t nextCache[ScoreCacheSize + 3];
+    unsigned int cacheCnt = 0;
+    unsigned int cursor = 0;
+
+    for (unsigned int n = 0; n < faceCnt; ++n) {
+        // nothing in the cache has faces left, go on with the next face in the old order
+        if (best == Unmapped) {
+            while (emitted[cursor])
+                ++cursor;
+            best = cursor;
+        }
+
+        const uint32_t* tri = &indices[3 * best];
+        out[3 * n + 0] = tri[0];
+        out[3 * n + 1] = tri[1];
+        out[3 * n + 2] = tri[2];
+        emitted[best] = true;
+
+        unsigned int nextCnt = 0;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = tri[k];
+            uint32_t* faces = &vertexFaces[faceStart[v]];
+            unsigned int live = remaining[v];
+            for (unsigned int j = 0; j < live; ++j) {
+                if (faces[j] == best) {
+                    faces[j] = faces[live - 1];
+                    break;
+                }
+            }
+            --remaining[v];
+
+            if (std::find(nextCache, nextCache + nextCnt, v) == nextCache + nextCnt)
+                nextCache[nextCnt++] = v;
+        }
+
+        // least recently used go to the back, the face's vertices to the front
+        for (unsigned int i = 0; i < cacheCnt; ++i) {
+            uint32_t v = cache[i];
+            if (v == tri[0] || v == tri[1] || v == tri[2])
+                continue;
+            if (nextCnt < ScoreCacheSize + 3)
+                nextCache[nextCnt++] = v;
+            else
+                cachePos[v] = -1;
+        }
+
+        // ones past ScoreCacheSize just fell out, their faces get scored down too
+        for (unsigned int i = 0; i < nextCnt; ++i) {
+            uint32_t v = nextCache[i];
+            cachePos[v] = i < ScoreCacheSize ? (int)i : -1;
+            vertScore[v] = vertexScore(cachePos[v], remaining[v]);
+        }
+
+        best = Unmapped;
+        bestScore = -1.0f;
+        for (unsigned int i = 0; i < nextCnt; ++i) {
+            uint32_t v = nextCache[i];
+            const uint32_t* faces = &vertexFaces[faceStart[v]];
+            for (unsigned int j = 0; j < remaining[v]; ++j) {
+                uint32_t f = faces[j];
+                const uint32_t* t = &indices[3 * f];
+                float score = vertScore[t[0]] + vertScore[t[1]] + vertScore[t[2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = f;
+                }
+            }
+        }
+
+        std::copy(nextCache, nextCache + nextCnt, cache);
+        cacheCnt = nextCnt;
+    }
+}
+
+void MeshOptimizer::reorderVertices(uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, uint32_t* remap)
+{
+    std::fill(remap, remap + vertCnt, Unmapped);
+
+    uint32_t next = 0;
+    for (unsigned int i = 0; i < idxCnt; ++i) {
+        uint32_t& index = indices[i];
+        if (remap[index] == Unmapped)
+            remap[index] = next++;
+        index = remap[index];
+    }
+
+    for (unsigned int v = 0; v < vertCnt; ++v) {
+        if (remap[v] == Unmapped)
+            remap[v] = next++;
+    }
+}
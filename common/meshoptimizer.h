@@ -0,0 +1,87 @@
+#ifndef MESH_OPTIMIZER_H_
+#define MESH_OPTIMIZER_H_
+
+#include <vector>
+#include <stdint.h>
+
+#include "submesh.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    /**
+    *   Reorders a mesh for the GPU's vertex caches.
+    *
+    *   Triangles are put in an order that reuses recently transformed
+    *   vertices (Forsyth's linear speed vertex cache optimisation, scored
+    *   against a 32 entry LRU cache), then vertices are renumbered in the
+    *   order the new triangles first use them so fetches walk the vertex
+    *   buffer forwards. Vertices no triangle uses go last, in their old order.
+    *   A triangle order that doesn't beat the original is not kept.
+    *   Triangles never leave their sub-mesh, the ranges stay as they were.
+    *
+    *   The order is worked out once from one topology and can then be
+    *   applied to any number of meshes sharing it, every keyframe of a
+    *   sequence gets the same permutation that way.
+    */
+    class MeshOptimizer
+    {
+    public:
+        // Post transform cache behaviour of an index order, simulated as a FIFO.
+        struct CacheStats
+        {
+            float acmr;                 // vertices transformed per triangle, 0.5 at best, 3 at worst
+            float atvr;                 // vertices transformed per vertex used, 1 at best
+            unsigned int transforms;
+        };
+
+        struct Report
+        {
+            CacheStats before;
+            CacheStats after;
+            unsigned int cacheSize;
+        };
+
+        MeshOptimizer();
+
+        void build(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt,
+            const SubMeshList& subMeshes = SubMeshList());
+        void build(const MeshBuffer& mesh);
+        void clear();
+
+        // Moves mesh's vertices (positions, normals, uvs, generics) and
+        // triangles into the built order. Returns false, leaving mesh alone, if
+        // its indices (or sub-meshes) aren't the ones the order was built from.
+        bool apply(MeshBuffer& mesh) const;
+
+        unsigned int getVertCnt() const;
+        unsigned int getIdxCnt() const;
+        // reordered triangles, in the new vertex numbering
+        const std::vector<uint32_t>& getIndices() const;
+        // new number of every old vertex
+        const std::vector<uint32_t>& getRemap() const;
+        const Report& getReport() const;
+
+        static CacheStats analyze(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt,
+            unsigned int cacheSize = FifoCacheSize);
+
+        // out gets idxCnt indices, the same triangles in cache friendly order.
+        static void reorderTriangles(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, uint32_t* out);
+        // Renumbers indices in place into first use order, remap gets vertCnt entries.
+        static void reorderVertices(uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt, uint32_t* remap);
+
+        // what analyze() simulates unless told otherwise, about what current GPUs keep
+        static const unsigned int FifoCacheSize = 16;
+
+    private:
+        unsigned int VertCnt;
+        std::vector<uint32_t> SourceIndices;
+        SubMeshList SubMeshes;
+        std::vector<uint32_t> Indices;
+        std::vector<uint32_t> Remap;
+        Report Stats;
+    };
+}
+
+#endif // MESH_OPTIMIZER_H_
@@ -0,0 +1,347 @@
+#include "meshsequence.h"
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "meshbuffer.h"
+
+using namespace std;
+using namespace ogle;
+
+MeshSequence::MeshSequence()
+    : StorageLayout(FrameMajor)
+    , VertCnt(0)
+    , FrameCnt(0)
+    , ReservedFrames(0)
+    , StreamSize(0)
+{
+}
+
+bool MeshSequence::addFrame(const MeshBuffer& frame)
+{
+    if (FrameCnt == 0) {
+        VertCnt = frame.getVertCnt();
+        Indices = frame.getIndices();
+        SubMeshes = frame.getSubMeshes();
+        StreamSize = VertexStreams::padCount(VertCnt);
+        reserve(ReservedFrames);
+    }
+    else if (frame.getVertCnt() != VertCnt || frame.getIndices() != Indices) {
+        cerr << "[!] MeshSequence: frame " << FrameCnt << " does not share the topology of frame 0" << endl;
+        return false;
+    }
+
+    const std::vector<glm::vec3>& verts = frame.getVerts();
+    if (StorageLayout == FrameMajorStreams) {
+        size_t base = Streams.size();
+        Streams.resize(base + 3 * (size_t)StreamSize);
+        float* xs = &Streams[base];
+        for (unsigned int v = 0; v < VertCnt; ++v) {
+            xs[v] = verts[v].x;
+            xs[v + StreamSize] = verts[v].y;
+            xs[v + 2 * StreamSize] = verts[v].z;
+        }
+        ++FrameCnt;
+        return true;
+    }
+
+    // appending is only cheap frame major, swap back afterwards
+    Layout layout = StorageLayout;
+    if (layout != FrameMajor)
+        setLayout(FrameMajor);
+
+    Positions.insert(Positions.end(), verts.begin(), verts.begin() + VertCnt);
+    ++FrameCnt;
+
+    if (layout != FrameMajor)
+        setLayout(layout);
+    return true;
+}
+
+void MeshSequence::reserve(unsigned int frameCount)
+{
+    ReservedFrames = frameCount;
+    if (VertCnt == 0)
+        return;
+    if (StorageLayout == FrameMajorStreams)
+        Streams.reserve((size_t)ReservedFrames * 3 * StreamSize);
+    else
+        Positions.reserve((size_t)ReservedFrames * VertCnt);
+}
+
+void MeshSequence::clear()
+{
+    VertCnt = 0;
+    FrameCnt = 0;
+    ReservedFrames = 0;
+    StreamSize = 0;
+    std::vector<uint32_t>().swap(Indices);
+    SubMeshList().swap(SubMeshes);
+    std::vector<glm::vec3>().swap(Positions);
+    AlignedFloats().swap(Streams);
+}
+
+void MeshSequence::setLayout(Layout layout)
+{
+    if (layout == StorageLayout)
+        return;
+
+    // streams only convert to and from FrameMajor, VertexMajor goes by way of it
+    if (StorageLayout == FrameMajorStreams)
+        unpackStreams();
+    if (layout == FrameMajorStreams) {
+        reorder(FrameMajor);
+        packStreams();
+    }
+    else
+        reorder(layout);
+}
+
+void MeshSequence::reorder(Layout layout)
+{
+    if (layout == StorageLayout)
+        return;
+
+    std::vector<glm::vec3> reordered(Positions.size());
+    for (unsigned int f = 0; f < FrameCnt; ++f) {
+        for (unsigned int v = 0; v < VertCnt; ++v) {
+            size_t frameMajor = (size_t)f * VertCnt + v;
+            size_t vertexMajor = (size_t)v * FrameCnt + f;
+            if (layout == VertexMajor)
+                reordered[vertexMajor] = Positions[frameMajor];
+            else
+                reordered[frameMajor] = Positions[vertexMajor];
+        }
+    }
+    Positions.swap(reordered);
+    StorageLayout = layout;
+}
+
+void MeshSequence::packStreams()
+{
+    AlignedFloats streams;
+    streams.reserve((size_t)std::max(ReservedFrames, FrameCnt) * 3 * StreamSize);
+    streams.resize((size_t)FrameCnt * 3 * StreamSize);
+    for (unsigned int f = 0; f < FrameCnt; ++f) {
+        const glm::vec3* verts = &Positions[(size_t)f * VertCnt];
+        float* xs = &streams[(size_t)f * 3 * StreamSize];
+        for (unsigned int v = 0; v < VertCnt; ++v) {
+            xs[v] = verts[v].x;
+            xs[v + StreamSize] = verts[v].y;
+            xs[v + 2 * StreamSize] = verts[v].z;
+        }
+    }
+    Streams.swap(streams);
+    std::vector<glm::vec3>().swap(Positions);
+    StorageLayout = FrameMajorStreams;
+}
+
+void MeshSequence::unpackStreams()
+{
+    std::vector<glm::vec3> positions;
+    positions.reserve((size_t)std::max(ReservedFrames, FrameCnt) * VertCnt);
+    positions.resize((size_t)FrameCnt * VertCnt);
+    for (unsigned int f = 0; f < FrameCnt; ++f) {
+        const float* xs = frameStreams(f);
+        glm::vec3* verts = &positions[(size_t)f * VertCnt];
+        for (unsigned int v = 0; v < VertCnt; ++v)
+            verts[v] = glm::vec3(xs[v], xs[v + StreamSize], xs[v + 2 * StreamSize]);
+    }
+    Positions.swap(positions);
+    AlignedFloats().swap(Streams);
+    StorageLayout = FrameMajor;
+}
+
+MeshSequence::Layout MeshSequence::getLayout() const
+{
+    return StorageLayout;
+}
+
+unsigned int MeshSequence::getFrameCnt() const
+{
+    return FrameCnt;
+}
+
+unsigned int MeshSequence::getVertCnt() const
+{
+    return VertCnt;
+}
+
+unsigned int MeshSequence::getIdxCnt() const
+{
+    return (unsigned int)Indices.size();
+}
+
+const std::vector<uint32_t>& MeshSequence::getIndices() const
+{
+    return Indices;
+}
+
+const SubMeshList& MeshSequence::getSubMeshes() const
+{
+    return SubMeshes;
+}
+
+size_t MeshSequence::positionIndex(unsigned int frame, unsigned int vert) const
+{
+    if (StorageLayout == FrameMajor)
+        return (size_t)frame * VertCnt + vert;
+    return (size_t)vert * FrameCnt + frame;
+}
+
+const float* MeshSequence::frameStreams(unsigned int frame) const
+{
+    return &Streams[(size_t)frame * 3 * StreamSize];
+}
+
+glm::vec3 MeshSequence::getVert(unsigned int frame, unsigned int vert) const
+{
+    if (StorageLayout == FrameMajorStreams) {
+        const float* xs = frameStreams(frame);
+        return glm::vec3(xs[vert], xs[vert + StreamSize], xs[vert + 2 * StreamSize]);
+    }
+    return Positions[positionIndex(frame, vert)];
+}
+
+void MeshSequence::getFrame(unsigned int frame, std::vector<glm::vec3>& verts) const
+{
+    verts.resize(VertCnt);
+    if (StorageLayout == FrameMajor) {
+        if (VertCnt)
+            memcpy(&verts[0], &Positions[(size_t)frame * VertCnt], VertCnt * sizeof(glm::vec3));
+        return;
+    }
+    for (unsigned int v = 0; v < VertCnt; ++v)
+        verts[v] = getVert(frame, v);
+}
+
+void MeshSequence::sample(float frame, bool loop, std::vector<glm::vec3>& verts) const
+{
+    verts.resize(FrameCnt ? VertCnt : 0);
+    if (FrameCnt)
+        sample(frame, loop, verts.data());
+}
+
+void MeshSequence::sample(float frame, bool loop, glm::vec3* verts) const
+{
+    if (FrameCnt == 0)
+        return;
+
+    unsigned int frameA, frameB;
+    float tween;
+    findKeyframes(frame, loop, FrameCnt, frameA, frameB, tween);
+    sample(frameA, frameB, tween, verts);
+}
+
+void MeshSequence::findKeyframes(float frame, bool loop, unsigned int frameCnt, unsigned int& frameA, unsigned int& frameB, float& tween)
+{
+    float wholeFrame;
+    tween = modf(frame, &wholeFrame);
+
+    frameA = (unsigned int)std::max(0.f, wholeFrame);
+    frameB = frameA + 1;
+    if (loop) {
+        frameA %= frameCnt;
+        frameB %= frameCnt;
+    }
+    else {
+        if (frameA >= frameCnt - 1) {
+            frameA = frameCnt - 1;
+            tween = 0;
+        }
+        frameB = std::min(frameB, frameCnt - 1);
+    }
+}
+
+void MeshSequence::sample(unsigned int frameA, unsigned int frameB, float tween, std::vector<glm::vec3>& verts) const
+{
+    verts.resize(VertCnt);
+    if (VertCnt)
+        sample(frameA, frameB, tween, verts.data());
+}
+
+void MeshSequence::sample(unsigned int frameA, unsigned int frameB, float tween, glm::vec3* verts) const
+{
+    if (StorageLayout == FrameMajor) {
+        const glm::vec3* vertsA = &Positions[(size_t)frameA * VertCnt];
+        const glm::vec3* vertsB = &Positions[(size_t)frameB * VertCnt];
+        for (unsigned int i = 0; i < VertCnt; ++i)
+            verts[i] = tween * (vertsB[i] - vertsA[i]) + vertsA[i];
+    }
+    else if (StorageLayout == VertexMajor) {
+        // every keyframe of a vertex sits together, so A and B share a cache line or two
+        const glm::vec3* keyframes = Positions.data();
+        for (unsigned int i = 0; i < VertCnt; ++i, keyframes += FrameCnt)
+            verts[i] = tween * (keyframes[frameB] - keyframes[frameA]) + keyframes[frameA];
+    }
+    else {
+        for (unsigned int i = 0; i < VertCnt; ++i) {
+            glm::vec3 a = getVert(frameA, i);
+            verts[i] = tween * (getVert(frameB, i) - a) + a;
+        }
+    }
+}
+
+void MeshSequence::sample(float frame, bool loop, VertexStreams& verts) const
+{
+    if (FrameCnt == 0) {
+        verts.resize(0);
+        return;
+    }
+
+    unsigned int frameA, frameB;
+    float tween;
+    findKeyframes(frame, loop, FrameCnt, frameA, frameB, tween);
+    sample(frameA, frameB, tween, verts);
+}
+
+void MeshSequence::sample(unsigned int frameA, unsigned int frameB, float tween, VertexStreams& verts) const
+{
+    verts.resize(VertCnt);
+    if (StorageLayout == FrameMajorStreams) {
+        // a frame's three streams sit back to back and are padded the same as verts'
+        lerpStreams(frameStreams(frameA), frameStreams(frameB), tween, verts.data(), 3 * (size_t)StreamSize);
+        return;
+    }
+
+    float* xs = verts.x();
+    float* ys = verts.y();
+    float* zs = verts.z();
+    for (unsigned int i = 0; i < VertCnt; ++i) {
+        glm::vec3 a = getVert(frameA, i);
+        glm::vec3 v = tween * (getVert(frameB, i) - a) + a;
+        xs[i] = v.x;
+        ys[i] = v.y;
+        zs[i] = v.z;
+    }
+}
+
+void MeshSequence::makeMesh(unsigned int frame, MeshBuffer& mesh) const
+{
+    std::vector<glm::vec3> verts;
+    getFrame(frame, verts);
+    mesh.setVerts(std::move(verts));
+    mesh.setIndices((unsigned int)Indices.size(), Indices.data());
+    mesh.setSubMeshes(SubMeshes);
+}
+
+MeshView MeshSequence::getFrameView(unsigned int frame) const
+{
+    MeshView view;
+    if (StorageLayout != FrameMajor || frame >= FrameCnt)
+        return view;
+
+    view.verts = &Positions[(size_t)frame * VertCnt];
+    view.indices = Indices.data();
+    view.vertCnt = VertCnt;
+    view.idxCnt = (unsigned int)Indices.size();
+    return view;
+}
+
+size_t MeshSequence::getMemoryUsage() const
+{
+    return Positions.capacity() * sizeof(glm::vec3) + Streams.capacity() * sizeof(float)
+        + Indices.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,106 @@
+#ifndef MESH_SEQUENCE_H_
+#define MESH_SEQUENCE_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "vertexstreams.h"
+#include "submesh.h"
+
+class MeshBuffer;
+struct MeshView;
+
+namespace ogle
+{
+    /**
+    *   Keyframes of an animated mesh that all share one topology.
+    *   Indices are stored once, only positions are kept per frame.
+    *
+    *   FrameMajor keeps each frame's positions together, which streams best
+    *   when blending two whole frames. VertexMajor keeps every keyframe of a
+    *   vertex together, for work that looks at one vertex across all time.
+    *   FrameMajorStreams keeps each frame as aligned x, y and z streams (see
+    *   VertexStreams), blending into VertexStreams then runs at full vector width.
+    */
+    class MeshSequence
+    {
+    public:
+        enum Layout
+        {
+            FrameMajor,
+            VertexMajor,
+            FrameMajorStreams
+        };
+
+        MeshSequence();
+
+        // The first frame sets the topology, returns false (and drops the frame)
+        // if a later one does not have the same vertex count and indices.
+        bool addFrame(const MeshBuffer& frame);
+        void clear();
+
+        // Room for this many keyframes is set aside once the first frame fixes the vertex count.
+        void reserve(unsigned int frameCount);
+
+        void setLayout(Layout layout);
+        Layout getLayout() const;
+
+        unsigned int getFrameCnt() const;
+        unsigned int getVertCnt() const;
+        unsigned int getIdxCnt() const;
+        const std::vector<uint32_t>& getIndices() const;
+        // the first frame's
+        const SubMeshList& getSubMeshes() const;
+
+        glm::vec3 getVert(unsigned int frame, unsigned int vert) const;
+        void getFrame(unsigned int frame, std::vector<glm::vec3>& verts) const;
+
+        // frame is fractional, 2.25 is a quarter of the way from keyframe 2 to 3.
+        // When looping the last keyframe blends back into the first, otherwise it holds.
+        void sample(float frame, bool loop, std::vector<glm::vec3>& verts) const;
+        void sample(unsigned int frameA, unsigned int frameB, float tween, std::vector<glm::vec3>& verts) const;
+
+        // Same as above into caller owned storage of getVertCnt() positions, never allocates.
+        void sample(float frame, bool loop, glm::vec3* verts) const;
+        void sample(unsigned int frameA, unsigned int frameB, float tween, glm::vec3* verts) const;
+
+        // Into structure of arrays storage, only allocates if verts is not yet getVertCnt() long.
+        void sample(float frame, bool loop, VertexStreams& verts) const;
+        void sample(unsigned int frameA, unsigned int frameB, float tween, VertexStreams& verts) const;
+
+        // Splits a fractional frame into the two keyframes to blend and the amount of the second.
+        static void findKeyframes(float frame, bool loop, unsigned int frameCnt, unsigned int& frameA, unsigned int& frameB, float& tween);
+
+        // Fills mesh with one keyframe and the shared indices.
+        void makeMesh(unsigned int frame, MeshBuffer& mesh) const;
+
+        // Looks at one keyframe in place, FrameMajor only (the view is empty otherwise).
+        MeshView getFrameView(unsigned int frame) const;
+
+        size_t getMemoryUsage() const;
+
+    private:
+        size_t positionIndex(unsigned int frame, unsigned int vert) const;
+        // x stream of a frame, the y and z streams follow StreamSize floats apart
+        const float* frameStreams(unsigned int frame) const;
+
+        void reorder(Layout layout);
+        void packStreams();
+        void unpackStreams();
+
+        Layout StorageLayout;
+        unsigned int VertCnt;
+        unsigned int FrameCnt;
+        unsigned int ReservedFrames;
+
+        std::vector<uint32_t> Indices;
+        SubMeshList SubMeshes;
+        std::vector<glm::vec3> Positions;
+        // FrameMajorStreams only, Positions is empty then
+        AlignedFloats Streams;
+        unsigned int StreamSize;
+    };
+}
+
+#endif // MESH_SEQUENCE_H_
@@ -0,0 +1,355 @@
+#include "normalengine.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "meshbuffer.h"
+
+using namespace ogle;
+
+namespace
+{
+    // The kernels below are written once against these, for positions and
+    // normals kept either as vec3s or as VertexStreams.
+    struct ArrayIn
+    {
+        const glm::vec3* verts;
+        float x(uint32_t i) const { return verts[i].x; }
+        float y(uint32_t i) const { return verts[i].y; }
+        float z(uint32_t i) const { return verts[i].z; }
+    };
+
+    struct StreamIn
+    {
+        const float* xs;
+        const float* ys;
+        const float* zs;
+        float x(uint32_t i) const { return xs[i]; }
+        float y(uint32_t i) const { return ys[i]; }
+        float z(uint32_t i) const { return zs[i]; }
+    };
+
+    struct ArrayOut
+    {
+        glm::vec3* norms;
+        void set(unsigned int i, float x, float y, float z) const { norms[i] = glm::vec3(x, y, z); }
+    };
+
+    struct StreamOut
+    {
+        float* xs;
+        float* ys;
+        float* zs;
+        void set(unsigned int i, float x, float y, float z) const { xs[i] = x; ys[i] = y; zs[i] = z; }
+    };
+}
+
+// glm::cross(b - a, c - a) spelled out, its length is twice the face's area.
+template <typename In>
+static inline void faceCross(const In& in, const uint32_t* tri, float& x, float& y, float& z)
+{
+    uint32_t a = tri[0];
+    uint32_t b = tri[1];
+    uint32_t c = tri[2];
+
+    float abx = in.x(b) - in.x(a), aby = in.y(b) - in.y(a), abz = in.z(b) - in.z(a);
+    float acx = in.x(c) - in.x(a), acy = in.y(c) - in.y(a), acz = in.z(c) - in.z(a);
+
+    x = aby * acz - acy * abz;
+    y = abz * acx - acz * abx;
+    z = abx * acy - acx * aby;
+}
+
+// FaceNormals: the normal of the vertex's last face, worked out straight
+// from the positions. A vertex has fewer faces to look at than the mesh has
+// faces, so this is cheaper than a face pass followed by a gather.
+template <typename In, typename Out>
+static void lastFaceNormals(const In& in, const Out& out, const uint32_t* indices,
+    const uint32_t* faceStart, const uint32_t* vertexFaces, unsigned int begin, unsigned int end)
+{
+    for (unsigned int v = begin; v < end; ++v) {
+        if (faceStart[v] == faceStart[v + 1]) {
+            out.set(v, 0, 0, 0);
+            continue;
+        }
+
+        float x, y, z;
+        faceCross(in, &indices[3 * (size_t)vertexFaces[faceStart[v + 1] - 1]], x, y, z);
+        // as glm::normalize, so the bits match MeshBuffer::generateFaceNormals
+        float scale = 1.0f / std::sqrt(x * x + y * y + z * z);
+        out.set(v, x * scale, y * scale, z * scale);
+    }
+}
+
+// AreaWeighted, first pass: unnormalized normal of every face into streams.
+// Each face is written once, so it vectorizes.
+template <typename In>
+static void rawFaceNormals(const In& in, const uint32_t* indices, float* fx, float* fy, float* fz,
+    unsigned int begin, unsigned int end)
+{
+    for (unsigned int f = begin; f < end; ++f)
+        faceCross(in, &indices[3 * (size_t)f], fx[f], fy[f], fz[f]);
+}
+
+// AreaWeighted, second pass: sum of a vertex's faces, always in the same order.
+template <typename Out>
+static void sumFaceNormals(const Out& out, const float* fx, const float* fy, const float* fz,
+    const uint32_t* faceStart, const uint32_t* vertexFaces, unsigned int begin, unsigned int end)
+{
+    for (unsigned int v = begin; v < end; ++v) {
+        float x = 0, y = 0, z = 0;
+        for (uint32_t k = faceStart[v]; k < faceStart[v + 1]; ++k) {
+            uint32_t f = vertexFaces[k];
+            x += fx[f];
+            y += fy[f];
+            z += fz[f];
+        }
+
+        float lengthSq = x * x + y * y + z * z;
+        float scale = lengthSq > 0 ? 1.0f / std::sqrt(lengthSq) : 0.0f;
+        out.set(v, x * scale, y * scale, z * scale);
+    }
+}
+
+NormalEngine::NormalEngine()
+    : NormalMode(FaceNormals)
+    , ThreadCount(0)
+    , VertCnt(0)
+    , FaceStride(0)
+    , InVerts(0)
+    , OutNorms(0)
+    , InStreams(0)
+    , OutStreams(0)
+    , Generation(0)
+    , CurrentPass(VertexPass)
+    , CurrentParts(0)
+    , Pending(0)
+    , Stopping(false)
+{
+}
+
+NormalEngine::~NormalEngine()
+{
+    stopWorkers();
+}
+
+void NormalEngine::setMode(Mode mode)
+{
+    NormalMode = mode;
+}
+
+NormalEngine::Mode NormalEngine::getMode() const
+{
+    return NormalMode;
+}
+
+void NormalEngine::setThreadCount(unsigned int count)
+{
+    if (count == ThreadCount)
+        return;
+    // workers are started again as the next generate needs them
+    stopWorkers();
+    ThreadCount = count;
+}
+
+unsigned int NormalEngine::getThreadCount() const
+{
+    return ThreadCount;
+}
+
+void NormalEngine::setTopology(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt)
+{
+    unsigned int faceCnt = idxCnt / 3;
+    VertCnt = vertCnt;
+    Indices.assign(indices, indices + faceCnt * 3);
+
+    // counting sort of the corners by vertex, faces stay in index order
+    FaceStart.assign(VertCnt + 1, 0);
+    for (size_t i = 0; i < Indices.size(); ++i)
+        ++FaceStart[Indices[i] + 1];
+    for (unsigned int v = 0; v < VertCnt; ++v)
+        FaceStart[v + 1] += FaceStart[v];
+
+    VertexFaces.resize(Indices.size());
+    std::vector<uint32_t> fill(FaceStart.begin(), FaceStart.end() - 1);
+    for (size_t i = 0; i < Indices.size(); ++i)
+        VertexFaces[fill[Indices[i]]++] = (uint32_t)(i / 3);
+
+    // the face pass scratch is only set aside once AreaWeighted asks for it
+    AlignedFloats().swap(FaceNorms);
+    FaceStride = VertexStreams::padCount(faceCnt);
+}
+
+unsigned int NormalEngine::getVertCnt() const
+{
+    return VertCnt;
+}
+
+unsigned int NormalEngine::getIdxCnt() const
+{
+    return (unsigned int)Indices.size();
+}
+
+void NormalEngine::generate(const glm::vec3* verts, glm::vec3* norms)
+{
+    InVerts = verts;
+    OutNorms = norms;
+    InStreams = 0;
+    OutStreams = 0;
+
+    if (NormalMode == AreaWeighted)
+        run(FacePass);
+    run(VertexPass);
+}
+
+void NormalEngine::generate(const VertexStreams& verts, VertexStreams& norms)
+{
+    norms.resize(VertCnt);
+    InVerts = 0;
+    OutNorms = 0;
+    InStreams = &verts;
+    OutStreams = &norms;
+
+    if (NormalMode == AreaWeighted)
+        run(FacePass);
+    run(VertexPass);
+}
+
+void NormalEngine::generate(MeshBuffer& mesh)
+{
+    if (mesh.getVertCnt() != VertCnt || mesh.getIdxCnt() != Indices.size())
+        setTopology(mesh.getIndices().data(), mesh.getIdxCnt(), mesh.getVertCnt());
+
+    if (mesh.getVertexLayout() == MeshBuffer::StructOfArrays)
+        generate(mesh.getVertStreams(), mesh.getWritableNormStreams());
+    else
+        generate(mesh.getVerts().data(), mesh.getWritableNorms());
+}
+
+unsigned int NormalEngine::partsFor(unsigned int count) const
+{
+    unsigned int threads = ThreadCount;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, std::max(1u, count / MinVertsPerThread));
+    }
+    // every part gets at least a vector's worth
+    return std::max(1u, std::min(threads, count / (unsigned int)SimdWidth));
+}
+
+void NormalEngine::run(Pass pass)
+{
+    if (pass == FacePass && FaceNorms.size() != 3 * (size_t)FaceStride)
+        FaceNorms.assign(3 * (size_t)FaceStride, 0.0f);
+
+    unsigned int count = pass == FacePass ? (unsigned int)Indices.size() / 3 : VertCnt;
+    unsigned int parts = partsFor(count);
+    if (parts <= 1) {
+        runPart(pass, 0, 1);
+        return;
+    }
+
+    if (Workers.size() < parts - 1)
+        startWorkers(parts - 1);
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        CurrentPass = pass;
+        CurrentParts = parts;
+        Pending = parts - 1;
+        ++Generation;
+    }
+    Start.notify_all();
+
+    // the calling thread takes the first part
+    runPart(pass, 0, parts);
+
+    std::unique_lock<std::mutex> lock(Mutex);
+    Done.wait(lock, [this]() { return Pending == 0; });
+}
+
+void NormalEngine::runPart(Pass pass, unsigned int part, unsigned int parts)
+{
+    unsigned int count = pass == FacePass ? (unsigned int)Indices.size() / 3 : VertCnt;
+
+    // ranges start on vector boundaries so no two threads write one cache line
+    unsigned int chunk = (count + parts - 1) / parts;
+    chunk = VertexStreams::padCount(chunk);
+    unsigned int begin = std::min(count, part * chunk);
+    unsigned int end = std::min(count, begin + chunk);
+    if (begin == end)
+        return;
+
+    const uint32_t* indices = Indices.data();
+    const uint32_t* faceStart = FaceStart.data();
+    const uint32_t* vertexFaces = VertexFaces.data();
+    float* fx = FaceNorms.data();
+    float* fy = fx + FaceStride;
+    float* fz = fy + FaceStride;
+
+    if (InStreams) {
+        StreamIn in = { InStreams->x(), InStreams->y(), InStreams->z() };
+        StreamOut out = { OutStreams->x(), OutStreams->y(), OutStreams->z() };
+        if (pass == FacePass)
+            rawFaceNormals(in, indices, fx, fy, fz, begin, end);
+        else if (NormalMode == AreaWeighted)
+            sumFaceNormals(out, fx, fy, fz, faceStart, vertexFaces, begin, end);
+        else
+            lastFaceNormals(in, out, indices, faceStart, vertexFaces, begin, end);
+    }
+    else {
+        ArrayIn in = { InVerts };
+        ArrayOut out = { OutNorms };
+        if (pass == FacePass)
+            rawFaceNormals(in, indices, fx, fy, fz, begin, end);
+        else if (NormalMode == AreaWeighted)
+            sumFaceNormals(out, fx, fy, fz, faceStart, vertexFaces, begin, end);
+        else
+            lastFaceNormals(in, out, indices, faceStart, vertexFaces, begin, end);
+    }
+}
+
+void NormalEngine::startWorkers(unsigned int count)
+{
+    // new workers start from the current generation, so they only pick up work posted after this
+    for (size_t i = Workers.size(); i < count; ++i)
+        Workers.push_back(std::thread(&NormalEngine::workerLoop, this, (unsigned int)i + 1, Generation));
+}
+
+void NormalEngine::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stopping = true;
+    }
+    Start.notify_all();
+    for (size_t i = 0; i < Workers.size(); ++i)
+        Workers[i].join();
+    Workers.clear();
+    Stopping = false;
+}
+
+void NormalEngine::workerLoop(unsigned int part, uint64_t seen)
+{
+    for (;;) {
+        Pass pass;
+        unsigned int parts;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Start.wait(lock, [&]() { return Stopping || Generation != seen; });
+            if (Stopping)
+                return;
+            seen = Generation;
+            pass = CurrentPass;
+            parts = CurrentParts;
+        }
+
+        if (part >= parts)
+            continue;
+
+        runPart(pass, part, parts);
+
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (--Pending == 0)
+            Done.notify_one();
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef NORMAL_ENGINE_H_
+#define NORMAL_ENGINE_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "vertexstreams.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    /**
+    *   Per-vertex normals for meshes whose positions change every frame but
+    *   whose triangles don't.
+    *
+    *   The vertex to face adjacency is built once per topology (compressed
+    *   rows: each vertex's faces sit together, in index order). Normals are
+    *   then worked out per vertex from its own faces, so vertex ranges run on
+    *   separate threads without sharing any writes, and the result is the
+    *   same bits whatever the thread count.
+    *
+    *   FaceNormals gives every vertex the normal of the last face that uses
+    *   it, the same as MeshBuffer::generateFaceNormals. AreaWeighted sums the
+    *   unnormalized face normals around the vertex, larger faces counting
+    *   for more, for smooth shading.
+    */
+    class NormalEngine
+    {
+    public:
+        enum Mode
+        {
+            FaceNormals,
+            AreaWeighted
+        };
+
+        NormalEngine();
+        ~NormalEngine();
+
+        void setMode(Mode mode);
+        Mode getMode() const;
+
+        // Threads normals are worked out on, counting the caller. 0 picks one per
+        // core, capped so every thread gets at least MinVertsPerThread vertices.
+        void setThreadCount(unsigned int count);
+        unsigned int getThreadCount() const;
+
+        // Builds the adjacency, needed again only when the triangles change.
+        void setTopology(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt);
+        unsigned int getVertCnt() const;
+        unsigned int getIdxCnt() const;
+
+        // norms holds getVertCnt() normals, vertices no face uses get zero.
+        void generate(const glm::vec3* verts, glm::vec3* norms);
+        void generate(const VertexStreams& verts, VertexStreams& norms);
+
+        // Fills mesh's normals in whichever layout it keeps, sets the topology
+        // up from it first if the vertex or index count differs.
+        void generate(MeshBuffer& mesh);
+
+        static const unsigned int MinVertsPerThread = 4096;
+
+    private:
+        NormalEngine(const NormalEngine& other);
+        NormalEngine& operator=(const NormalEngine& other);
+
+        enum Pass
+        {
+            FacePass,       // raw face normals, AreaWeighted only
+            VertexPass
+        };
+
+        void run(Pass pass);
+        void runPart(Pass pass, unsigned int part, unsigned int parts);
+        unsigned int partsFor(unsigned int count) const;
+        void startWorkers(unsigned int count);
+        void stopWorkers();
+        void workerLoop(unsigned int part, uint64_t seen);
+
+        Mode NormalMode;
+        unsigned int ThreadCount;
+        unsigned int VertCnt;
+
+        std::vector<uint32_t> Indices;
+        std::vector<uint32_t> FaceStart;    // VertCnt + 1 offsets into VertexFaces
+        std::vector<uint32_t> VertexFaces;  // face ids, grouped by vertex
+        AlignedFloats FaceNorms;            // AreaWeighted scratch, x/y/z streams of FaceStride floats
+        unsigned int FaceStride;
+
+        // what the current pass reads and writes
+        const glm::vec3* InVerts;
+        glm::vec3* OutNorms;
+        const VertexStreams* InStreams;
+        VertexStreams* OutStreams;
+
+        std::vector<std::thread> Workers;
+        std::mutex Mutex;
+        std::condition_variable Start;
+        std::condition_variable Done;
+        uint64_t Generation;
+        Pass CurrentPass;
+        unsigned int CurrentParts;
+        unsigned int Pending;
+        bool Stopping;
+    };
+}
+
+#endif // NORMAL_ENGINE_H_
@@ -2,205 +2,433 @@
 
 #include <iostream>
 #include <cstdlib>
-#include <fstream>
 #include <cstring>
+#include <stdint.h>
 #include <assert.h>
-#include <map>
+#include <algorithm>
+#include <thread>
+
+#include "mappedfile.h"
+#include "objscanner.h"
+#include "uniquetable.h"
 
 using namespace std;
 using namespace ogle;
+using namespace ogle::obj;
 
 // try out: https://github.com/syoyo/tinyobjloader.git
 
 ObjLoader::ObjLoader()
     : TexCoordLayers(1)
+    , ThreadCount(1)
 {
 
 }
 
-struct FaceVert
+// Face corners to their unique vertices, indices are handed out in the order
+// corners are first seen.
+struct FaceVertTraits
 {
-    FaceVert() : vert(-1), norm(-1), coord(-1) {}
-
-    int vert;
-    int norm;
-    int coord;
-};
+    static size_t hash(const FaceVert& corner)
+    {
+        return hashWords((uint32_t)corner.vert, (uint32_t)corner.norm, (uint32_t)corner.coord);
+    }
 
-struct vert_less {
-    bool operator() (const FaceVert& lhs, const FaceVert& rhs) const
+    static bool equal(const FaceVert& a, const FaceVert& b)
     {
-        if (lhs.vert!=rhs.vert) return (lhs.vert<rhs.vert);
-        if (lhs.norm!=rhs.norm) return (lhs.norm<rhs.norm);
-        if (lhs.coord!=rhs.coord) return (lhs.coord<rhs.coord);
-        return false;
+        return a.vert == b.vert && a.norm == b.norm && a.coord == b.coord;
     }
 };
+typedef UniqueTable<FaceVert, FaceVertTraits> FaceVertTable;
 
-void ObjLoader::load(const std::string& filename)
+// When a file is split across threads a chunk does not know how many records
+// came before it. Relative (negative) indices are resolved against a biased
+// count so they can be told apart from absolute ones, and are shifted into
+// place once every chunk has been parsed.
+static const int RelativeIndexBias = 1 << 30;
+
+// A g or o record, the triangles after it (up to the next one) belong to name.
+struct GroupStart
 {
-    ifstream inf;
-    inf.open(filename.c_str(), ios_base::in);
-    if (!inf.is_open()) {
-        cerr << "[!] Failed to load file: " << filename << endl;
-    }
+    size_t triangle;        // within the chunk until the chunks are merged
+    std::string name;
+};
 
-    Positions.clear();
-    Normals.clear();
-    TexCoords.clear();
-    Faces.clear();
+// Everything read out of one newline aligned slice of the file.
+struct ObjChunk
+{
+    ObjChunk()
+        : begin(0), end(0), hasRelative(false)
+        , vertOffset(0), coordOffset(0), normOffset(0), faceOffset(0)
+    {}
 
-    std::string delims = " \n\r";
-    const unsigned int CHARACTER_COUNT = 500;
-    char line[CHARACTER_COUNT] = {0};
+    const char* begin;
+    const char* end;
 
     std::vector<glm::vec3> verts;
     std::vector<glm::vec3> norms;
     std::vector<glm::vec2> texcoords;
+    std::vector<FaceVert> corners;      // three per triangle, in file order
+    std::vector<GroupStart> groups;
+    bool hasRelative;
+
+    // where this chunk's records land in the whole file
+    size_t vertOffset;
+    size_t coordOffset;
+    size_t normOffset;
+    size_t faceOffset;
+
+    std::vector<FaceVert> unique;       // corners in the order first seen within the chunk
+    std::vector<unsigned int> faces;    // indices into unique, three per triangle
+    std::vector<unsigned int> remap;    // chunk unique index to file index
+};
+
+static void parseChunk(ObjChunk& chunk, int relativeBias)
+{
+    const char* cursor = chunk.begin;
+    const char* end = chunk.end;
+
+    size_t vertRecords, faceRecords;
+    countRecords(cursor, end, vertRecords, faceRecords);
+    chunk.verts.reserve(vertRecords);
+    chunk.corners.reserve(faceRecords * 6);
 
-    std::map<FaceVert, int, vert_less> uniqueverts;
-    unsigned int vert_count = 0;
+    FaceVertParser parseFaceVert = 0;
+    std::vector<FaceVert> polygon;
 
-    while (inf.good()) {
-        memset( (void*)line, 0, CHARACTER_COUNT);
-        inf.getline(line, CHARACTER_COUNT);
-        if (inf.eof()) break;
+    while (cursor < end) {
+        const char* line = skipSpaces(cursor, end);
+        const char* eol = findLineEnd(line, end);
+        cursor = eol + 1;
 
-        char *token = strtok(line, delims.c_str());
-        if (token == NULL || token[0] == '#' || token[0] == '$')
+        if (line == eol || line[0] == '#' || line[0] == '$')
             continue;
 
+        const char* keyword = line;
+        const char* args = skipToken(line, eol);
+        size_t keywordLength = args - keyword;
+
         // verts look like:
         //	v float float float
-        if (strcmp(token, "v") == 0) {
-            float x=0, y=0, z=0, w=1;
-            sscanf(line+2, "%f %f %f %f", &x, &y, &z, &w);
-            verts.push_back( glm::vec3(x/w,y/w,z/w) );
+        if (keywordLength == 1 && keyword[0] == 'v') {
+            float values[4] = {0, 0, 0, 1};
+            parseFloats(args, eol, values, 4);
+            float w = values[3];
+            chunk.verts.push_back( glm::vec3(values[0]/w, values[1]/w, values[2]/w) );
         }
         // normals:
         // 	nv float float float
-        else if (strcmp(token, "vn") == 0) {
-            float x=0, y=0, z=0;
-            sscanf(line+3, "%f %f %f", &x, &y, &z);
-            norms.push_back( glm::vec3(x,y,z) );
+        else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 'n') {
+            float values[3] = {0, 0, 0};
+            parseFloats(args, eol, values, 3);
+            chunk.norms.push_back( glm::vec3(values[0], values[1], values[2]) );
         }
         // texcoords:
         //	vt	float float
-        else if (strcmp(token, "vt") == 0) {
-            float x=0, y=0, z=0;
-            sscanf(line+3, "%f %f %f", &x, &y, &z);
-            texcoords.push_back( glm::vec2(x, y) );
+        else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 't') {
+            float values[3] = {0, 0, 0};
+            parseFloats(args, eol, values, 3);
+            chunk.texcoords.push_back( glm::vec2(values[0], values[1]) );
         }
 
         // keep track of smoothing groups
         // s [number|off]
-        else if (strcmp(token, "s") == 0) {
+        else if (keywordLength == 1 && keyword[0] == 's') {
+
+        }
 
+        // groups and objects both name the faces that follow them
+        //	g name | o name
+        else if (keywordLength == 1 && (keyword[0] == 'g' || keyword[0] == 'o')) {
+            const char* name = skipSpaces(args, eol);
+            const char* nameEnd = eol;
+            while (nameEnd > name && isSpace(nameEnd[-1]))
+                --nameEnd;
+
+            GroupStart group;
+            group.triangle = chunk.corners.size() / 3;
+            group.name.assign(name, nameEnd);
+            if (group.name.empty())
+                group.name = "default";
+            chunk.groups.push_back(group);
         }
 
         // faces start with:
         //	f
-        else if (strcmp(token, "f") == 0) {
-
-            std::vector<int> vindices;
-            std::vector<int> nindices;
-            std::vector<int> tindices;
-
-            // fill out a triangle from the line, it could have 3 or 4 edges
-            char *lineptr = line + 2;
-            while (lineptr[0] != 0) {
-                while (lineptr[0] == ' ') ++lineptr;
-
-                int vi=0, ni=0, ti=0;
-                if (sscanf(lineptr, "%d/%d/%d", &vi, &ni, &ti) == 3) {
-                    vindices.push_back(vi-1);
-                    nindices.push_back(ni-1);
-                    tindices.push_back(ti-1);
+        else if (keywordLength == 1 && keyword[0] == 'f') {
+            const int counts[3] = {
+                relativeBias + (int)chunk.verts.size(),
+                relativeBias + (int)chunk.texcoords.size(),
+                relativeBias + (int)chunk.norms.size()
+            };
+
+            // fill out a polygon from the line, it could have 3 or more edges
+            polygon.clear();
+            const char* p = skipSpaces(args, eol);
+            while (p < eol) {
+                if (!parseFaceVert)
+                    parseFaceVert = detectFaceFormat(p, eol);
+
+                FaceVert corner;
+                const char* next = parseFaceVert(p, eol, counts, corner);
+                if (!next) {
+                    corner = FaceVert();
+                    next = parseFaceVertAny(p, eol, counts, corner);
                 }
-                else
-                if (sscanf(lineptr, "%d//%d", &vi, &ni) == 2) {
-                    vindices.push_back(vi-1);
-                    nindices.push_back(ni-1);
-                }
-                else
-                if (sscanf(lineptr, "%d/%d", &vi, &ti) == 2) {
-                    vindices.push_back(vi-1);
-                    tindices.push_back(ti-1);
-                }
-                else
-                if (sscanf(lineptr, "%d", &vi) == 1) {
-                    vindices.push_back(vi-1);
+                if (next) {
+                    if (corner.vert >= RelativeIndexBias / 2 || corner.norm >= RelativeIndexBias / 2 || corner.coord >= RelativeIndexBias / 2)
+                        chunk.hasRelative = true;
+                    polygon.push_back(corner);
                 }
 
-                while(lineptr[0] != ' ' && lineptr[0] != 0) ++lineptr;
+                p = skipSpaces(skipToken(p, eol), eol);
             }
 
             // being that some exporters can export either 3 or 4 sided polygon's
             // convert what ever was exported into triangles
-            for (size_t i=1; i<vindices.size()-1; ++i) {
-                glm::uvec3 face;
-                FaceVert tri;
-
-                tri.vert = vindices[0];
-                if (!nindices.empty())
-                    tri.norm = nindices[0];
-                if (!tindices.empty())
-                    tri.coord = tindices[0];
-
-                if (uniqueverts.count(tri) == 0)
-                    uniqueverts[tri] = vert_count++;
-                face[0] = uniqueverts[tri];
-
-                tri.vert = vindices[i];
-                if (!nindices.empty())
-                    tri.norm = nindices[i];
-                if (!tindices.empty())
-					tri.coord = tindices[i];
-
-                if (uniqueverts.count(tri) == 0)
-                    uniqueverts[tri] = vert_count++;
-                face[1] = uniqueverts[tri];
-
-                tri.vert = vindices[i+1];
-                if (!nindices.empty())
-                    tri.norm = nindices[i+1];
-                if (!tindices.empty())
-					tri.coord = tindices[i + 1];
-
-                if (uniqueverts.count(tri) == 0)
-                    uniqueverts[tri] = vert_count++;
-                face[2] = uniqueverts[tri];
-                Faces.push_back(face);
+            for (size_t i=1; i+1<polygon.size(); ++i) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i]);
+                chunk.corners.push_back(polygon[i+1]);
             }
         }
     }
-    inf.close();
+}
 
-    // use resize instead of reserve because we'll be indexing in random locations.
-    Positions.resize(vert_count);
-    if (norms.size() > 0)
-        Normals.resize(vert_count);
-    if (texcoords.size() > 0)
-        TexCoords.resize(vert_count);
+static inline void shiftRelative(int& index, size_t offset)
+{
+    if (index >= RelativeIndexBias / 2)
+        index = index - RelativeIndexBias + (int)offset;
+}
 
-    std::map<FaceVert, int, vert_less>::iterator iter;
-    for (iter = uniqueverts.begin(); iter != uniqueverts.end(); ++iter) {
+// Moves relative indices into file space, then dedups the chunk on its own.
+static void dedupChunk(ObjChunk& chunk)
+{
+    if (chunk.hasRelative) {
+        for (size_t i = 0; i < chunk.corners.size(); ++i) {
+            shiftRelative(chunk.corners[i].vert, chunk.vertOffset);
+            shiftRelative(chunk.corners[i].coord, chunk.coordOffset);
+            shiftRelative(chunk.corners[i].norm, chunk.normOffset);
+        }
+    }
 
-        Positions[iter->second] = verts[iter->first.vert];
+    // most meshes have about one unique corner per position, leave room for seams.
+    FaceVertTable uniqueverts(chunk.verts.size() + chunk.verts.size() / 4);
+    chunk.faces.resize(chunk.corners.size());
+    for (size_t i = 0; i < chunk.corners.size(); ++i)
+        chunk.faces[i] = uniqueverts.insert(chunk.corners[i]);
+
+    chunk.unique = uniqueverts.keys();
+    std::vector<FaceVert>().swap(chunk.corners);
+}
+
+// Turns the g/o records of every chunk into one range per name. Faces ahead of
+// the first record are in "default". Names that show up again further down
+// have their triangles moved up behind their first run so every structure is
+// one range, otherwise the triangles keep their file order.
+static void buildSubMeshes(const std::vector<ObjChunk>& chunks, size_t faceCount, std::vector<uint32_t>& indices, SubMeshList& subMeshes)
+{
+    subMeshes.clear();
+
+    std::vector<GroupStart> runs;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        for (size_t g = 0; g < chunks[i].groups.size(); ++g) {
+            runs.push_back(chunks[i].groups[g]);
+            runs.back().triangle += chunks[i].faceOffset;
+        }
+    }
+    if (runs.empty())
+        return;
+    if (runs[0].triangle > 0) {
+        GroupStart leading = { 0, "default" };
+        runs.insert(runs.begin(), leading);
+    }
+
+    // how many triangles each name has, named in the order first drawn
+    std::vector<size_t> runNames(runs.size());
+    std::vector<uint32_t> counts;
+    bool scattered = false;
+    for (size_t r = 0; r < runs.size(); ++r) {
+        size_t end = (r + 1 < runs.size()) ? runs[r + 1].triangle : faceCount;
+        size_t count = end - runs[r].triangle;
+        if (count == 0)
+            continue;
 
-        if (false && norms.size() > 0) {
-            Normals[iter->second] = norms[iter->first.norm];
+        int found = findSubMesh(subMeshes, runs[r].name);
+        if (found < 0) {
+            SubMesh sub = { runs[r].name, 0, 0 };
+            subMeshes.push_back(sub);
+            counts.push_back(0);
+            found = (int)subMeshes.size() - 1;
         }
+        else if (found + 1 != (int)subMeshes.size()) {
+            scattered = true;
+        }
+        runNames[r] = (size_t)found;
+        counts[found] += (uint32_t)count;
+    }
+
+    uint32_t start = 0;
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        subMeshes[i].indexStart = start * 3;
+        subMeshes[i].indexCount = counts[i] * 3;
+        start += counts[i];
+    }
+    if (!scattered)
+        return;
+
+    std::vector<uint32_t> grouped(indices.size());
+    std::vector<uint32_t> next(subMeshes.size());
+    for (size_t i = 0; i < subMeshes.size(); ++i)
+        next[i] = subMeshes[i].indexStart;
+    for (size_t r = 0; r < runs.size(); ++r) {
+        size_t end = (r + 1 < runs.size()) ? runs[r + 1].triangle : faceCount;
+        if (end == runs[r].triangle)
+            continue;
+        size_t from = runs[r].triangle * 3, to = end * 3;
+        std::copy(indices.begin() + from, indices.begin() + to, grouped.begin() + next[runNames[r]]);
+        next[runNames[r]] += (uint32_t)(to - from);
+    }
+    indices.swap(grouped);
+}
+
+// Runs work(i) for every chunk, the calling thread takes the last one.
+template <typename Work>
+static void forEachChunk(std::vector<ObjChunk>& chunks, Work work)
+{
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < chunks.size(); ++i)
+        workers.push_back(std::thread(work, i));
+    work(chunks.size() - 1);
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+void ObjLoader::setThreadCount(unsigned int count)
+{
+    ThreadCount = count;
+}
+
+void ObjLoader::load(const std::string& filename)
+{
+    Positions.clear();
+    Normals.clear();
+    TexCoords.clear();
+    Indices.clear();
+    SubMeshes.clear();
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "[!] Failed to load file: " << filename << endl;
+        return;
+    }
+
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // don't bother splitting small files, the threads cost more than they save
+    const size_t MinimumChunkSize = 256 * 1024;
+    size_t threads = ThreadCount ? ThreadCount : std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount = std::max<size_t>(1, std::min(threads, file.size() / MinimumChunkSize));
+
+    // split on line boundaries
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* cursor = begin;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        const char* split = (i + 1 == chunkCount) ? end : begin + file.size() * (i + 1) / chunkCount;
+        if (split < cursor) split = cursor;
+        if (split < end) split = findLineEnd(split, end);
+        if (split < end) ++split;
+
+        chunks[i].begin = cursor;
+        chunks[i].end = split;
+        cursor = split;
+    }
 
-        if (false && texcoords.size() > 0) {
-            TexCoords[iter->second] = texcoords[iter->first.coord];
+    int relativeBias = chunkCount > 1 ? RelativeIndexBias : 0;
+    forEachChunk(chunks, [&](size_t i) {
+        parseChunk(chunks[i], relativeBias);
+    });
+
+    // everything needed is out of the text now, unmap it before dedup allocates
+    file.close();
+    for (size_t i = 0; i < chunkCount; ++i)
+        chunks[i].begin = chunks[i].end = 0;
+
+    // prefix sum the record counts to place each chunk in the file
+    size_t vertCount = 0, coordCount = 0, normCount = 0, faceCount = 0;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        chunks[i].vertOffset = vertCount;
+        chunks[i].coordOffset = coordCount;
+        chunks[i].normOffset = normCount;
+        chunks[i].faceOffset = faceCount;
+        vertCount += chunks[i].verts.size();
+        coordCount += chunks[i].texcoords.size();
+        normCount += chunks[i].norms.size();
+        faceCount += chunks[i].corners.size() / 3;
+    }
+
+    std::vector<glm::vec3> verts(vertCount);
+    forEachChunk(chunks, [&](size_t i) {
+        dedupChunk(chunks[i]);
+        std::copy(chunks[i].verts.begin(), chunks[i].verts.end(), verts.begin() + chunks[i].vertOffset);
+        std::vector<glm::vec3>().swap(chunks[i].verts);
+    });
+
+    // Merge in file order. A corner new to the file is first seen in the first
+    // chunk that holds it, at the same spot it was first seen within that chunk,
+    // so walking each chunk's unique corners in order hands out the same indices
+    // as a single pass over the whole file.
+    std::vector<FaceVert> corners;
+    if (chunkCount == 1) {
+        corners.swap(chunks[0].unique);
+        chunks[0].remap.clear();
+    } else {
+        size_t uniqueCount = 0;
+        for (size_t i = 0; i < chunkCount; ++i)
+            uniqueCount += chunks[i].unique.size();
+
+        FaceVertTable uniqueverts(uniqueCount);
+        for (size_t i = 0; i < chunkCount; ++i) {
+            chunks[i].remap.resize(chunks[i].unique.size());
+            for (size_t j = 0; j < chunks[i].unique.size(); ++j)
+                chunks[i].remap[j] = uniqueverts.insert(chunks[i].unique[j]);
         }
+        corners = uniqueverts.keys();
     }
+
+    Indices.resize(faceCount * 3);
+    size_t vert_count = corners.size();
+    Positions.resize(vert_count);
+    forEachChunk(chunks, [&](size_t i) {
+        const ObjChunk& chunk = chunks[i];
+        uint32_t* indices = Indices.data() + chunk.faceOffset * 3;
+        if (chunk.remap.empty())
+            std::copy(chunk.faces.begin(), chunk.faces.end(), indices);
+        else
+            for (size_t c = 0; c < chunk.faces.size(); ++c)
+                indices[c] = chunk.remap[chunk.faces[c]];
+
+        // corners are already in index order, so this is a straight copy.
+        size_t first = vert_count * i / chunkCount;
+        size_t last = vert_count * (i + 1) / chunkCount;
+        for (size_t v = first; v < last; ++v)
+            Positions[v] = verts[corners[v].vert];
+    });
+
+    buildSubMeshes(chunks, faceCount, Indices, SubMeshes);
+
+    // normals and texcoords are parsed but not handed out yet, Normals and
+    // TexCoords are only sized so their getters stay valid.
+    if (normCount > 0)
+        Normals.resize(vert_count);
+    if (coordCount > 0)
+        TexCoords.resize(vert_count);
 }
 
 size_t ObjLoader::getIndexCount()
 {
-    return Faces.size()*3;
+    return Indices.size();
 }
 
 size_t ObjLoader::getVertCount()
@@ -210,7 +438,7 @@ size_t ObjLoader::getVertCount()
 
 const unsigned int* ObjLoader::getIndices()
 {
-    return (const unsigned int*)&Faces[0];
+    return (const unsigned int*)&Indices[0];
 }
 
 const float* ObjLoader::getPositions()
@@ -218,6 +446,32 @@ const float* ObjLoader::getPositions()
     return (const float*)&Positions[0];
 }
 
+std::vector<glm::vec3> ObjLoader::releasePositions()
+{
+    std::vector<glm::vec3> positions;
+    positions.swap(Positions);
+    return positions;
+}
+
+std::vector<uint32_t> ObjLoader::releaseIndices()
+{
+    std::vector<uint32_t> indices;
+    indices.swap(Indices);
+    return indices;
+}
+
+const SubMeshList& ObjLoader::getSubMeshes()
+{
+    return SubMeshes;
+}
+
+SubMeshList ObjLoader::releaseSubMeshes()
+{
+    SubMeshList subMeshes;
+    subMeshes.swap(SubMeshes);
+    return subMeshes;
+}
+
 const float* ObjLoader::getNormals()
 {
     return (const float*)&Normals[0];
@@ -3,8 +3,11 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
 #include <glm/glm.hpp>
 
+#include "submesh.h"
+
 namespace ogle
 {
     class ObjLoader
@@ -21,6 +24,10 @@ namespace ogle
 
         void load(const std::string& filename);
 
+        // Number of threads load() splits a file across, 0 uses every core.
+        // The output is the same whatever the count, 1 (the default) parses on the calling thread.
+        void setThreadCount(unsigned int count);
+
         size_t getIndexCount();
         size_t getVertCount();
 
@@ -28,6 +35,15 @@ namespace ogle
         const float* getPositions();
         const float* getNormals();
 
+        // Hand the loaded arrays over without copying, the loader is left without them.
+        std::vector<glm::vec3> releasePositions();
+        std::vector<uint32_t> releaseIndices();
+
+        // One range of the indices per g or o name, in the order the names
+        // first come up. Empty when the file has neither.
+        const SubMeshList& getSubMeshes();
+        SubMeshList releaseSubMeshes();
+
         int getTexCoordLayers();
         const float* getTexCoords(int multiTexCoordLayer);
 
@@ -39,13 +55,16 @@ namespace ogle
 
     private:
 
-        std::vector<glm::uvec3> Faces;
+        std::vector<uint32_t> Indices;     // three per triangle
         std::vector<glm::vec3> Positions;
         std::vector<glm::vec3> Normals;
+        SubMeshList SubMeshes;
 
         // obj's only have 1 layer ever
         std::vector<glm::vec2> TexCoords;
         unsigned int TexCoordLayers;
+
+        unsigned int ThreadCount;
     };
 }
 #endif // OBJLOADER_H
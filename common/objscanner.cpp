@@ -0,0 +1,246 @@
+#include "objscanner.h"
+
+#include <cstdlib>
+#include <cfloat>
+#include <string>
+#include <stdint.h>
+
+using namespace ogle;
+using namespace ogle::obj;
+
+// Slow path, hand the token to strtof so that anything the fast path can not
+// represent exactly (long mantissas, huge exponents, inf, nan, hex) still
+// rounds the same way sscanf's %f would.
+static const char* parseFloatSlow(const char* p, const char* end, float& value)
+{
+    const char* tokenEnd = skipToken(p, end);
+    std::string token(p, tokenEnd);
+
+    char* parsedEnd = 0;
+    float parsed = strtof(token.c_str(), &parsedEnd);
+    if (parsedEnd == token.c_str())
+        return 0;
+
+    value = parsed;
+    return p + (parsedEnd - token.c_str());
+}
+
+const char* obj::parseFloat(const char* p, const char* end, float& value)
+{
+    static const double powersOfTen[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool sawDigit = false;
+    bool truncated = false;
+
+    for (; p < end && isDigit(*p); ++p) {
+        sawDigit = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) ++digits;
+        } else {
+            truncated = true;
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && isDigit(*p); ++p) {
+            sawDigit = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) ++digits;
+                --exponent;
+            } else {
+                truncated = true;
+            }
+        }
+    }
+    if (!sawDigit)
+        return parseFloatSlow(start, end, value);
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            negativeExponent = (*e == '-');
+            ++e;
+        }
+        if (e < end && isDigit(*e)) {
+            int explicitExponent = 0;
+            for (; e < end && isDigit(*e); ++e)
+                if (explicitExponent < 10000)
+                    explicitExponent = explicitExponent * 10 + (*e - '0');
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            p = e;
+        }
+    }
+
+    // anything glued onto the number (hex, inf, ...) is left to strtof
+    if (p < end && !isSpace(*p) && *p != '\n')
+        return parseFloatSlow(start, end, value);
+
+    if (mantissa == 0) {
+        value = negative ? -0.f : 0.f;
+        return p;
+    }
+
+    if (truncated || mantissa >= (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+        return parseFloatSlow(start, end, value);
+
+    // both the mantissa and the power of ten are exact in a double, so this
+    // is a single correctly rounded operation.
+    double result = (double)mantissa;
+    if (exponent < 0)
+        result /= powersOfTen[-exponent];
+    else
+        result *= powersOfTen[exponent];
+
+    // Rounding the double down to a float is only wrong when the double
+    // landed exactly half way between two floats, or is a float denormal.
+    uint64_t bits;
+    memcpy(&bits, &result, sizeof(bits));
+    const uint64_t droppedMask = (uint64_t(1) << 29) - 1;
+    if ((bits & droppedMask) == (uint64_t(1) << 28) || result < FLT_MIN)
+        return parseFloatSlow(start, end, value);
+
+    value = negative ? -(float)result : (float)result;
+    return p;
+}
+
+int obj::parseFloats(const char* p, const char* end, float* values, int maxCount)
+{
+    int count = 0;
+    while (count < maxCount) {
+        p = skipSpaces(p, end);
+        p = parseFloat(p, end, values[count]);
+        if (!p) break;
+        ++count;
+    }
+    return count;
+}
+
+// f v v v
+static const char* parseFaceVertV(const char* p, const char* end, const int* counts, FaceVert& corner)
+{
+    int v;
+    p = parseInt(p, end, v);
+    if (!p || (p < end && *p == '/')) return 0;
+    corner.vert = resolveIndex(v, counts[FACE_VERT]);
+    return p;
+}
+
+// f v/t v/t v/t
+static const char* parseFaceVertVT(const char* p, const char* end, const int* counts, FaceVert& corner)
+{
+    int v, t;
+    p = parseInt(p, end, v);
+    if (!p || p >= end || *p != '/') return 0;
+    p = parseInt(p + 1, end, t);
+    if (!p || (p < end && *p == '/')) return 0;
+    corner.vert = resolveIndex(v, counts[FACE_VERT]);
+    corner.coord = resolveIndex(t, counts[FACE_COORD]);
+    return p;
+}
+
+// f v//n v//n v//n
+static const char* parseFaceVertVN(const char* p, const char* end, const int* counts, FaceVert& corner)
+{
+    int v, n;
+    p = parseInt(p, end, v);
+    if (!p || end - p < 2 || p[0] != '/' || p[1] != '/') return 0;
+    p = parseInt(p + 2, end, n);
+    if (!p) return 0;
+    corner.vert = resolveIndex(v, counts[FACE_VERT]);
+    corner.norm = resolveIndex(n, counts[FACE_NORM]);
+    return p;
+}
+
+// f v/t/n v/t/n v/t/n
+static const char* parseFaceVertVTN(const char* p, const char* end, const int* counts, FaceVert& corner)
+{
+    int v, t, n;
+    p = parseInt(p, end, v);
+    if (!p || p >= end || *p != '/') return 0;
+    p = parseInt(p + 1, end, t);
+    if (!p || p >= end || *p != '/') return 0;
+    p = parseInt(p + 1, end, n);
+    if (!p) return 0;
+    corner.vert = resolveIndex(v, counts[FACE_VERT]);
+    corner.coord = resolveIndex(t, counts[FACE_COORD]);
+    corner.norm = resolveIndex(n, counts[FACE_NORM]);
+    return p;
+}
+
+const char* obj::parseFaceVertAny(const char* p, const char* end, const int* counts, FaceVert& corner)
+{
+    int v, t, n;
+    p = parseInt(p, end, v);
+    if (!p) return 0;
+    corner.vert = resolveIndex(v, counts[FACE_VERT]);
+
+    if (p < end && *p == '/') {
+        if (p + 1 < end && p[1] == '/') {
+            const char* next = parseInt(p + 2, end, n);
+            if (next) {
+                corner.norm = resolveIndex(n, counts[FACE_NORM]);
+                p = next;
+            }
+        } else {
+            const char* next = parseInt(p + 1, end, t);
+            if (next) {
+                corner.coord = resolveIndex(t, counts[FACE_COORD]);
+                p = next;
+                if (p < end && *p == '/') {
+                    next = parseInt(p + 1, end, n);
+                    if (next) {
+                        corner.norm = resolveIndex(n, counts[FACE_NORM]);
+                        p = next;
+                    }
+                }
+            }
+        }
+    }
+    return p;
+}
+
+obj::FaceVertParser obj::detectFaceFormat(const char* p, const char* end)
+{
+    const int counts[3] = {0, 0, 0};
+    FaceVert corner;
+    if (!parseFaceVertAny(p, end, counts, corner))
+        return parseFaceVertAny;
+
+    if (corner.coord != -1 || corner.norm != -1) {
+        if (corner.coord == -1) return parseFaceVertVN;
+        if (corner.norm == -1) return parseFaceVertVT;
+        return parseFaceVertVTN;
+    }
+    return parseFaceVertV;
+}
+
+void obj::countRecords(const char* p, const char* end, size_t& vertCount, size_t& faceCount)
+{
+    vertCount = 0;
+    faceCount = 0;
+    while (p < end) {
+        const char* line = skipSpaces(p, end);
+        const char* eol = findLineEnd(line, end);
+        if (eol - line > 1 && isSpace(line[1])) {
+            if (line[0] == 'v') ++vertCount;
+            else if (line[0] == 'f') ++faceCount;
+        }
+        p = eol + 1;
+    }
+}
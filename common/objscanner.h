@@ -0,0 +1,103 @@
+#ifndef OBJ_SCANNER_H_
+#define OBJ_SCANNER_H_
+
+#include <cstring>
+#include <cstddef>
+
+namespace ogle
+{
+    /**
+    *   Line level pieces of the obj parser, shared by ObjLoader and ObjStream.
+    *
+    *   Text is parsed in place, nothing is null terminated so every scan is
+    *   bounded by an explicit end pointer.
+    */
+    namespace obj
+    {
+        // One corner of a face, 0 based indices into the v, vn and vt records (-1 if absent).
+        struct FaceVert
+        {
+            FaceVert() : vert(-1), norm(-1), coord(-1) {}
+
+            int vert;
+            int norm;
+            int coord;
+        };
+
+        // Running record counts, in the order face corners list them.
+        enum FaceAttribute { FACE_VERT, FACE_COORD, FACE_NORM };
+
+        inline bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        inline bool isDigit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        inline const char* skipSpaces(const char* p, const char* end)
+        {
+            while (p < end && isSpace(*p)) ++p;
+            return p;
+        }
+
+        inline const char* skipToken(const char* p, const char* end)
+        {
+            while (p < end && !isSpace(*p)) ++p;
+            return p;
+        }
+
+        inline const char* findLineEnd(const char* p, const char* end)
+        {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            return eol ? eol : end;
+        }
+
+        inline const char* parseInt(const char* p, const char* end, int& value)
+        {
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negative = (*p == '-');
+                ++p;
+            }
+            if (p >= end || !isDigit(*p))
+                return 0;
+
+            int result = 0;
+            for (; p < end && isDigit(*p); ++p)
+                result = result * 10 + (*p - '0');
+
+            value = negative ? -result : result;
+            return p;
+        }
+
+        // obj indices are 1 based, negative values are relative to the end of the list read so far.
+        inline int resolveIndex(int index, int count)
+        {
+            return index < 0 ? count + index : index - 1;
+        }
+
+        // Returns a pointer just past the number, or null if there was no number.
+        // Rounds exactly as sscanf's %f would.
+        const char* parseFloat(const char* p, const char* end, float& value);
+
+        // Reads up to maxCount floats separated by spaces, returns how many were read.
+        int parseFloats(const char* p, const char* end, float* values, int maxCount);
+
+        // Each routine handles one face layout and returns null if the corner is not in that layout.
+        typedef const char* (*FaceVertParser)(const char* p, const char* end, const int* counts, FaceVert& corner);
+
+        // Used for corners that do not match the layout of the file, takes whatever is there.
+        const char* parseFaceVertAny(const char* p, const char* end, const int* counts, FaceVert& corner);
+
+        // Looks at the first corner of a face and picks the routine to use for the rest of the file.
+        FaceVertParser detectFaceFormat(const char* p, const char* end);
+
+        // Quick pass counting v and f records, used to size containers up front.
+        void countRecords(const char* p, const char* end, size_t& vertCount, size_t& faceCount);
+    }
+}
+
+#endif // OBJ_SCANNER_H_
@@ -0,0 +1,181 @@
+#include "objstream.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include "objscanner.h"
+
+using namespace std;
+using namespace ogle;
+using namespace ogle::obj;
+
+const size_t ObjStream::DefaultBudget;
+const size_t ObjStream::MinimumBudget;
+
+ObjStream::ObjStream()
+    : Budget(DefaultBudget)
+    , PositionCapacity(0)
+    , TriangleCapacity(0)
+{
+    memset(&ReadStats, 0, sizeof(ReadStats));
+}
+
+void ObjStream::setMemoryBudget(size_t bytes)
+{
+    Budget = std::max(bytes, MinimumBudget);
+}
+
+size_t ObjStream::getMemoryBudget() const
+{
+    return Budget;
+}
+
+const ObjStream::Stats& ObjStream::getStats() const
+{
+    return ReadStats;
+}
+
+bool ObjStream::flush(const BatchCallback& callback)
+{
+    if (Positions.empty() && Triangles.empty())
+        return true;
+
+    Batch batch;
+    batch.positions = Positions.data();
+    batch.positionCnt = Positions.size();
+    batch.firstPosition = ReadStats.positionCnt - Positions.size();
+    batch.triangles = Triangles.data();
+    batch.triangleCnt = Triangles.size();
+    batch.firstTriangle = ReadStats.triangleCnt - Triangles.size();
+    ++ReadStats.batchCnt;
+
+    bool keepGoing = callback(batch);
+    Positions.clear();
+    Triangles.clear();
+    return keepGoing;
+}
+
+bool ObjStream::read(const std::string& filename, const BatchCallback& callback)
+{
+    memset(&ReadStats, 0, sizeof(ReadStats));
+
+    std::ifstream inf(filename.c_str(), std::ios::binary);
+    if (!inf.is_open()) {
+        cerr << "[!] Failed to load file: " << filename << endl;
+        return false;
+    }
+
+    // a quarter of the budget buffers the file, the rest is split between the batches
+    size_t bufferSize = Budget / 4;
+    size_t batchBytes = (Budget - bufferSize) / 2;
+    PositionCapacity = batchBytes / sizeof(glm::vec3);
+    TriangleCapacity = batchBytes / sizeof(glm::uvec3);
+
+    std::vector<char>(bufferSize).swap(Buffer);
+    std::vector<glm::vec3>().swap(Positions);
+    std::vector<glm::uvec3>().swap(Triangles);
+    Positions.reserve(PositionCapacity);
+    Triangles.reserve(TriangleCapacity);
+    ReadStats.peakMemory = Buffer.size() + PositionCapacity * sizeof(glm::vec3) + TriangleCapacity * sizeof(glm::uvec3);
+
+    int counts[3] = {0, 0, 0};
+    FaceVertParser parseFaceVert = 0;
+    std::vector<FaceVert> polygon;
+
+    size_t filled = 0;
+    bool atEnd = false;
+    while (!atEnd || filled > 0) {
+        if (!atEnd) {
+            inf.read(&Buffer[filled], Buffer.size() - filled);
+            size_t got = (size_t)inf.gcount();
+            filled += got;
+            ReadStats.bytesRead += got;
+            atEnd = !inf;
+        }
+
+        // only whole lines are parsed, the tail waits for the next read
+        const char* begin = Buffer.data();
+        const char* end = begin + filled;
+        if (!atEnd) {
+            const char* lastNewline = end;
+            while (lastNewline > begin && lastNewline[-1] != '\n')
+                --lastNewline;
+            if (lastNewline == begin) {
+                // a single line longer than the buffer, make room for it
+                Buffer.resize(Buffer.size() * 2);
+                ReadStats.peakMemory = std::max(ReadStats.peakMemory,
+                    Buffer.size() + PositionCapacity * sizeof(glm::vec3) + TriangleCapacity * sizeof(glm::uvec3));
+                continue;
+            }
+            end = lastNewline;
+        }
+
+        const char* cursor = begin;
+        while (cursor < end) {
+            const char* line = skipSpaces(cursor, end);
+            const char* eol = findLineEnd(line, end);
+            cursor = eol + 1;
+
+            if (line == eol || line[0] == '#' || line[0] == '$')
+                continue;
+
+            const char* keyword = line;
+            const char* args = skipToken(line, eol);
+            size_t keywordLength = args - keyword;
+
+            if (keywordLength == 1 && keyword[0] == 'v') {
+                float values[4] = {0, 0, 0, 1};
+                parseFloats(args, eol, values, 4);
+                float w = values[3];
+                if (Positions.size() == PositionCapacity && !flush(callback))
+                    return false;
+                Positions.push_back( glm::vec3(values[0]/w, values[1]/w, values[2]/w) );
+                ++counts[FACE_VERT];
+                ++ReadStats.positionCnt;
+            }
+            // normals and texcoords aren't handed out, they only need counting for relative indices
+            else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 'n') {
+                ++counts[FACE_NORM];
+            }
+            else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 't') {
+                ++counts[FACE_COORD];
+            }
+            else if (keywordLength == 1 && keyword[0] == 'f') {
+                polygon.clear();
+                const char* p = skipSpaces(args, eol);
+                while (p < eol) {
+                    if (!parseFaceVert)
+                        parseFaceVert = detectFaceFormat(p, eol);
+
+                    FaceVert corner;
+                    const char* next = parseFaceVert(p, eol, counts, corner);
+                    if (!next) {
+                        corner = FaceVert();
+                        next = parseFaceVertAny(p, eol, counts, corner);
+                    }
+                    if (next && corner.vert >= 0)
+                        polygon.push_back(corner);
+
+                    p = skipSpaces(skipToken(p, eol), eol);
+                }
+
+                // fan the polygon into triangles, same as ObjLoader
+                for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                    if (Triangles.size() == TriangleCapacity && !flush(callback))
+                        return false;
+                    Triangles.push_back( glm::uvec3(polygon[0].vert, polygon[i].vert, polygon[i+1].vert) );
+                    ++ReadStats.triangleCnt;
+                }
+            }
+        }
+
+        // move the unfinished line to the front
+        size_t consumed = end - begin;
+        if (consumed < filled)
+            memmove(&Buffer[0], &Buffer[consumed], filled - consumed);
+        filled -= consumed;
+    }
+
+    return flush(callback);
+}
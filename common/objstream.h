@@ -0,0 +1,82 @@
+#ifndef OBJ_STREAM_H_
+#define OBJ_STREAM_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+
+namespace ogle
+{
+    /**
+    *   Reads an obj front to back through a fixed size buffer and hands out
+    *   positions and triangles in batches, so meshes larger than memory can
+    *   be uploaded, decimated or written out piece by piece.
+    *
+    *   Unlike ObjLoader nothing is deduped (that needs a table as big as the
+    *   mesh): triangle indices point straight at the file's v records, 0 based
+    *   and counted from the start of the file. A triangle can reference
+    *   positions handed out in an earlier batch.
+    *
+    *   The memory budget covers the read buffer and both batch arrays. Only a
+    *   line longer than the read buffer can push past it.
+    */
+    class ObjStream
+    {
+    public:
+        struct Batch
+        {
+            const glm::vec3* positions;
+            size_t positionCnt;
+            size_t firstPosition;       // file index of positions[0]
+
+            const glm::uvec3* triangles;
+            size_t triangleCnt;
+            size_t firstTriangle;       // file index of triangles[0]
+        };
+
+        struct Stats
+        {
+            size_t positionCnt;
+            size_t triangleCnt;
+            size_t batchCnt;
+            size_t bytesRead;
+            size_t peakMemory;          // read buffer plus batch arrays
+        };
+
+        // Return false to stop reading.
+        typedef std::function<bool(const Batch&)> BatchCallback;
+
+        ObjStream();
+
+        // Bytes the reader may hold at once, clamped to at least MinimumBudget.
+        void setMemoryBudget(size_t bytes);
+        size_t getMemoryBudget() const;
+
+        // Calls back with every batch in file order. False if the file could
+        // not be read or the callback stopped early.
+        bool read(const std::string& filename, const BatchCallback& callback);
+
+        const Stats& getStats() const;
+
+        static const size_t DefaultBudget = 16 * 1024 * 1024;
+        static const size_t MinimumBudget = 64 * 1024;
+
+    private:
+        ObjStream(const ObjStream& other);
+        ObjStream& operator=(const ObjStream& other);
+
+        bool flush(const BatchCallback& callback);
+
+        size_t Budget;
+        Stats ReadStats;
+
+        std::vector<char> Buffer;
+        std::vector<glm::vec3> Positions;
+        std::vector<glm::uvec3> Triangles;
+        size_t PositionCapacity;
+        size_t TriangleCapacity;
+    };
+}
+
+#endif // OBJ_STREAM_H_
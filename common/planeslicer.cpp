@@ -0,0 +1,345 @@
+#include "planeslicer.h"
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#include "meshbuffer.h"
+
+using namespace std;
+using namespace ogle;
+
+namespace
+{
+    struct ArrayIn
+    {
+        const glm::vec3* v;
+        glm::vec3 get(uint32_t i) const { return v[i]; }
+    };
+
+    struct StreamIn
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+        glm::vec3 get(uint32_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+    };
+
+    struct HalfEdge
+    {
+        uint64_t key;       // lower vertex up top, so both halves of an edge sort together
+        uint32_t face;
+        uint32_t corner;
+
+        bool operator<(const HalfEdge& other) const { return key < other.key; }
+    };
+}
+
+const uint32_t PlaneSlicer::NotCrossing;
+
+PlaneSlicer::PlaneSlicer()
+    : Visit(0)
+{
+    LastSlice = Stats();
+}
+
+void PlaneSlicer::setTopology(const MeshBuffer& mesh)
+{
+    if (!mesh.UsesIndices) {
+        clear();
+        return;
+    }
+    setTopology(mesh.getIndices().data(), mesh.getIdxCnt(), mesh.getVertCnt());
+}
+
+void PlaneSlicer::setTopology(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt)
+{
+    clear();
+    unsigned int triCnt = idxCnt / 3;
+
+    std::vector<HalfEdge> halves(3 * (size_t)triCnt);
+    for (unsigned int f = 0; f < triCnt; ++f) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            uint32_t a = indices[3 * f + k];
+            uint32_t b = indices[3 * f + (k + 1) % 3];
+            HalfEdge& half = halves[3 * f + k];
+            half.key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+            half.face = f;
+            half.corner = k;
+        }
+    }
+    std::sort(halves.begin(), halves.end());
+
+    // every run of equal keys is one edge, its faces are the run itself
+    FaceEdges.resize(3 * (size_t)triCnt);
+    EdgeFaces.resize(halves.size());
+    for (size_t i = 0; i < halves.size(); ++i) {
+        if (i == 0 || halves[i].key != halves[i - 1].key) {
+            EdgeFaceStart.push_back((uint32_t)i);
+            EdgeVerts.push_back((uint32_t)(halves[i].key >> 32));
+            EdgeVerts.push_back((uint32_t)halves[i].key);
+        }
+        FaceEdges[3 * halves[i].face + halves[i].corner] = (uint32_t)(EdgeFaceStart.size() - 1);
+        EdgeFaces[i] = halves[i].face;
+    }
+    EdgeFaceStart.push_back((uint32_t)halves.size());
+    uint32_t edgeCnt = (uint32_t)(EdgeVerts.size() / 2);
+
+    VertEdgeStart.assign(vertCnt + 1, 0);
+    for (uint32_t e = 0; e < edgeCnt; ++e) {
+        ++VertEdgeStart[EdgeVerts[2 * e] + 1];
+        if (EdgeVerts[2 * e + 1] != EdgeVerts[2 * e])
+            ++VertEdgeStart[EdgeVerts[2 * e + 1] + 1];
+    }
+    for (unsigned int v = 0; v < vertCnt; ++v)
+        VertEdgeStart[v + 1] += VertEdgeStart[v];
+    VertEdges.resize(VertEdgeStart[vertCnt]);
+    std::vector<uint32_t> fill(VertEdgeStart.begin(), VertEdgeStart.end() - 1);
+    for (uint32_t e = 0; e < edgeCnt; ++e) {
+        VertEdges[fill[EdgeVerts[2 * e]]++] = e;
+        if (EdgeVerts[2 * e + 1] != EdgeVerts[2 * e])
+            VertEdges[fill[EdgeVerts[2 * e + 1]]++] = e;
+    }
+
+    // everything starts behind the plane, the first slice walks whatever is in front
+    Sides.assign(vertCnt, 0);
+    CrossingSlot.assign(edgeCnt, NotCrossing);
+    FaceVisit.assign(triCnt, 0);
+    Distances.resize(vertCnt);
+}
+
+void PlaneSlicer::clear()
+{
+    EdgeVerts.clear();
+    FaceEdges.clear();
+    EdgeFaceStart.clear();
+    EdgeFaces.clear();
+    VertEdgeStart.clear();
+    VertEdges.clear();
+    Sides.clear();
+    Crossing.clear();
+    CrossingSlot.clear();
+    FaceVisit.clear();
+    Visit = 0;
+    Distances.clear();
+    Cuts.clear();
+    Points.clear();
+    Polylines.clear();
+    LastSlice = Stats();
+}
+
+void PlaneSlicer::slice(const glm::vec3* verts, const glm::vec3& point, const glm::vec3& normal)
+{
+    ArrayIn in = { verts };
+    sliceFrom(in, point, normal);
+}
+
+void PlaneSlicer::slice(const VertexStreams& verts, const glm::vec3& point, const glm::vec3& normal)
+{
+    StreamIn in = { verts.x(), verts.y(), verts.z() };
+    sliceFrom(in, point, normal);
+}
+
+void PlaneSlicer::slice(const MeshBuffer& mesh, const glm::vec3& point, const glm::vec3& normal)
+{
+    if (mesh.getVertCnt() != Sides.size()) {
+        cerr << "[!] PlaneSlicer: slicing " << mesh.getVertCnt() << " vertices, topology has " << Sides.size() << endl;
+        return;
+    }
+    if (mesh.getVertexLayout() == MeshBuffer::StructOfArrays)
+        slice(mesh.getVertStreams(), point, normal);
+    else
+        slice(mesh.getVerts().data(), point, normal);
+}
+
+template <typename In>
+void PlaneSlicer::sliceFrom(const In& in, const glm::vec3& point, const glm::vec3& normal)
+{
+    LastSlice = Stats();
+    float offset = -glm::dot(normal, point);
+    uint32_t vertCnt = (uint32_t)Sides.size();
+    // an edge between two vertices that both changed sides is walked twice,
+    // the second time with both sides up to date
+    for (uint32_t v = 0; v < vertCnt; ++v) {
+        float distance = glm::dot(normal, in.get(v)) + offset;
+        Distances[v] = distance;
+        uint8_t side = distance >= 0;
+        if (side == Sides[v])
+            continue;
+        Sides[v] = side;
+        ++LastSlice.sideChanges;
+        for (uint32_t i = VertEdgeStart[v]; i < VertEdgeStart[v + 1]; ++i) {
+            uint32_t e = VertEdges[i];
+            setCrossing(e, Sides[EdgeVerts[2 * e]] != Sides[EdgeVerts[2 * e + 1]]);
+            ++LastSlice.edgesWalked;
+        }
+    }
+
+    Cuts.resize(Crossing.size());
+    for (size_t i = 0; i < Crossing.size(); ++i) {
+        uint32_t a = EdgeVerts[2 * Crossing[i]];
+        uint32_t b = EdgeVerts[2 * Crossing[i] + 1];
+        glm::vec3 pa = in.get(a);
+        float t = Distances[a] / (Distances[a] - Distances[b]);
+        Cuts[i] = pa + (in.get(b) - pa) * t;
+    }
+    LastSlice.crossingEdges = (unsigned int)Crossing.size();
+
+    link();
+    LastSlice.polylines = (unsigned int)Polylines.size();
+    LastSlice.points = (unsigned int)Points.size();
+}
+
+void PlaneSlicer::setCrossing(uint32_t edge, bool crossing)
+{
+    uint32_t slot = CrossingSlot[edge];
+    if (crossing && slot == NotCrossing) {
+        CrossingSlot[edge] = (uint32_t)Crossing.size();
+        Crossing.push_back(edge);
+    }
+    else if (!crossing && slot != NotCrossing) {
+        uint32_t last = Crossing.back();
+        Crossing[slot] = last;
+        CrossingSlot[last] = slot;
+        Crossing.pop_back();
+        CrossingSlot[edge] = NotCrossing;
+    }
+}
+
+// Every face the plane goes through has exactly two crossing edges, so the cuts
+// link up face by face. Open lines can only end on edges with a single face,
+// those are started from first so each open line comes out in one piece.
+void PlaneSlicer::link()
+{
+    Points.clear();
+    Polylines.clear();
+    if (++Visit == 0) {
+        std::fill(FaceVisit.begin(), FaceVisit.end(), 0);
+        Visit = 1;
+    }
+
+    uint32_t face;
+    for (size_t i = 0; i < Crossing.size(); ++i) {
+        uint32_t e = Crossing[i];
+        if (EdgeFaceStart[e + 1] - EdgeFaceStart[e] == 1 && nextFace(e, face))
+            walk(e);
+    }
+    for (size_t i = 0; i < Crossing.size(); ++i) {
+        // edges with more than two faces start another line for every pair left
+        while (nextFace(Crossing[i], face))
+            walk(Crossing[i]);
+    }
+}
+
+void PlaneSlicer::walk(uint32_t start)
+{
+    Polyline line;
+    line.start = (uint32_t)Points.size();
+    line.closed = false;
+    Points.push_back(Cuts[CrossingSlot[start]]);
+
+    uint32_t current = start;
+    uint32_t face;
+    while (nextFace(current, face)) {
+        FaceVisit[face] = Visit;
+        uint32_t next = NotCrossing;
+        for (unsigned int k = 0; k < 3; ++k) {
+            uint32_t e = FaceEdges[3 * face + k];
+            if (e != current && CrossingSlot[e] != NotCrossing)
+                next = e;
+        }
+        if (next == NotCrossing)
+            break;
+        if (next == start) {
+            line.closed = true;
+            break;
+        }
+        Points.push_back(Cuts[CrossingSlot[next]]);
+        current = next;
+    }
+
+    line.count = (uint32_t)Points.size() - line.start;
+    if (line.count < 2)
+        Points.resize(line.start);
+    else
+        Polylines.push_back(line);
+}
+
+bool PlaneSlicer::nextFace(uint32_t edge, uint32_t& face) const
+{
+    for (uint32_t i = EdgeFaceStart[edge]; i < EdgeFaceStart[edge + 1]; ++i) {
+        if (FaceVisit[EdgeFaces[i]] != Visit) {
+            face = EdgeFaces[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<glm::vec3>& PlaneSlicer::getPoints() const
+{
+    return Points;
+}
+
+const std::vector<PlaneSlicer::Polyline>& PlaneSlicer::getPolylines() const
+{
+    return Polylines;
+}
+
+const PlaneSlicer::Stats& PlaneSlicer::getStats() const
+{
+    return LastSlice;
+}
+
+void PlaneSlicer::fitPlane(const glm::vec3* points, unsigned int count, glm::vec3& point, glm::vec3& normal)
+{
+    point = glm::vec3(0);
+    normal = glm::vec3(0, 0, 1);
+    if (count == 0)
+        return;
+    for (unsigned int i = 0; i < count; ++i)
+        point += points[i];
+    point /= float(count);
+
+    double a[3][3] = { { 0 } };
+    for (unsigned int i = 0; i < count; ++i) {
+        glm::vec3 d = points[i] - point;
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c)
+                a[r][c] += d[r] * d[c];
+    }
+
+    // Jacobi rotations until the covariance is diagonal, the columns of v
+    // being its eigenvectors and the diagonal their spread
+    double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    for (int sweep = 0; sweep < 32; ++sweep) {
+        int p = 0, q = 1;
+        if (std::fabs(a[0][2]) > std::fabs(a[p][q])) { p = 0; q = 2; }
+        if (std::fabs(a[1][2]) > std::fabs(a[p][q])) { p = 1; q = 2; }
+        if (std::fabs(a[p][q]) <= 1e-12 * (std::fabs(a[p][p]) + std::fabs(a[q][q])))
+            break;
+        double angle = 0.5 * std::atan2(2 * a[p][q], a[q][q] - a[p][p]);
+        double c = std::cos(angle), s = std::sin(angle);
+        for (int k = 0; k < 3; ++k) {
+            double kp = a[k][p], kq = a[k][q];
+            a[k][p] = c * kp - s * kq;
+            a[k][q] = s * kp + c * kq;
+        }
+        for (int k = 0; k < 3; ++k) {
+            double pk = a[p][k], qk = a[q][k];
+            a[p][k] = c * pk - s * qk;
+            a[q][k] = s * pk + c * qk;
+        }
+        for (int k = 0; k < 3; ++k) {
+            double kp = v[k][p], kq = v[k][q];
+            v[k][p] = c * kp - s * kq;
+            v[k][q] = s * kp + c * kq;
+        }
+    }
+
+    int least = 0;
+    for (int i = 1; i < 3; ++i)
+        if (a[i][i] < a[least][least])
+            least = i;
+    normal = glm::normalize(glm::vec3(float(v[0][least]), float(v[1][least]), float(v[2][least])));
+}
@@ -0,0 +1,102 @@
+#ifndef PLANE_SLICER_H_
+#define PLANE_SLICER_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "vertexstreams.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    /**
+    *   Cross section of a mesh with a plane, as polylines.
+    *
+    *   The edges, and the faces on either side of every edge, are worked out
+    *   once per topology. Each slice keeps the side of the plane every vertex
+    *   was on, so from one slice to the next only the edges around vertices
+    *   that changed sides are looked at again. Every slice still moves the
+    *   points on the edges the plane crosses to where those edges are now,
+    *   and links them through the faces they share.
+    *
+    *   The polylines come out back to back in getPoints(), with a start and
+    *   count each, as glMultiDrawArrays takes them (GL_LINE_STRIP, closed
+    *   ones need their last point joined back to their first).
+    */
+    class PlaneSlicer
+    {
+    public:
+        struct Polyline
+        {
+            uint32_t start;         // into getPoints()
+            uint32_t count;
+            bool closed;            // the last point joins back to the first
+        };
+
+        // What the last slice() did.
+        struct Stats
+        {
+            unsigned int sideChanges;       // vertices that went over to the other side
+            unsigned int edgesWalked;       // edges looked at again because of them
+            unsigned int crossingEdges;
+            unsigned int polylines;
+            unsigned int points;
+        };
+
+        PlaneSlicer();
+
+        void setTopology(const MeshBuffer& mesh);
+        void setTopology(const uint32_t* indices, unsigned int idxCnt, unsigned int vertCnt);
+        void clear();
+
+        // Slices positions laid out as the topology's vertices with the plane
+        // through point facing normal (any length).
+        void slice(const glm::vec3* verts, const glm::vec3& point, const glm::vec3& normal);
+        void slice(const VertexStreams& verts, const glm::vec3& point, const glm::vec3& normal);
+        void slice(const MeshBuffer& mesh, const glm::vec3& point, const glm::vec3& normal);
+
+        const std::vector<glm::vec3>& getPoints() const;
+        const std::vector<Polyline>& getPolylines() const;
+        const Stats& getStats() const;
+
+        // Plane closest to a set of points, through their mean and facing the
+        // way they spread least.
+        static void fitPlane(const glm::vec3* points, unsigned int count, glm::vec3& point, glm::vec3& normal);
+
+    private:
+        template <typename In> void sliceFrom(const In& in, const glm::vec3& point, const glm::vec3& normal);
+        void setCrossing(uint32_t edge, bool crossing);
+        void link();
+        void walk(uint32_t start);
+        bool nextFace(uint32_t edge, uint32_t& face) const;
+
+        // topology
+        std::vector<uint32_t> EdgeVerts;        // two per edge
+        std::vector<uint32_t> FaceEdges;        // three per face
+        std::vector<uint32_t> EdgeFaceStart;    // faces around edge e are EdgeFaces[EdgeFaceStart[e]..EdgeFaceStart[e + 1])
+        std::vector<uint32_t> EdgeFaces;
+        std::vector<uint32_t> VertEdgeStart;    // same for the edges around every vertex
+        std::vector<uint32_t> VertEdges;
+
+        // carried from one slice to the next
+        std::vector<uint8_t> Sides;             // 1 for vertices in front of the plane
+        std::vector<uint32_t> Crossing;         // edges whose two vertices are on different sides
+        std::vector<uint32_t> CrossingSlot;     // where each edge sits in Crossing, NotCrossing if it isn't there
+        std::vector<uint32_t> FaceVisit;        // slice a face was last linked through
+        uint32_t Visit;
+
+        // this slice's
+        std::vector<float> Distances;           // of every vertex from the plane
+        std::vector<glm::vec3> Cuts;            // where each crossing edge meets the plane, in Crossing order
+
+        std::vector<glm::vec3> Points;
+        std::vector<Polyline> Polylines;
+        Stats LastSlice;
+
+        static const uint32_t NotCrossing = 0xffffffff;
+    };
+}
+
+#endif // PLANE_SLICER_H_
@@ -0,0 +1,445 @@
+#include "plyloader.h"
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+#include "mappedfile.h"
+#include "byteorder.h"
+
+using namespace std;
+using namespace ogle;
+
+namespace
+{
+    enum ScalarType
+    {
+        Int8, Uint8, Int16, Uint16, Int32, Uint32, Float32, Float64, BadType
+    };
+
+    struct Property
+    {
+        std::string name;
+        ScalarType type;
+        ScalarType countType;       // lists only
+        bool list;
+    };
+
+    struct Element
+    {
+        std::string name;
+        size_t count;
+        std::vector<Property> properties;
+        size_t stride;              // bytes per record, 0 when it holds lists
+    };
+
+    ScalarType scalarType(const std::string& name)
+    {
+        if (name == "char" || name == "int8") return Int8;
+        if (name == "uchar" || name == "uint8") return Uint8;
+        if (name == "short" || name == "int16") return Int16;
+        if (name == "ushort" || name == "uint16") return Uint16;
+        if (name == "int" || name == "int32") return Int32;
+        if (name == "uint" || name == "uint32") return Uint32;
+        if (name == "float" || name == "float32") return Float32;
+        if (name == "double" || name == "float64") return Float64;
+        return BadType;
+    }
+
+    size_t scalarSize(ScalarType type)
+    {
+        static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+        return sizes[type];
+    }
+
+    // Reads one scalar of type at p, swapping its bytes first when the file's order isn't ours.
+    double readScalar(const char* p, ScalarType type, bool swap)
+    {
+        unsigned char bytes[8];
+        size_t size = scalarSize(type);
+        memcpy(bytes, p, size);
+        if (swap)
+            std::reverse(bytes, bytes + size);
+
+        switch (type) {
+        case Int8:    { int8_t v;   memcpy(&v, bytes, 1); return v; }
+        case Uint8:   { uint8_t v;  memcpy(&v, bytes, 1); return v; }
+        case Int16:   { int16_t v;  memcpy(&v, bytes, 2); return v; }
+        case Uint16:  { uint16_t v; memcpy(&v, bytes, 2); return v; }
+        case Int32:   { int32_t v;  memcpy(&v, bytes, 4); return v; }
+        case Uint32:  { uint32_t v; memcpy(&v, bytes, 4); return v; }
+        case Float32: { float v;    memcpy(&v, bytes, 4); return v; }
+        case Float64: { double v;   memcpy(&v, bytes, 8); return v; }
+        default: return 0;
+        }
+    }
+
+    // Indices are read as integers, a double can't hold every uint32 mix up.
+    // Negative ones come back past any vertex, for the range check to catch.
+    uint32_t readIndex(const char* p, ScalarType type, bool swap)
+    {
+        if (type == Int32 || type == Uint32) {
+            uint32_t v;
+            memcpy(&v, p, 4);
+            if (swap)
+                v = swapBytes(v);
+            return v;
+        }
+        double v = readScalar(p, type, swap);
+        return (v >= 0 && v < 4294967295.0) ? (uint32_t)v : 0xffffffff;
+    }
+
+    // A list's length, false if it is negative (or no length at all).
+    bool readCount(const char* p, ScalarType type, bool swap, size_t& count)
+    {
+        double v = readScalar(p, type, swap);
+        if (!(v >= 0 && v <= 4294967295.0))
+            return false;
+        count = (size_t)v;
+        return true;
+    }
+}
+
+// Reads the header up to end_header, body is left at the first byte after it.
+static bool parseHeader(const char* data, size_t size, bool& littleEndian, std::vector<Element>& elements, const char*& body)
+{
+    const char* end = data + size;
+    const char* cursor = data;
+    bool sawFormat = false;
+
+    while (cursor < end) {
+        const char* eol = (const char*)memchr(cursor, '\n', end - cursor);
+        if (!eol)
+            return false;
+        std::istringstream line(std::string(cursor, eol));
+        cursor = eol + 1;
+
+        std::string keyword;
+        line >> keyword;
+        if (keyword == "ply" || keyword == "comment" || keyword == "obj_info" || keyword.empty()) {
+            continue;
+        }
+        else if (keyword == "format") {
+            std::string format;
+            line >> format;
+            if (format == "binary_little_endian")
+                littleEndian = true;
+            else if (format == "binary_big_endian")
+                littleEndian = false;
+            else {
+                cerr << "[!] Only binary ply files are read, this one is: " << format << endl;
+                return false;
+            }
+            sawFormat = true;
+        }
+        else if (keyword == "element") {
+            Element element;
+            line >> element.name >> element.count;
+            element.stride = 0;
+            elements.push_back(element);
+        }
+        else if (keyword == "property") {
+            if (elements.empty())
+                return false;
+
+            Property property;
+            std::string type;
+            line >> type;
+            property.list = type == "list";
+            if (property.list) {
+                std::string countType, itemType;
+                line >> countType >> itemType;
+                property.countType = scalarType(countType);
+                property.type = scalarType(itemType);
+                if (property.countType == BadType)
+                    return false;
+            }
+            else {
+                property.countType = BadType;
+                property.type = scalarType(type);
+            }
+            line >> property.name;
+            if (property.type == BadType)
+                return false;
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header") {
+            body = cursor;
+            break;
+        }
+    }
+
+    if (!sawFormat || !body)
+        return false;
+
+    for (size_t e = 0; e < elements.size(); ++e) {
+        Element& element = elements[e];
+        size_t stride = 0;
+        for (size_t p = 0; p < element.properties.size() && stride != (size_t)-1; ++p)
+            stride = element.properties[p].list ? (size_t)-1 : stride + scalarSize(element.properties[p].type);
+        element.stride = stride == (size_t)-1 ? 0 : stride;
+    }
+    return true;
+}
+
+// Bytes taken by one record of an element with lists, 0 if it runs past end
+// or a list has a negative length.
+static size_t recordSize(const Element& element, const char* p, const char* end, bool swap)
+{
+    const char* start = p;
+    for (size_t i = 0; i < element.properties.size(); ++i) {
+        const Property& property = element.properties[i];
+        if (!property.list) {
+            if ((size_t)(end - p) < scalarSize(property.type))
+                return 0;
+            p += scalarSize(property.type);
+            continue;
+        }
+        if ((size_t)(end - p) < scalarSize(property.countType))
+            return 0;
+        size_t count;
+        if (!readCount(p, property.countType, swap, count))
+            return 0;
+        p += scalarSize(property.countType);
+        if ((size_t)(end - p) / scalarSize(property.type) < count)
+            return 0;
+        p += count * scalarSize(property.type);
+    }
+    return p - start;
+}
+
+PlyLoader::PlyLoader()
+{
+}
+
+bool PlyLoader::load(const std::string& filename)
+{
+    Positions.clear();
+    Indices.clear();
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "[!] Failed to load file: " << filename << endl;
+        return false;
+    }
+
+    bool littleEndian = true;
+    std::vector<Element> elements;
+    const char* body = 0;
+    if (file.size() < 4 || memcmp(file.data(), "ply", 3) != 0
+        || !parseHeader(file.data(), file.size(), littleEndian, elements, body)) {
+        cerr << "[!] Not a ply file that can be read: " << filename << endl;
+        return false;
+    }
+
+    bool swap = littleEndian != hostIsLittleEndian();
+    const char* p = body;
+    const char* end = file.data() + file.size();
+
+    for (size_t e = 0; e < elements.size(); ++e) {
+        const Element& element = elements[e];
+
+        if (element.name == "vertex") {
+            // where x, y and z sit in a record
+            int axes[3] = { -1, -1, -1 };
+            size_t offsets[3] = { 0, 0, 0 };
+            size_t offset = 0;
+            for (size_t i = 0; i < element.properties.size(); ++i) {
+                const Property& property = element.properties[i];
+                int axis = property.name == "x" ? 0 : property.name == "y" ? 1 : property.name == "z" ? 2 : -1;
+                if (axis >= 0 && !property.list) {
+                    axes[axis] = (int)i;
+                    offsets[axis] = offset;
+                }
+                offset += scalarSize(property.type);
+            }
+            if (element.stride == 0 || axes[0] < 0 || axes[1] < 0 || axes[2] < 0) {
+                cerr << "[!] Ply vertices need x, y and z and no lists: " << filename << endl;
+                return false;
+            }
+            if ((size_t)(end - p) / element.stride < element.count) {
+                cerr << "[!] Ply file is cut short: " << filename << endl;
+                return false;
+            }
+
+            Positions.resize(element.count);
+            const Property& x = element.properties[axes[0]];
+            const Property& y = element.properties[axes[1]];
+            const Property& z = element.properties[axes[2]];
+            bool packed = !swap && element.stride == sizeof(glm::vec3) && x.type == Float32 && y.type == Float32 && z.type == Float32
+                && offsets[0] == 0 && offsets[1] == 4 && offsets[2] == 8;
+
+            if (packed) {
+                if (element.count)
+                    memcpy(&Positions[0], p, element.count * sizeof(glm::vec3));
+            }
+            else if (x.type == Float32 && y.type == Float32 && z.type == Float32) {
+                const char* record = p;
+                for (size_t v = 0; v < element.count; ++v, record += element.stride) {
+                    uint32_t bits[3];
+                    for (int k = 0; k < 3; ++k) {
+                        memcpy(&bits[k], record + offsets[k], 4);
+                        if (swap)
+                            bits[k] = swapBytes(bits[k]);
+                    }
+                    float xyz[3];
+                    memcpy(xyz, bits, sizeof(xyz));
+                    Positions[v] = glm::vec3(xyz[0], xyz[1], xyz[2]);
+                }
+            }
+            else {
+                const char* record = p;
+                for (size_t v = 0; v < element.count; ++v, record += element.stride) {
+                    Positions[v] = glm::vec3(readScalar(record + offsets[0], x.type, swap),
+                                             readScalar(record + offsets[1], y.type, swap),
+                                             readScalar(record + offsets[2], z.type, swap));
+                }
+            }
+            p += element.count * element.stride;
+            file.release(body - file.data(), p - body);
+        }
+        else if (element.name == "face") {
+            int indexList = -1;
+            for (size_t i = 0; i < element.properties.size(); ++i) {
+                const Property& property = element.properties[i];
+                if (property.list && (property.name == "vertex_indices" || property.name == "vertex_index"))
+                    indexList = (int)i;
+            }
+            if (indexList < 0) {
+                cerr << "[!] Ply faces have no vertex_indices: " << filename << endl;
+                return false;
+            }
+
+            const Property& list = element.properties[indexList];
+            size_t countSize = scalarSize(list.countType);
+            size_t indexSize = scalarSize(list.type);
+
+            // the count is only what the header says, no more faces than the bytes left can hold
+            size_t smallestFace = 0;
+            for (size_t i = 0; i < element.properties.size(); ++i) {
+                const Property& property = element.properties[i];
+                smallestFace += scalarSize(property.list ? property.countType : property.type);
+            }
+            Indices.reserve(std::min(element.count, (size_t)(end - p) / smallestFace) * 3);
+
+            // what nearly every exporter writes, a byte 3 and three 4 byte indices
+            bool triangleRecords = element.properties.size() == 1 && countSize == 1 && indexSize == 4;
+
+            for (size_t f = 0; f < element.count; ++f) {
+                if (triangleRecords && (size_t)(end - p) >= 13 && *p == 3) {
+                    uint32_t tri[3];
+                    memcpy(tri, p + 1, sizeof(tri));
+                    for (int k = 0; k < 3; ++k)
+                        Indices.push_back(swap ? readIndex(p + 1 + 4 * k, list.type, swap) : tri[k]);
+                    p += 13;
+                    continue;
+                }
+
+                for (size_t i = 0; i < element.properties.size(); ++i) {
+                    const Property& property = element.properties[i];
+                    if (!property.list) {
+                        if ((size_t)(end - p) < scalarSize(property.type)) {
+                            cerr << "[!] Ply file is cut short: " << filename << endl;
+                            return false;
+                        }
+                        p += scalarSize(property.type);
+                        continue;
+                    }
+                    size_t count;
+                    if ((size_t)(end - p) < scalarSize(property.countType) || !readCount(p, property.countType, swap, count)) {
+                        cerr << "[!] Ply file is cut short: " << filename << endl;
+                        return false;
+                    }
+                    p += scalarSize(property.countType);
+                    if ((size_t)(end - p) / scalarSize(property.type) < count) {
+                        cerr << "[!] Ply file is cut short: " << filename << endl;
+                        return false;
+                    }
+                    if ((int)i != indexList) {
+                        p += count * scalarSize(property.type);
+                        continue;
+                    }
+
+                    // fan polygons into triangles like the obj loader does
+                    uint32_t first = count ? readIndex(p, list.type, swap) : 0;
+                    uint32_t previous = count > 1 ? readIndex(p + indexSize, list.type, swap) : 0;
+                    for (size_t k = 2; k < count; ++k) {
+                        uint32_t next = readIndex(p + k * indexSize, list.type, swap);
+                        Indices.push_back(first);
+                        Indices.push_back(previous);
+                        Indices.push_back(next);
+                        previous = next;
+                    }
+                    p += count * indexSize;
+                }
+            }
+        }
+        else {
+            // anything else only needs stepping over
+            if (element.properties.empty())
+                continue;
+            if (element.stride) {
+                if ((size_t)(end - p) / element.stride < element.count) {
+                    cerr << "[!] Ply file is cut short: " << filename << endl;
+                    return false;
+                }
+                p += element.count * element.stride;
+            }
+            else {
+                for (size_t r = 0; r < element.count; ++r) {
+                    size_t bytes = recordSize(element, p, end, swap);
+                    if (!bytes) {
+                        cerr << "[!] Ply file is cut short: " << filename << endl;
+                        return false;
+                    }
+                    p += bytes;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < Indices.size(); ++i) {
+        if (Indices[i] >= Positions.size()) {
+            cerr << "[!] Ply face points past the vertices: " << filename << endl;
+            Positions.clear();
+            Indices.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t PlyLoader::getVertCount() const
+{
+    return Positions.size();
+}
+
+size_t PlyLoader::getIndexCount() const
+{
+    return Indices.size();
+}
+
+const std::vector<glm::vec3>& PlyLoader::getPositions() const
+{
+    return Positions;
+}
+
+const std::vector<uint32_t>& PlyLoader::getIndices() const
+{
+    return Indices;
+}
+
+std::vector<glm::vec3> PlyLoader::releasePositions()
+{
+    std::vector<glm::vec3> positions;
+    positions.swap(Positions);
+    return positions;
+}
+
+std::vector<uint32_t> PlyLoader::releaseIndices()
+{
+    std::vector<uint32_t> indices;
+    indices.swap(Indices);
+    return indices;
+}
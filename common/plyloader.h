@@ -0,0 +1,46 @@
+#ifndef PLY_LOADER_H_
+#define PLY_LOADER_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+namespace ogle
+{
+    /**
+    *   Reads positions and triangles out of a binary ply, little or big
+    *   endian, the way ObjLoader hands them out of an obj.
+    *
+    *   The file is mapped and read in place. Vertex x, y and z can be any
+    *   scalar type, faces any list of indices (polygons are fanned into
+    *   triangles), anything else in the file is stepped over. Vertices that
+    *   are just x, y and z floats in the machine's byte order are copied
+    *   straight out of the mapping in one go.
+    *
+    *   ascii plys are not read, that is what obj is for.
+    */
+    class PlyLoader
+    {
+    public:
+        PlyLoader();
+
+        // false, with the reason on cerr, if the file couldn't be read
+        bool load(const std::string& filename);
+
+        size_t getVertCount() const;
+        size_t getIndexCount() const;
+        const std::vector<glm::vec3>& getPositions() const;
+        const std::vector<uint32_t>& getIndices() const;
+
+        // Hand the loaded arrays over without copying, the loader is left without them.
+        std::vector<glm::vec3> releasePositions();
+        std::vector<uint32_t> releaseIndices();
+
+    private:
+        std::vector<glm::vec3> Positions;
+        std::vector<uint32_t> Indices;     // three per triangle
+    };
+}
+
+#endif // PLY_LOADER_H_
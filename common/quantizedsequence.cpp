@@ -0,0 +1,248 @@
+#include "quantizedsequence.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "meshbuffer.h"
+#include "meshsequence.h"
+
+using namespace ogle;
+
+// Decodes two keyframes and blends them in one pass. Every position is the
+// decoded reference plus a scaled delta, the same expression encode() uses.
+template <typename DeltaA, typename DeltaB>
+static void blendFrames(unsigned int count, const uint16_t* reference, const glm::vec3& origin, const glm::vec3& referenceStep,
+                        const DeltaA* deltasA, float stepA, const DeltaB* deltasB, float stepB, float tween, glm::vec3* out)
+{
+    const float ox = origin.x, oy = origin.y, oz = origin.z;
+    const float sx = referenceStep.x, sy = referenceStep.y, sz = referenceStep.z;
+    float* dst = &out[0].x;
+    for (unsigned int i = 0; i < count; ++i, reference += 3, deltasA += 3, deltasB += 3, dst += 3) {
+        float bx = ox + reference[0] * sx;
+        float by = oy + reference[1] * sy;
+        float bz = oz + reference[2] * sz;
+        float ax = bx + deltasA[0] * stepA, ay = by + deltasA[1] * stepA, az = bz + deltasA[2] * stepA;
+        dst[0] = tween * ((bx + deltasB[0] * stepB) - ax) + ax;
+        dst[1] = tween * ((by + deltasB[1] * stepB) - ay) + ay;
+        dst[2] = tween * ((bz + deltasB[2] * stepB) - az) + az;
+    }
+}
+
+template <typename DeltaA>
+static void blendFrames(unsigned int count, const uint16_t* reference, const glm::vec3& origin, const glm::vec3& referenceStep,
+                        const DeltaA* deltasA, float stepA, const int8_t* deltas8B, const int16_t* deltas16B, float stepB, float tween, glm::vec3* out)
+{
+    if (deltas8B)
+        blendFrames(count, reference, origin, referenceStep, deltasA, stepA, deltas8B, stepB, tween, out);
+    else
+        blendFrames(count, reference, origin, referenceStep, deltasA, stepA, deltas16B, stepB, tween, out);
+}
+
+QuantizedSequence::QuantizedSequence()
+    : VertCnt(0)
+{
+    clear();
+}
+
+void QuantizedSequence::clear()
+{
+    VertCnt = 0;
+    std::vector<uint32_t>().swap(Indices);
+    SubMeshList().swap(SubMeshes);
+    std::vector<uint16_t>().swap(Reference);
+    std::vector<Frame>().swap(Frames);
+    std::vector<int8_t>().swap(Deltas8);
+    std::vector<int16_t>().swap(Deltas16);
+    ReferenceMin = glm::vec3(0.f);
+    ReferenceStep = glm::vec3(0.f);
+
+    Stats.rawBytes = 0;
+    Stats.encodedBytes = 0;
+    Stats.compressionRatio = 0;
+    Stats.errorBound = 0;
+    Stats.maxError = 0;
+    Stats.frames8Bit = 0;
+    Stats.frames16Bit = 0;
+}
+
+void QuantizedSequence::encode(const MeshSequence& sequence, float errorBound, unsigned int referenceFrame)
+{
+    clear();
+
+    unsigned int frameCnt = sequence.getFrameCnt();
+    VertCnt = sequence.getVertCnt();
+    Indices = sequence.getIndices();
+    SubMeshes = sequence.getSubMeshes();
+    if (frameCnt == 0 || VertCnt == 0)
+        return;
+    referenceFrame = std::min(referenceFrame, frameCnt - 1);
+
+    // the reference is quantized to the bounds of the whole sequence
+    std::vector<glm::vec3> verts;
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (unsigned int f = 0; f < frameCnt; ++f) {
+        sequence.getFrame(f, verts);
+        for (unsigned int v = 0; v < VertCnt; ++v) {
+            lo = glm::min(lo, verts[v]);
+            hi = glm::max(hi, verts[v]);
+        }
+    }
+    ReferenceMin = lo;
+    ReferenceStep = (hi - lo) / 65535.f;
+
+    sequence.getFrame(referenceFrame, verts);
+    Reference.resize(VertCnt * 3);
+    std::vector<glm::vec3> decodedReference(VertCnt);
+    for (unsigned int v = 0; v < VertCnt; ++v) {
+        for (int c = 0; c < 3; ++c) {
+            float q = ReferenceStep[c] > 0 ? (verts[v][c] - ReferenceMin[c]) / ReferenceStep[c] : 0.f;
+            Reference[v * 3 + c] = (uint16_t)std::min(65535.f, std::max(0.f, floorf(q + .5f)));
+            decodedReference[v][c] = ReferenceMin[c] + Reference[v * 3 + c] * ReferenceStep[c];
+        }
+    }
+
+    // a step of 2b/sqrt(3) keeps each component within b/sqrt(3) of the original, so the distance stays within b
+    float boundStep = errorBound > 0 ? 2.f * errorBound / sqrtf(3.f) : 0.f;
+
+    Frames.resize(frameCnt);
+    for (unsigned int f = 0; f < frameCnt; ++f) {
+        sequence.getFrame(f, verts);
+
+        float maxDelta = 0;
+        for (unsigned int v = 0; v < VertCnt; ++v)
+            for (int c = 0; c < 3; ++c)
+                maxDelta = std::max(maxDelta, fabsf(verts[v][c] - decodedReference[v][c]));
+
+        Frame& frame = Frames[f];
+        frame.step = boundStep;
+        if (maxDelta == 0) {
+            frame.step = 1;
+            frame.bits = 8;
+        }
+        else if (boundStep > 0 && maxDelta / boundStep <= 127.f) {
+            frame.bits = 8;
+        }
+        else {
+            frame.bits = 16;
+            if (boundStep <= 0 || maxDelta / boundStep > 32767.f)
+                frame.step = maxDelta / 32767.f;
+        }
+
+        frame.offset = (frame.bits == 8) ? Deltas8.size() : Deltas16.size();
+        for (unsigned int v = 0; v < VertCnt; ++v) {
+            for (int c = 0; c < 3; ++c) {
+                float q = floorf((verts[v][c] - decodedReference[v][c]) / frame.step + .5f);
+                if (frame.bits == 8)
+                    Deltas8.push_back((int8_t)std::min(127.f, std::max(-127.f, q)));
+                else
+                    Deltas16.push_back((int16_t)std::min(32767.f, std::max(-32767.f, q)));
+            }
+        }
+
+        if (frame.bits == 8) ++Stats.frames8Bit;
+        else ++Stats.frames16Bit;
+    }
+
+    // measure what actually comes back out
+    std::vector<glm::vec3> decoded;
+    for (unsigned int f = 0; f < frameCnt; ++f) {
+        sequence.getFrame(f, verts);
+        getFrame(f, decoded);
+        for (unsigned int v = 0; v < VertCnt; ++v)
+            Stats.maxError = std::max(Stats.maxError, glm::length(decoded[v] - verts[v]));
+    }
+
+    Stats.errorBound = errorBound;
+    Stats.rawBytes = (size_t)frameCnt * VertCnt * sizeof(glm::vec3);
+    Stats.encodedBytes = Reference.size() * sizeof(uint16_t)
+                       + Deltas8.size() * sizeof(int8_t)
+                       + Deltas16.size() * sizeof(int16_t)
+                       + Frames.size() * sizeof(Frame);
+    Stats.compressionRatio = Stats.rawBytes / (float)Stats.encodedBytes;
+}
+
+unsigned int QuantizedSequence::getFrameCnt() const
+{
+    return (unsigned int)Frames.size();
+}
+
+unsigned int QuantizedSequence::getVertCnt() const
+{
+    return VertCnt;
+}
+
+unsigned int QuantizedSequence::getIdxCnt() const
+{
+    return (unsigned int)Indices.size();
+}
+
+const std::vector<uint32_t>& QuantizedSequence::getIndices() const
+{
+    return Indices;
+}
+
+const SubMeshList& QuantizedSequence::getSubMeshes() const
+{
+    return SubMeshes;
+}
+
+void QuantizedSequence::getFrame(unsigned int frame, std::vector<glm::vec3>& verts) const
+{
+    sample(frame, frame, 0.f, verts);
+}
+
+void QuantizedSequence::sample(float frame, bool loop, std::vector<glm::vec3>& verts) const
+{
+    verts.resize(Frames.empty() ? 0 : VertCnt);
+    if (!verts.empty())
+        sample(frame, loop, verts.data());
+}
+
+void QuantizedSequence::sample(float frame, bool loop, glm::vec3* verts) const
+{
+    if (Frames.empty())
+        return;
+
+    unsigned int frameA, frameB;
+    float tween;
+    MeshSequence::findKeyframes(frame, loop, (unsigned int)Frames.size(), frameA, frameB, tween);
+    sample(frameA, frameB, tween, verts);
+}
+
+void QuantizedSequence::sample(unsigned int frameA, unsigned int frameB, float tween, std::vector<glm::vec3>& verts) const
+{
+    verts.resize(VertCnt);
+    if (VertCnt)
+        sample(frameA, frameB, tween, verts.data());
+}
+
+void QuantizedSequence::sample(unsigned int frameA, unsigned int frameB, float tween, glm::vec3* verts) const
+{
+    if (VertCnt == 0)
+        return;
+
+    const Frame& a = Frames[frameA];
+    const Frame& b = Frames[frameB];
+    const int8_t* deltas8B = (b.bits == 8) ? &Deltas8[b.offset] : 0;
+    const int16_t* deltas16B = (b.bits == 16) ? &Deltas16[b.offset] : 0;
+
+    if (a.bits == 8)
+        blendFrames(VertCnt, Reference.data(), ReferenceMin, ReferenceStep, &Deltas8[a.offset], a.step, deltas8B, deltas16B, b.step, tween, verts);
+    else
+        blendFrames(VertCnt, Reference.data(), ReferenceMin, ReferenceStep, &Deltas16[a.offset], a.step, deltas8B, deltas16B, b.step, tween, verts);
+}
+
+void QuantizedSequence::makeMesh(unsigned int frame, MeshBuffer& mesh) const
+{
+    std::vector<glm::vec3> verts;
+    getFrame(frame, verts);
+    mesh.setVerts(std::move(verts));
+    mesh.setIndices((unsigned int)Indices.size(), Indices.data());
+    mesh.setSubMeshes(SubMeshes);
+}
+
+const QuantizedSequence::Report& QuantizedSequence::getReport() const
+{
+    return Stats;
+}
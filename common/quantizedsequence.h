@@ -0,0 +1,90 @@
+#ifndef QUANTIZED_SEQUENCE_H_
+#define QUANTIZED_SEQUENCE_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "submesh.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    class MeshSequence;
+
+    /**
+    *   Compressed copy of a MeshSequence's keyframes.
+    *
+    *   A reference keyframe is stored as 16 bit positions quantized to the
+    *   AABB of the whole sequence. Every keyframe is then stored as a
+    *   per-vertex delta from the decoded reference, quantized to a step picked
+    *   from the error bound: 8 bits per component when the frame's deltas fit,
+    *   16 bits otherwise. A frame whose deltas don't fit in 16 bits at that
+    *   step gets a coarser step, and the report's max error says so.
+    */
+    class QuantizedSequence
+    {
+    public:
+        struct Report
+        {
+            size_t rawBytes;        // positions as float keyframes
+            size_t encodedBytes;    // reference, deltas and per frame headers
+            float compressionRatio;
+            float errorBound;
+            float maxError;         // largest distance between an original and decoded vertex
+            unsigned int frames8Bit;
+            unsigned int frames16Bit;
+        };
+
+        QuantizedSequence();
+
+        // errorBound is the largest distance any decoded vertex may be from its original.
+        void encode(const MeshSequence& sequence, float errorBound, unsigned int referenceFrame = 0);
+        void clear();
+
+        unsigned int getFrameCnt() const;
+        unsigned int getVertCnt() const;
+        unsigned int getIdxCnt() const;
+        const std::vector<uint32_t>& getIndices() const;
+        const SubMeshList& getSubMeshes() const;
+
+        void getFrame(unsigned int frame, std::vector<glm::vec3>& verts) const;
+
+        // Same meaning as MeshSequence::sample, decodes and blends in one pass.
+        void sample(float frame, bool loop, std::vector<glm::vec3>& verts) const;
+        void sample(unsigned int frameA, unsigned int frameB, float tween, std::vector<glm::vec3>& verts) const;
+
+        // Same as above into caller owned storage of getVertCnt() positions, never allocates.
+        void sample(float frame, bool loop, glm::vec3* verts) const;
+        void sample(unsigned int frameA, unsigned int frameB, float tween, glm::vec3* verts) const;
+
+        void makeMesh(unsigned int frame, MeshBuffer& mesh) const;
+
+        const Report& getReport() const;
+
+    private:
+        struct Frame
+        {
+            float step;
+            unsigned int bits;      // 8 or 16
+            size_t offset;          // into Deltas8 or Deltas16
+        };
+
+        unsigned int VertCnt;
+        std::vector<uint32_t> Indices;
+        SubMeshList SubMeshes;
+
+        glm::vec3 ReferenceMin;
+        glm::vec3 ReferenceStep;
+        std::vector<uint16_t> Reference;
+
+        std::vector<Frame> Frames;
+        std::vector<int8_t> Deltas8;
+        std::vector<int16_t> Deltas16;
+
+        Report Stats;
+    };
+}
+
+#endif // QUANTIZED_SEQUENCE_H_
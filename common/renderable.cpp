@@ -17,6 +17,8 @@ Renderable::Renderable()
     , VAO(0)
     , VBO(0)
     , IBO(0)
+    , IndexType(GL_UNSIGNED_INT)
+    , IndexSize(sizeof(GLuint))
     , IndexRangeStart(0)
     , IndexRangeEnd(0)
     , Normalidx(2)
@@ -81,7 +83,7 @@ void Renderable::render()
     if (IndiceCnt)
     {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-        glDrawElements(GL_TRIANGLES, IndexRangeEnd, GL_UNSIGNED_INT, (const void*)(IndexRangeStart * sizeof(unsigned int)));
+        glDrawElements(GL_TRIANGLES, IndexRangeEnd, IndexType, (const void*)((size_t)IndexRangeStart * IndexSize));
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     else
@@ -234,10 +236,22 @@ void Renderable::setMesh(const MeshBuffer& meshBuffer)
     IndiceCnt = meshBuffer.getIdxCnt();
     if (IndiceCnt)
     {        
+        // small meshes get 16 bit indices, half the memory and fetch bandwidth
+        IndexSize = meshBuffer.getIndexSize();
+        IndexType = meshBuffer.getIndexType() == MeshBuffer::Index16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        std::vector<uint16_t> narrowed;
+        const GLvoid* indices = (const GLvoid*)meshBuffer.getIndices().data();
+        if (meshBuffer.getIndexType() == MeshBuffer::Index16)
+        {
+            narrowed.resize(IndiceCnt);
+            meshBuffer.copyIndices(narrowed.data());
+            indices = (const GLvoid*)narrowed.data();
+        }
+
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            IndiceCnt * sizeof(GLuint),
-            (GLvoid*)meshBuffer.getIndices().data(),
+            IndiceCnt * IndexSize,
+            indices,
             GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
@@ -31,6 +31,8 @@ private:
     unsigned int VAO;
     unsigned int VBO;
     unsigned int IBO;
+    unsigned int IndexType;         // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    unsigned int IndexSize;
 
     const unsigned int Normalidx;
     const unsigned int Color0idx;
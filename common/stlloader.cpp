@@ -0,0 +1,136 @@
+#include "stlloader.h"
+
+#include <iostream>
+#include <cstring>
+
+#include "mappedfile.h"
+#include "byteorder.h"
+#include "uniquetable.h"
+
+using namespace std;
+using namespace ogle;
+
+namespace
+{
+    const size_t HeaderSize = 80 + 4;
+    const size_t FacetSize = 50;        // normal, three corners, two attribute bytes
+
+    // a corner's position bit for bit, so only exactly equal ones weld
+    struct PositionBits
+    {
+        uint32_t bits[3];
+    };
+
+    struct PositionTraits
+    {
+        static size_t hash(const PositionBits& p)
+        {
+            return hashWords(p.bits[0], p.bits[1], p.bits[2]);
+        }
+
+        static bool equal(const PositionBits& a, const PositionBits& b)
+        {
+            return a.bits[0] == b.bits[0] && a.bits[1] == b.bits[1] && a.bits[2] == b.bits[2];
+        }
+    };
+}
+
+StlLoader::StlLoader()
+{
+}
+
+bool StlLoader::load(const std::string& filename)
+{
+    Positions.clear();
+    Indices.clear();
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "[!] Failed to load file: " << filename << endl;
+        return false;
+    }
+
+    const char* data = file.data();
+    uint32_t facetCnt = 0;
+    if (file.size() >= HeaderSize)
+        memcpy(&facetCnt, data + 80, sizeof(facetCnt));
+    bool swap = !hostIsLittleEndian();
+    if (swap)
+        facetCnt = swapBytes(facetCnt);
+
+    // ascii files start with "solid" too, the size is what tells them apart
+    if (file.size() < HeaderSize || (file.size() - HeaderSize) / FacetSize != facetCnt || (file.size() - HeaderSize) % FacetSize) {
+        if (file.size() >= 5 && memcmp(data, "solid", 5) == 0)
+            cerr << "[!] Only binary stl files are read: " << filename << endl;
+        else
+            cerr << "[!] Not an stl file that can be read: " << filename << endl;
+        return false;
+    }
+
+    // closed meshes have about half as many vertices as triangles
+    UniqueTable<PositionBits, PositionTraits> table(facetCnt / 2 + 16);
+    Positions.reserve(facetCnt / 2 + 16);
+    Indices.resize((size_t)facetCnt * 3);
+
+    const char* facet = data + HeaderSize;
+    for (size_t f = 0; f < facetCnt; ++f, facet += FacetSize) {
+        PositionBits corners[3];
+        memcpy(corners, facet + 12, sizeof(corners));
+        for (int k = 0; k < 3; ++k) {
+            PositionBits& corner = corners[k];
+            for (int a = 0; a < 3; ++a) {
+                if (swap)
+                    corner.bits[a] = swapBytes(corner.bits[a]);
+                // -0 and 0 are the same place
+                if (corner.bits[a] == 0x80000000u)
+                    corner.bits[a] = 0;
+            }
+
+            uint32_t vertex = table.insert(corner);
+            if (vertex == Positions.size()) {
+                float xyz[3];
+                memcpy(xyz, corner.bits, sizeof(xyz));
+                Positions.push_back(glm::vec3(xyz[0], xyz[1], xyz[2]));
+            }
+            Indices[3 * f + k] = vertex;
+        }
+
+        if (f % 65536 == 65535)
+            file.release(0, facet - data);
+    }
+    return true;
+}
+
+size_t StlLoader::getVertCount() const
+{
+    return Positions.size();
+}
+
+size_t StlLoader::getIndexCount() const
+{
+    return Indices.size();
+}
+
+const std::vector<glm::vec3>& StlLoader::getPositions() const
+{
+    return Positions;
+}
+
+const std::vector<uint32_t>& StlLoader::getIndices() const
+{
+    return Indices;
+}
+
+std::vector<glm::vec3> StlLoader::releasePositions()
+{
+    std::vector<glm::vec3> positions;
+    positions.swap(Positions);
+    return positions;
+}
+
+std::vector<uint32_t> StlLoader::releaseIndices()
+{
+    std::vector<uint32_t> indices;
+    indices.swap(Indices);
+    return indices;
+}
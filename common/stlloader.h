@@ -0,0 +1,46 @@
+#ifndef STL_LOADER_H_
+#define STL_LOADER_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+namespace ogle
+{
+    /**
+    *   Reads a binary stl into positions and triangles, the way ObjLoader
+    *   hands them out of an obj.
+    *
+    *   stl keeps three corners per facet and no vertices at all, corners are
+    *   welded back into vertices through a hash of their exact positions.
+    *   Vertices come out in the order their first corner does, as an obj
+    *   loads when every position is its own vertex. The facet normals and
+    *   attribute bytes are skipped.
+    *
+    *   ascii stls are not read.
+    */
+    class StlLoader
+    {
+    public:
+        StlLoader();
+
+        // false, with the reason on cerr, if the file couldn't be read
+        bool load(const std::string& filename);
+
+        size_t getVertCount() const;
+        size_t getIndexCount() const;
+        const std::vector<glm::vec3>& getPositions() const;
+        const std::vector<uint32_t>& getIndices() const;
+
+        // Hand the loaded arrays over without copying, the loader is left without them.
+        std::vector<glm::vec3> releasePositions();
+        std::vector<uint32_t> releaseIndices();
+
+    private:
+        std::vector<glm::vec3> Positions;
+        std::vector<uint32_t> Indices;     // three per triangle
+    };
+}
+
+#endif // STL_LOADER_H_
@@ -0,0 +1,88 @@
+#include "submesh.h"
+
+#include <cstring>
+
+using namespace ogle;
+
+int ogle::findSubMesh(const SubMeshList& subMeshes, uint32_t triangle)
+{
+    uint32_t index = triangle * 3;
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        if (index >= subMeshes[i].indexStart && index - subMeshes[i].indexStart < subMeshes[i].indexCount)
+            return (int)i;
+    }
+    return -1;
+}
+
+int ogle::findSubMesh(const SubMeshList& subMeshes, const std::string& name)
+{
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        if (subMeshes[i].name == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+bool ogle::validSubMeshes(const SubMeshList& subMeshes, unsigned int idxCnt)
+{
+    uint64_t end = 0;
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        const SubMesh& sub = subMeshes[i];
+        if (sub.indexStart < end || sub.indexStart % 3 || sub.indexCount % 3)
+            return false;
+        end = (uint64_t)sub.indexStart + sub.indexCount;
+    }
+    return end <= idxCnt;
+}
+
+SubMeshList ogle::shrinkSubMeshes(const SubMeshList& subMeshes, const std::vector<uint32_t>& keptBefore)
+{
+    SubMeshList shrunk(subMeshes);
+    for (size_t i = 0; i < shrunk.size(); ++i) {
+        uint32_t first = keptBefore[subMeshes[i].indexStart / 3];
+        uint32_t last = keptBefore[(subMeshes[i].indexStart + subMeshes[i].indexCount) / 3];
+        shrunk[i].indexStart = first * 3;
+        shrunk[i].indexCount = (last - first) * 3;
+    }
+    return shrunk;
+}
+
+void ogle::packSubMeshes(const SubMeshList& subMeshes, std::vector<char>& out)
+{
+    out.clear();
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        const SubMesh& sub = subMeshes[i];
+        uint32_t fields[3] = { sub.indexStart, sub.indexCount, (uint32_t)sub.name.size() };
+        size_t at = out.size();
+        out.resize(at + sizeof(fields) + (sub.name.size() + 3) / 4 * 4, 0);
+        memcpy(&out[at], fields, sizeof(fields));
+        if (!sub.name.empty())
+            memcpy(&out[at + sizeof(fields)], sub.name.data(), sub.name.size());
+    }
+}
+
+bool ogle::unpackSubMeshes(const char* data, size_t size, uint32_t count, SubMeshList& subMeshes)
+{
+    subMeshes.clear();
+    subMeshes.reserve(count);
+    size_t at = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t fields[3];
+        if (size - at < sizeof(fields))
+            return false;
+        memcpy(fields, data + at, sizeof(fields));
+        at += sizeof(fields);
+
+        size_t padded = ((size_t)fields[2] + 3) / 4 * 4;
+        if (size - at < padded)
+            return false;
+
+        SubMesh sub;
+        sub.name.assign(data + at, fields[2]);
+        sub.indexStart = fields[0];
+        sub.indexCount = fields[1];
+        subMeshes.push_back(sub);
+        at += padded;
+    }
+    return at == size;
+}
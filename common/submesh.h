@@ -0,0 +1,48 @@
+#ifndef SUB_MESH_H_
+#define SUB_MESH_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace ogle
+{
+    /**
+    *   A named run of triangles inside a mesh's index buffer, one obj group
+    *   or object. Structures share the mesh's vertex and index buffers and
+    *   are told apart only by where their indices sit, so drawing one on its
+    *   own is a draw of its range.
+    *
+    *   Whatever moves or drops triangles keeps every structure's triangles
+    *   back to back and in their order, the ranges go along with it.
+    */
+    struct SubMesh
+    {
+        std::string name;
+        uint32_t indexStart;
+        uint32_t indexCount;
+    };
+
+    typedef std::vector<SubMesh> SubMeshList;
+
+    // Index of the structure holding triangle, -1 when none does.
+    int findSubMesh(const SubMeshList& subMeshes, uint32_t triangle);
+    // Index of the structure called name, -1 when there isn't one.
+    int findSubMesh(const SubMeshList& subMeshes, const std::string& name);
+
+    // Ranges that are in order, don't overlap and fit in idxCnt indices.
+    bool validSubMeshes(const SubMeshList& subMeshes, unsigned int idxCnt);
+
+    // Ranges after triangles were dropped from the buffer without moving the
+    // rest. keptBefore[t] is how many triangles ahead of old triangle t were
+    // kept, one more entry than there were triangles. Every range stays, a
+    // structure left with no triangles just gets a count of 0.
+    SubMeshList shrinkSubMeshes(const SubMeshList& subMeshes, const std::vector<uint32_t>& keptBefore);
+
+    // The table as it is kept in the mesh cache and keyframe packs: start,
+    // count and name length as uint32s, then the name padded to 4 bytes.
+    void packSubMeshes(const SubMeshList& subMeshes, std::vector<char>& out);
+    bool unpackSubMeshes(const char* data, size_t size, uint32_t count, SubMeshList& subMeshes);
+}
+
+#endif // SUB_MESH_H_
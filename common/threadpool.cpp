@@ -0,0 +1,50 @@
+#include "threadpool.h"
+
+using namespace ogle;
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : Stopping(false)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (unsigned int i = 0; i < threadCount; ++i)
+        Workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stopping = true;
+    }
+    Condition.notify_all();
+
+    // whatever is still queued gets run before the workers leave
+    for (size_t i = 0; i < Workers.size(); ++i)
+        Workers[i].join();
+}
+
+unsigned int ThreadPool::size() const
+{
+    return (unsigned int)Workers.size();
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Condition.wait(lock, [this]() { return Stopping || !Tasks.empty(); });
+            if (Tasks.empty())
+                return;
+
+            task = std::move(Tasks.front());
+            Tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace ogle
+{
+    /**
+    *   Fixed set of worker threads pulling tasks off a shared queue.
+    *   Tasks run in the order they were submitted, but finish in any order,
+    *   use the returned futures to collect results where they belong.
+    */
+    class ThreadPool
+    {
+    public:
+        // 0 uses one thread per core
+        explicit ThreadPool(unsigned int threadCount = 0);
+        ~ThreadPool();
+
+        unsigned int size() const;
+
+        template <typename Task>
+        std::future<typename std::result_of<Task()>::type> submit(Task task)
+        {
+            typedef typename std::result_of<Task()>::type Result;
+
+            // packaged_task can't be copied, std::function needs to be
+            std::shared_ptr<std::packaged_task<Result()> > packaged(new std::packaged_task<Result()>(task));
+            std::future<Result> result = packaged->get_future();
+            {
+                std::lock_guard<std::mutex> lock(Mutex);
+                Tasks.push_back([packaged]() { (*packaged)(); });
+            }
+            Condition.notify_one();
+            return result;
+        }
+
+    private:
+        ThreadPool(const ThreadPool& other);
+        ThreadPool& operator=(const ThreadPool& other);
+
+        void workerLoop();
+
+        std::vector<std::thread> Workers;
+        std::deque<std::function<void()> > Tasks;
+        std::mutex Mutex;
+        std::condition_variable Condition;
+        bool Stopping;
+    };
+}
+
+#endif // THREAD_POOL_H_
@@ -0,0 +1,470 @@
+#include "trianglebvh.h"
+
+#include <iostream>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "meshbuffer.h"
+
+using namespace std;
+using namespace ogle;
+
+static const unsigned int SahBins = 12;
+// past this many levels splits go by median, which takes at most 32 more,
+// so no path is longer than that and a query's stack never overflows
+static const unsigned int MaxBuildDepth = 48;
+static const unsigned int StackSize = 3 * (MaxBuildDepth + 32) + 1;
+
+namespace
+{
+    struct Box
+    {
+        Box() : lo(FLT_MAX), hi(-FLT_MAX) {}
+
+        void grow(const glm::vec3& p) { lo = glm::min(lo, p); hi = glm::max(hi, p); }
+        void grow(const Box& b) { lo = glm::min(lo, b.lo); hi = glm::max(hi, b.hi); }
+        float area() const
+        {
+            glm::vec3 d = hi - lo;
+            return d.x < 0 ? 0 : d.x * d.y + d.y * d.z + d.z * d.x;
+        }
+
+        glm::vec3 lo;
+        glm::vec3 hi;
+    };
+
+    // Binary tree over triangles, collapsed into the four wide one afterwards.
+    struct BinaryNode
+    {
+        Box bounds;
+        int left, right;            // -1 for leaves
+        unsigned int first, count;
+    };
+
+    struct Builder
+    {
+        const uint32_t* indices;
+        const glm::vec3* verts;
+        std::vector<Box> triBounds;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t> order;
+        std::vector<BinaryNode> nodes;
+
+        void prepare(unsigned int triCnt)
+        {
+            triBounds.resize(triCnt);
+            centroids.resize(triCnt);
+            order.resize(triCnt);
+            for (unsigned int t = 0; t < triCnt; ++t) {
+                for (unsigned int k = 0; k < 3; ++k)
+                    triBounds[t].grow(verts[indices[3 * t + k]]);
+                centroids[t] = (triBounds[t].lo + triBounds[t].hi) * 0.5f;
+                order[t] = t;
+            }
+        }
+
+        int split(unsigned int first, unsigned int count, unsigned int depth)
+        {
+            int index = (int)nodes.size();
+            nodes.push_back(BinaryNode());
+            BinaryNode node;
+            node.left = node.right = -1;
+            node.first = first;
+            node.count = count;
+            Box centers;
+            for (unsigned int i = first; i < first + count; ++i) {
+                node.bounds.grow(triBounds[order[i]]);
+                centers.grow(centroids[order[i]]);
+            }
+            nodes[index] = node;
+            // a leaf's triangles test about as fast as its node's four boxes
+            if (count <= TriangleBvh::MaxLeafSize)
+                return index;
+
+            glm::vec3 extent = centers.hi - centers.lo;
+            int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+            unsigned int mid = first + count / 2;
+            bool median = true;
+
+            if (extent[axis] > 0 && depth < MaxBuildDepth) {
+                Box bins[SahBins];
+                unsigned int binCnt[SahBins] = { 0 };
+                float scale = SahBins / extent[axis];
+                for (unsigned int i = first; i < first + count; ++i) {
+                    unsigned int b = std::min(SahBins - 1, (unsigned int)((centroids[order[i]][axis] - centers.lo[axis]) * scale));
+                    bins[b].grow(triBounds[order[i]]);
+                    ++binCnt[b];
+                }
+                // sweep from the right for the right side of every split, then from the left
+                float rightArea[SahBins];
+                unsigned int rightCnt[SahBins];
+                Box side;
+                unsigned int sideCnt = 0;
+                for (unsigned int b = SahBins - 1; b > 0; --b) {
+                    side.grow(bins[b]);
+                    sideCnt += binCnt[b];
+                    rightArea[b] = side.area();
+                    rightCnt[b] = sideCnt;
+                }
+                side = Box();
+                sideCnt = 0;
+                float bestCost = FLT_MAX;
+                unsigned int bestBin = 0;
+                for (unsigned int b = 1; b < SahBins; ++b) {
+                    side.grow(bins[b - 1]);
+                    sideCnt += binCnt[b - 1];
+                    if (sideCnt == 0 || rightCnt[b] == 0)
+                        continue;
+                    float cost = side.area() * sideCnt + rightArea[b] * rightCnt[b];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestBin = b;
+                    }
+                }
+                if (bestBin > 0) {
+                    float at = centers.lo[axis] + bestBin / scale;
+                    const std::vector<glm::vec3>& c = centroids;
+                    mid = (unsigned int)(std::partition(order.begin() + first, order.begin() + first + count,
+                        [&](uint32_t t) { return c[t][axis] < at; }) - order.begin());
+                    median = mid == first || mid == first + count;
+                    if (median)
+                        mid = first + count / 2;
+                }
+            }
+
+            if (median) {
+                const std::vector<glm::vec3>& c = centroids;
+                std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count,
+                    [&](uint32_t a, uint32_t b) { return c[a][axis] < c[b][axis]; });
+            }
+            int left = split(first, mid - first, depth + 1);
+            int right = split(mid, first + count - mid, depth + 1);
+            nodes[index].left = left;
+            nodes[index].right = right;
+            return index;
+        }
+    };
+
+    struct ArrayIn
+    {
+        const glm::vec3* v;
+        glm::vec3 get(uint32_t i) const { return v[i]; }
+    };
+
+    struct StreamIn
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+        glm::vec3 get(uint32_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+    };
+}
+
+// Takes binary nodes under binary node index (an inner one) into a four wide
+// node, by opening the largest inner child until there are four of them.
+template <typename NodeVector, typename Node>
+static int32_t collapse(const std::vector<BinaryNode>& binary, int index, NodeVector& nodes)
+{
+    int32_t at = (int32_t)nodes.size();
+    nodes.push_back(Node());
+    int slots[4] = { binary[index].left, binary[index].right, -1, -1 };
+    unsigned int used = 2;
+    while (used < 4) {
+        int open = -1;
+        float largest = -1;
+        for (unsigned int i = 0; i < used; ++i) {
+            const BinaryNode& n = binary[slots[i]];
+            if (n.left >= 0 && n.bounds.area() > largest) {
+                largest = n.bounds.area();
+                open = (int)i;
+            }
+        }
+        if (open < 0)
+            break;
+        int opened = slots[open];
+        slots[open] = binary[opened].left;
+        slots[used++] = binary[opened].right;
+    }
+
+    for (unsigned int i = 0; i < 4; ++i) {
+        int32_t child = ~0;
+        uint32_t count = 0;
+        if (i < used && binary[slots[i]].left >= 0) {
+            child = collapse<NodeVector, Node>(binary, slots[i], nodes);
+        }
+        else if (i < used) {
+            child = ~(int32_t)binary[slots[i]].first;
+            count = binary[slots[i]].count;
+        }
+        nodes[at].child[i] = child;
+        nodes[at].count[i] = count;
+    }
+    return at;
+}
+
+TriangleBvh::TriangleBvh()
+    : VertCnt(0)
+{
+}
+
+void TriangleBvh::build(const MeshBuffer& mesh)
+{
+    if (!mesh.UsesIndices || mesh.getIdxCnt() < 3) {
+        clear();
+        return;
+    }
+    build(mesh.getIndices().data(), mesh.getIdxCnt(), mesh.getVerts().data(), mesh.getVertCnt());
+}
+
+void TriangleBvh::build(const uint32_t* indices, unsigned int idxCnt, const glm::vec3* verts, unsigned int vertCnt)
+{
+    clear();
+    unsigned int triCnt = idxCnt / 3;
+    if (triCnt == 0)
+        return;
+
+    Builder builder;
+    builder.indices = indices;
+    builder.verts = verts;
+    builder.prepare(triCnt);
+    builder.split(0, triCnt, 0);
+
+    std::vector<BinaryNode>& binary = builder.nodes;
+    if (binary[0].left < 0) {
+        // few enough triangles for a single leaf, still wants a node around it
+        BinaryNode root = binary[0];
+        binary[0].left = 1;
+        binary[0].right = 2;
+        binary.push_back(root);
+        binary.push_back(root);
+        binary[2].count = 0;
+    }
+    collapse<std::vector<Node, AlignedAllocator<Node> >, Node>(binary, 0, Nodes);
+    Nodes.shrink_to_fit();
+
+    Triangles.swap(builder.order);
+    Indices.resize(3 * (size_t)triCnt);
+    for (unsigned int t = 0; t < triCnt; ++t)
+        for (unsigned int k = 0; k < 3; ++k)
+            Indices[3 * t + k] = indices[3 * Triangles[t] + k];
+    Corners.resize(Indices.size());
+    VertCnt = vertCnt;
+    refit(verts);
+}
+
+void TriangleBvh::clear()
+{
+    Nodes.clear();
+    Indices.clear();
+    Triangles.clear();
+    Corners.clear();
+    VertCnt = 0;
+}
+
+void TriangleBvh::refit(const glm::vec3* verts)
+{
+    ArrayIn in = { verts };
+    refitFrom(in);
+}
+
+void TriangleBvh::refit(const VertexStreams& verts)
+{
+    StreamIn in = { verts.x(), verts.y(), verts.z() };
+    refitFrom(in);
+}
+
+void TriangleBvh::refit(const MeshBuffer& mesh)
+{
+    if (mesh.getVertCnt() != VertCnt) {
+        cerr << "[!] TriangleBvh: refit with " << mesh.getVertCnt() << " vertices, built for " << VertCnt << endl;
+        return;
+    }
+    if (mesh.getVertexLayout() == MeshBuffer::StructOfArrays)
+        refit(mesh.getVertStreams());
+    else
+        refit(mesh.getVerts().data());
+}
+
+// One walk from the last node back, every leaf slot gathering its triangles'
+// corners on the way and every inner one taking in its node's four boxes.
+template <typename In>
+void TriangleBvh::refitFrom(const In& in)
+{
+    for (size_t n = Nodes.size(); n-- > 0;) {
+        Node& node = Nodes[n];
+        for (unsigned int i = 0; i < 4; ++i) {
+            float loX = FLT_MAX, loY = FLT_MAX, loZ = FLT_MAX;
+            float hiX = -FLT_MAX, hiY = -FLT_MAX, hiZ = -FLT_MAX;
+            if (node.child[i] >= 0) {
+                const Node& child = Nodes[node.child[i]];
+                for (unsigned int j = 0; j < 4; ++j) {
+                    loX = std::min(loX, child.minX[j]);
+                    loY = std::min(loY, child.minY[j]);
+                    loZ = std::min(loZ, child.minZ[j]);
+                    hiX = std::max(hiX, child.maxX[j]);
+                    hiY = std::max(hiY, child.maxY[j]);
+                    hiZ = std::max(hiZ, child.maxZ[j]);
+                }
+            }
+            else {
+                size_t first = 3 * (size_t)~node.child[i];
+                size_t last = first + 3 * node.count[i];
+                for (size_t c = first; c < last; c += 3) {
+                    glm::vec3 a = in.get(Indices[c]);
+                    glm::vec3 b = in.get(Indices[c + 1]);
+                    glm::vec3 d = in.get(Indices[c + 2]);
+                    Corners[c] = a;
+                    Corners[c + 1] = b;
+                    Corners[c + 2] = d;
+                    loX = std::min(loX, std::min(a.x, std::min(b.x, d.x)));
+                    loY = std::min(loY, std::min(a.y, std::min(b.y, d.y)));
+                    loZ = std::min(loZ, std::min(a.z, std::min(b.z, d.z)));
+                    hiX = std::max(hiX, std::max(a.x, std::max(b.x, d.x)));
+                    hiY = std::max(hiY, std::max(a.y, std::max(b.y, d.y)));
+                    hiZ = std::max(hiZ, std::max(a.z, std::max(b.z, d.z)));
+                }
+            }
+            node.minX[i] = loX;
+            node.minY[i] = loY;
+            node.minZ[i] = loZ;
+            node.maxX[i] = hiX;
+            node.maxY[i] = hiY;
+            node.maxZ[i] = hiZ;
+        }
+    }
+}
+
+bool TriangleBvh::intersect(const glm::vec3& origin, const glm::vec3& direction, float maxT, Hit& hit) const
+{
+    return traverse<false>(origin, direction, maxT, hit);
+}
+
+bool TriangleBvh::intersectSegment(const glm::vec3& from, const glm::vec3& to, Hit& hit) const
+{
+    return traverse<false>(from, to - from, 1, hit);
+}
+
+bool TriangleBvh::occluded(const glm::vec3& from, const glm::vec3& to) const
+{
+    Hit hit;
+    return traverse<true>(from, to - from, 1, hit);
+}
+
+template <bool AnyHit>
+bool TriangleBvh::traverse(const glm::vec3& origin, const glm::vec3& direction, float maxT, Hit& hit) const
+{
+    if (Nodes.empty())
+        return false;
+
+    // a zero component would make 0 * inf of a box face lying on the origin
+    glm::vec3 inv;
+    for (int a = 0; a < 3; ++a) {
+        float d = direction[a];
+        if (std::fabs(d) < 1e-20f)
+            d = d < 0 ? -1e-20f : 1e-20f;
+        inv[a] = 1 / d;
+    }
+    // slabs are entered through the min side when going up the axis, the max
+    // side otherwise, which also keeps inside out boxes from ever being hit
+    bool flipX = inv.x < 0, flipY = inv.y < 0, flipZ = inv.z < 0;
+    glm::vec3 scaledOrigin = origin * inv;
+
+    struct Entry { int32_t node; float tNear; };
+    Entry stack[StackSize];
+    unsigned int sp = 0;
+    stack[sp].node = 0;
+    stack[sp++].tNear = 0;
+
+    float best = maxT;
+    bool found = false;
+    while (sp > 0) {
+        Entry entry = stack[--sp];
+        if (entry.tNear > best)
+            continue;
+        const Node& node = Nodes[entry.node];
+
+        const float* nearX = flipX ? node.maxX : node.minX;
+        const float* farX = flipX ? node.minX : node.maxX;
+        const float* nearY = flipY ? node.maxY : node.minY;
+        const float* farY = flipY ? node.minY : node.maxY;
+        const float* nearZ = flipZ ? node.maxZ : node.minZ;
+        const float* farZ = flipZ ? node.minZ : node.maxZ;
+        float tNear[4], tFar[4];
+        for (unsigned int i = 0; i < 4; ++i) {
+            float x0 = nearX[i] * inv.x - scaledOrigin.x;
+            float y0 = nearY[i] * inv.y - scaledOrigin.y;
+            float z0 = nearZ[i] * inv.z - scaledOrigin.z;
+            float x1 = farX[i] * inv.x - scaledOrigin.x;
+            float y1 = farY[i] * inv.y - scaledOrigin.y;
+            float z1 = farZ[i] * inv.z - scaledOrigin.z;
+            tNear[i] = std::max(std::max(x0, y0), std::max(z0, 0.0f));
+            tFar[i] = std::min(std::min(x1, y1), std::min(z1, best));
+        }
+
+        // leaves right away, inner nodes onto the stack furthest first
+        Entry pushed[4];
+        unsigned int pushCnt = 0;
+        for (unsigned int i = 0; i < 4; ++i) {
+            if (tNear[i] > tFar[i] || tNear[i] > best)
+                continue;
+            if (node.child[i] >= 0) {
+                Entry e = { node.child[i], tNear[i] };
+                unsigned int j = pushCnt++;
+                for (; j > 0 && pushed[j - 1].tNear < e.tNear; --j)
+                    pushed[j] = pushed[j - 1];
+                pushed[j] = e;
+                continue;
+            }
+            uint32_t first = ~node.child[i];
+            for (uint32_t t = first; t < first + node.count[i]; ++t) {
+                const glm::vec3* c = &Corners[3 * (size_t)t];
+                glm::vec3 e1 = c[1] - c[0];
+                glm::vec3 e2 = c[2] - c[0];
+                glm::vec3 p = glm::cross(direction, e2);
+                float det = glm::dot(e1, p);
+                if (det == 0)
+                    continue;
+                float invDet = 1 / det;
+                glm::vec3 s = origin - c[0];
+                float u = glm::dot(s, p) * invDet;
+                if (u < 0 || u > 1)
+                    continue;
+                glm::vec3 q = glm::cross(s, e1);
+                float v = glm::dot(direction, q) * invDet;
+                if (v < 0 || u + v > 1)
+                    continue;
+                float at = glm::dot(e2, q) * invDet;
+                if (at < 0 || at > best)
+                    continue;
+                best = at;
+                found = true;
+                hit.t = at;
+                hit.triangle = Triangles[t];
+                hit.u = u;
+                hit.v = v;
+                if (AnyHit)
+                    return true;
+            }
+        }
+        for (unsigned int i = 0; i < pushCnt; ++i)
+            stack[sp++] = pushed[i];
+    }
+    return found;
+}
+
+unsigned int TriangleBvh::getTriangleCnt() const
+{
+    return (unsigned int)Triangles.size();
+}
+
+unsigned int TriangleBvh::getNodeCnt() const
+{
+    return (unsigned int)Nodes.size();
+}
+
+size_t TriangleBvh::getMemoryUsage() const
+{
+    return Nodes.capacity() * sizeof(Node) + Indices.capacity() * sizeof(uint32_t)
+        + Triangles.capacity() * sizeof(uint32_t) + Corners.capacity() * sizeof(glm::vec3);
+}
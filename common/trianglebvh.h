@@ -0,0 +1,88 @@
+#ifndef TRIANGLE_BVH_H_
+#define TRIANGLE_BVH_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "alignedallocator.h"
+#include "vertexstreams.h"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    /**
+    *   Bounding volume hierarchy over a mesh's triangles, for ray and
+    *   segment queries (picking, measuring) on meshes that animate.
+    *
+    *   The tree is built once per topology, splitting by surface area, and
+    *   stored four children to a node with their boxes as x/y/z min/max
+    *   arrays, so each node's four box tests run as one vector loop.
+    *   When the positions change refit() copies every triangle's corners
+    *   out in leaf order and grows the boxes to them from the leaves up,
+    *   the tree's shape stays as built. Queries only read that copy, the
+    *   mesh can change again right after a refit.
+    *
+    *   A refit tree answers correctly for any positions, it only gets slower
+    *   as they wander from the ones it was built for.
+    */
+    class TriangleBvh
+    {
+    public:
+        struct Hit
+        {
+            float t;                // along the query, in lengths of its direction
+            uint32_t triangle;      // index of the face in the mesh
+            float u;                // weights of the face's second and third corners
+            float v;
+        };
+
+        TriangleBvh();
+
+        // Sets the topology up and refits to the mesh's current positions.
+        void build(const MeshBuffer& mesh);
+        void build(const uint32_t* indices, unsigned int idxCnt, const glm::vec3* verts, unsigned int vertCnt);
+        void clear();
+
+        void refit(const glm::vec3* verts);
+        void refit(const VertexStreams& verts);
+        void refit(const MeshBuffer& mesh);
+
+        // Nearest face along origin + t * direction for t in [0, maxT], either side of it.
+        bool intersect(const glm::vec3& origin, const glm::vec3& direction, float maxT, Hit& hit) const;
+        // Nearest face between from and to, t goes from 0 at from to 1 at to.
+        bool intersectSegment(const glm::vec3& from, const glm::vec3& to, Hit& hit) const;
+        // Whether anything lies between from and to, stops at the first face found.
+        bool occluded(const glm::vec3& from, const glm::vec3& to) const;
+
+        unsigned int getTriangleCnt() const;
+        unsigned int getNodeCnt() const;
+        size_t getMemoryUsage() const;
+
+        static const unsigned int MaxLeafSize = 4;
+
+    private:
+        // Children always come after their parent, refits walk the nodes backwards.
+        struct Node
+        {
+            float minX[4], minY[4], minZ[4];
+            float maxX[4], maxY[4], maxZ[4];
+            // >= 0 an inner node, otherwise ~first of count triangles, an
+            // unused slot being an empty leaf whose box is inside out
+            int32_t child[4];
+            uint32_t count[4];
+        };
+
+        template <typename In> void refitFrom(const In& in);
+        template <bool AnyHit> bool traverse(const glm::vec3& origin, const glm::vec3& direction, float maxT, Hit& hit) const;
+
+        std::vector<Node, AlignedAllocator<Node> > Nodes;
+        std::vector<uint32_t> Indices;          // mesh indices of every triangle, in leaf order
+        std::vector<uint32_t> Triangles;        // mesh face of every triangle, in leaf order
+        std::vector<glm::vec3> Corners;         // three per triangle, in leaf order, from the last refit
+        unsigned int VertCnt;
+    };
+}
+
+#endif // TRIANGLE_BVH_H_
@@ -0,0 +1,99 @@
+#ifndef UNIQUE_TABLE_H_
+#define UNIQUE_TABLE_H_
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace ogle
+{
+    // Mixes three 32 bit words into a hash, what the keys below are made of.
+    inline size_t hashWords(uint32_t a, uint32_t b, uint32_t c)
+    {
+        uint32_t h = a * 0x9E3779B1u;
+        h ^= b * 0x85EBCA77u;
+        h ^= c * 0xC2B2AE3Du;
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        return h;
+    }
+
+    /**
+    *   Open addressing table (linear probing) handing every distinct key an
+    *   index, in the order keys are first seen. The keys are kept in that
+    *   order so building arrays from them is a linear walk.
+    *
+    *   Traits has static size_t hash(const Key&) and bool equal(const Key&, const Key&).
+    */
+    template <typename Key, typename Traits>
+    class UniqueTable
+    {
+    public:
+        explicit UniqueTable(size_t expectedCount)
+        {
+            size_t capacity = 16;
+            while (capacity < expectedCount * 2)
+                capacity <<= 1;
+            Slots.resize(capacity);
+            Mask = capacity - 1;
+            Keys.reserve(expectedCount);
+        }
+
+        // The index of key, a new key gets the next one.
+        uint32_t insert(const Key& key)
+        {
+            size_t i = Traits::hash(key) & Mask;
+            while (true) {
+                Slot& slot = Slots[i];
+                if (slot.index == Empty) {
+                    slot.key = key;
+                    slot.index = (uint32_t)Keys.size();
+                    Keys.push_back(key);
+                    if (Keys.size() * 4 > Slots.size() * 3)
+                        grow();
+                    return (uint32_t)Keys.size() - 1;
+                }
+                if (Traits::equal(slot.key, key))
+                    return slot.index;
+                i = (i + 1) & Mask;
+            }
+        }
+
+        const std::vector<Key>& keys() const
+        {
+            return Keys;
+        }
+
+    private:
+        static const uint32_t Empty = 0xffffffff;
+
+        struct Slot
+        {
+            Slot() : index(Empty) {}
+            Key key;
+            uint32_t index;
+        };
+
+        void grow()
+        {
+            std::vector<Slot> old;
+            old.swap(Slots);
+            Slots.resize(old.size() * 2);
+            Mask = Slots.size() - 1;
+            for (size_t s = 0; s < old.size(); ++s) {
+                if (old[s].index == Empty) continue;
+                size_t i = Traits::hash(old[s].key) & Mask;
+                while (Slots[i].index != Empty)
+                    i = (i + 1) & Mask;
+                Slots[i] = old[s];
+            }
+        }
+
+        std::vector<Slot> Slots;
+        size_t Mask;
+        std::vector<Key> Keys;
+    };
+}
+
+#endif // UNIQUE_TABLE_H_
@@ -0,0 +1,208 @@
+#include "vertexstreams.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace ogle;
+
+// Lets the compiler use aligned vector loads without checking first.
+#if defined(__GNUC__) || defined(__clang__)
+#define ASSUME_ALIGNED(p) ((__typeof__(p))__builtin_assume_aligned((p), SimdAlignment))
+#else
+#define ASSUME_ALIGNED(p) (p)
+#endif
+
+VertexStreams::VertexStreams()
+    : Count(0)
+    , Padded(0)
+{
+}
+
+unsigned int VertexStreams::padCount(unsigned int count)
+{
+    return (unsigned int)((count + SimdWidth - 1) / SimdWidth * SimdWidth);
+}
+
+void VertexStreams::resize(unsigned int count)
+{
+    unsigned int padded = padCount(count);
+    if (padded != Padded) {
+        AlignedFloats resized(3 * (size_t)padded);
+        unsigned int keep = std::min(count, Count);
+        for (size_t s = 0; s < 3 && keep; ++s)
+            memcpy(&resized[s * padded], &Data[s * Padded], keep * sizeof(float));
+        Data.swap(resized);
+        Padded = padded;
+    }
+    Count = count;
+}
+
+void VertexStreams::clear()
+{
+    Count = 0;
+    Padded = 0;
+    AlignedFloats().swap(Data);
+}
+
+unsigned int VertexStreams::size() const
+{
+    return Count;
+}
+
+unsigned int VertexStreams::paddedSize() const
+{
+    return Padded;
+}
+
+glm::vec3 VertexStreams::get(unsigned int i) const
+{
+    return glm::vec3(x()[i], y()[i], z()[i]);
+}
+
+void VertexStreams::set(unsigned int i, const glm::vec3& value)
+{
+    x()[i] = value.x;
+    y()[i] = value.y;
+    z()[i] = value.z;
+}
+
+void VertexStreams::assign(const glm::vec3* values, unsigned int count)
+{
+    resize(count);
+    float* xs = x();
+    float* ys = y();
+    float* zs = z();
+    for (unsigned int i = 0; i < count; ++i) {
+        xs[i] = values[i].x;
+        ys[i] = values[i].y;
+        zs[i] = values[i].z;
+    }
+}
+
+void VertexStreams::copyTo(glm::vec3* values) const
+{
+    const float* xs = x();
+    const float* ys = y();
+    const float* zs = z();
+    for (unsigned int i = 0; i < Count; ++i)
+        values[i] = glm::vec3(xs[i], ys[i], zs[i]);
+}
+
+size_t VertexStreams::getMemoryUsage() const
+{
+    return Data.capacity() * sizeof(float);
+}
+
+void ogle::lerpStreams(const float* a, const float* b, float tween, float* out, size_t count)
+{
+    const float* __restrict va = ASSUME_ALIGNED(a);
+    const float* __restrict vb = ASSUME_ALIGNED(b);
+    float* __restrict vo = ASSUME_ALIGNED(out);
+    // same expression as the array of structs blend, so both give the same bits
+    for (size_t i = 0; i < count; ++i)
+        vo[i] = tween * (vb[i] - va[i]) + va[i];
+}
+
+void ogle::normalizeStreams(VertexStreams& vectors)
+{
+    float* __restrict xs = ASSUME_ALIGNED(vectors.x());
+    float* __restrict ys = ASSUME_ALIGNED(vectors.y());
+    float* __restrict zs = ASSUME_ALIGNED(vectors.z());
+    // whole vectors, the padding gets normalized along with the rest
+    for (unsigned int i = 0; i < vectors.paddedSize(); ++i) {
+        float lengthSq = xs[i] * xs[i] + ys[i] * ys[i] + zs[i] * zs[i];
+        float scale = lengthSq > 0 ? 1.0f / std::sqrt(lengthSq) : 0.0f;
+        xs[i] *= scale;
+        ys[i] *= scale;
+        zs[i] *= scale;
+    }
+}
+
+// One lane per vector element, so the loop vectorizes without needing the
+// compiler to reorder a min/max reduction.
+static void streamRange(const float* values, unsigned int count, float& lo, float& hi)
+{
+    const float* __restrict v = ASSUME_ALIGNED(values);
+    float lanesLo[SimdWidth];
+    float lanesHi[SimdWidth];
+    for (size_t k = 0; k < SimdWidth; ++k) {
+        lanesLo[k] = lo;
+        lanesHi[k] = hi;
+    }
+
+    unsigned int whole = count - count % SimdWidth;
+    for (unsigned int i = 0; i < whole; i += SimdWidth) {
+        for (size_t k = 0; k < SimdWidth; ++k) {
+            float value = v[i + k];
+            lanesLo[k] = value < lanesLo[k] ? value : lanesLo[k];
+            lanesHi[k] = value > lanesHi[k] ? value : lanesHi[k];
+        }
+    }
+    // the padding is left out, it holds whatever the last kernel wrote
+    for (unsigned int i = whole; i < count; ++i) {
+        lanesLo[0] = v[i] < lanesLo[0] ? v[i] : lanesLo[0];
+        lanesHi[0] = v[i] > lanesHi[0] ? v[i] : lanesHi[0];
+    }
+
+    for (size_t k = 0; k < SimdWidth; ++k) {
+        lo = std::min(lo, lanesLo[k]);
+        hi = std::max(hi, lanesHi[k]);
+    }
+}
+
+void ogle::streamBounds(const VertexStreams& verts, glm::vec3& lo, glm::vec3& hi)
+{
+    streamRange(verts.x(), verts.size(), lo.x, hi.x);
+    streamRange(verts.y(), verts.size(), lo.y, hi.y);
+    streamRange(verts.z(), verts.size(), lo.z, hi.z);
+}
+
+void ogle::streamFaceNormals(const VertexStreams& verts, const uint32_t* indices, unsigned int idxCnt, VertexStreams& norms)
+{
+    norms.resize(verts.size());
+    memset(norms.data(), 0, 3 * (size_t)norms.paddedSize() * sizeof(float));
+
+    // Indexed gathers and scatters, so this one doesn't get wider with the
+    // streams. Keeping it on them saves converting to and from vec3s.
+    const float* vx = verts.x();
+    const float* vy = verts.y();
+    const float* vz = verts.z();
+    float* nx = norms.x();
+    float* ny = norms.y();
+    float* nz = norms.z();
+    for (unsigned int i = 0; i + 2 < idxCnt; i += 3) {
+        uint32_t a = indices[i + 0];
+        uint32_t b = indices[i + 1];
+        uint32_t c = indices[i + 2];
+
+        float abx = vx[b] - vx[a], aby = vy[b] - vy[a], abz = vz[b] - vz[a];
+        float acx = vx[c] - vx[a], acy = vy[c] - vy[a], acz = vz[c] - vz[a];
+
+        // glm::normalize(glm::cross(ab, ac)) spelled out
+        float x = aby * acz - acy * abz;
+        float y = abz * acx - acz * abx;
+        float z = abx * acy - acx * aby;
+        float scale = 1.0f / std::sqrt(x * x + y * y + z * z);
+        x *= scale;
+        y *= scale;
+        z *= scale;
+
+        nx[a] = x; ny[a] = y; nz[a] = z;
+        nx[b] = x; ny[b] = y; nz[b] = z;
+        nx[c] = x; ny[c] = y; nz[c] = z;
+    }
+}
+
+void ogle::interleaveStreams(const VertexStreams& streams, float* dest, unsigned int stride, unsigned int offset)
+{
+    const float* xs = streams.x();
+    const float* ys = streams.y();
+    const float* zs = streams.z();
+    float* out = dest + offset;
+    for (unsigned int i = 0; i < streams.size(); ++i, out += stride) {
+        out[0] = xs[i];
+        out[1] = ys[i];
+        out[2] = zs[i];
+    }
+}
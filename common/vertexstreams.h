@@ -0,0 +1,83 @@
+#ifndef VERTEX_STREAMS_H_
+#define VERTEX_STREAMS_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+#include "alignedallocator.h"
+
+namespace ogle
+{
+    typedef std::vector<float, AlignedAllocator<float> > AlignedFloats;
+
+    /**
+    *   vec3 attributes stored structure of arrays: every x, then every y,
+    *   then every z, in one allocation.
+    *
+    *   Each stream starts on a SimdAlignment boundary and is padded out to a
+    *   multiple of SimdWidth floats, so per-vertex kernels run whole vectors
+    *   with aligned loads and no scalar tail. What sits in the padding is
+    *   unspecified, kernels may write it and nothing should read it.
+    */
+    class VertexStreams
+    {
+    public:
+        VertexStreams();
+
+        // Keeps the first min(count, size()) values.
+        void resize(unsigned int count);
+        // Drops the values and the storage.
+        void clear();
+
+        unsigned int size() const;
+        // Floats in each stream, count rounded up to a multiple of SimdWidth.
+        unsigned int paddedSize() const;
+        static unsigned int padCount(unsigned int count);
+
+        float* x() { return Data.data(); }
+        float* y() { return Data.data() + Padded; }
+        float* z() { return Data.data() + 2 * (size_t)Padded; }
+        const float* x() const { return Data.data(); }
+        const float* y() const { return Data.data() + Padded; }
+        const float* z() const { return Data.data() + 2 * (size_t)Padded; }
+
+        // The three streams back to back, 3 * paddedSize() floats.
+        float* data() { return Data.data(); }
+        const float* data() const { return Data.data(); }
+
+        glm::vec3 get(unsigned int i) const;
+        void set(unsigned int i, const glm::vec3& value);
+
+        // Conversions from and to array of structs.
+        void assign(const glm::vec3* values, unsigned int count);
+        void copyTo(glm::vec3* values) const;
+
+        size_t getMemoryUsage() const;
+
+    private:
+        unsigned int Count;
+        unsigned int Padded;
+        AlignedFloats Data;
+    };
+
+    // out = a + tween * (b - a) over count floats. Every pointer is SimdAlignment
+    // aligned and count a multiple of SimdWidth, as VertexStreams guarantees.
+    void lerpStreams(const float* a, const float* b, float tween, float* out, size_t count);
+
+    // Scales every vector to unit length, zero length ones stay zero.
+    void normalizeStreams(VertexStreams& vectors);
+
+    // Grows lo/hi to take in every vertex.
+    void streamBounds(const VertexStreams& verts, glm::vec3& lo, glm::vec3& hi);
+
+    // Same as MeshBuffer::generateFaceNormals, each vertex gets the normal of
+    // the last triangle that uses it.
+    void streamFaceNormals(const VertexStreams& verts, const uint32_t* indices, unsigned int idxCnt, VertexStreams& norms);
+
+    // Writes the streams into an interleaved vertex array at offset floats
+    // into each stride float vertex.
+    void interleaveStreams(const VertexStreams& streams, float* dest, unsigned int stride, unsigned int offset);
+}
+
+#endif // VERTEX_STREAMS_H_
@@ -0,0 +1,214 @@
+#include "vertexwelder.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "meshbuffer.h"
+
+using namespace ogle;
+
+namespace
+{
+    const uint32_t NoVertex = ~0u;
+
+    struct Cell
+    {
+        int64_t x, y, z;
+    };
+
+    inline uint32_t hashCell(int64_t x, int64_t y, int64_t z, uint32_t mask)
+    {
+        uint64_t h = (uint64_t)x * 73856093u ^ (uint64_t)y * 19349663u ^ (uint64_t)z * 83492791u;
+        return (uint32_t)(h ^ (h >> 32)) & mask;
+    }
+}
+
+VertexWelder::VertexWelder()
+    : VertCnt(0)
+{
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+void VertexWelder::build(const MeshBuffer& mesh, float tolerance)
+{
+    const glm::vec2* uvs = mesh.UsesUVs && mesh.getTexCoords(0).size() == mesh.getVertCnt() ? mesh.getTexCoords(0).data() : 0;
+    build(mesh.getVerts().data(), uvs, mesh.getVertCnt(), mesh.getIndices().data(), mesh.getIdxCnt(), tolerance);
+}
+
+void VertexWelder::build(const glm::vec3* verts, const glm::vec2* uvs, unsigned int vertCnt,
+    const uint32_t* indices, unsigned int idxCnt, float tolerance)
+{
+    clear();
+    idxCnt -= idxCnt % 3;
+    VertCnt = vertCnt;
+    SourceIndices.assign(indices, indices + idxCnt);
+    Remap.resize(vertCnt);
+
+    // with no tolerance only exact copies merge, the cells just need to be
+    // big enough that the grid coordinates stay well inside an int64
+    glm::vec3 lo(0), hi(0);
+    if (vertCnt) {
+        lo = hi = verts[0];
+        for (unsigned int v = 1; v < vertCnt; ++v) {
+            lo = glm::min(lo, verts[v]);
+            hi = glm::max(hi, verts[v]);
+        }
+    }
+    float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+    double cell = tolerance > 0 ? tolerance : std::max(extent / 1024.0f, 1e-6f);
+    float toleranceSq = tolerance > 0 ? tolerance * tolerance : 0;
+
+    uint32_t tableSize = 1;
+    while (tableSize < 2 * vertCnt)
+        tableSize <<= 1;
+    std::vector<uint32_t> heads(tableSize, NoVertex);
+    std::vector<uint32_t> next;             // per kept vertex, the next one in its bucket
+    next.reserve(vertCnt);
+    Kept.reserve(vertCnt);
+
+    for (unsigned int v = 0; v < vertCnt; ++v) {
+        const glm::vec3& p = verts[v];
+        Cell c = { (int64_t)std::floor(p.x / cell), (int64_t)std::floor(p.y / cell), (int64_t)std::floor(p.z / cell) };
+
+        // anything within one cell size is in this cell or one next to it
+        uint32_t found = NoVertex;
+        for (int dz = -1; dz <= 1 && found == NoVertex; ++dz) {
+            for (int dy = -1; dy <= 1 && found == NoVertex; ++dy) {
+                for (int dx = -1; dx <= 1 && found == NoVertex; ++dx) {
+                    uint32_t k = heads[hashCell(c.x + dx, c.y + dy, c.z + dz, tableSize - 1)];
+                    for (; k != NoVertex; k = next[k]) {
+                        uint32_t other = Kept[k];
+                        glm::vec3 d = verts[other] - p;
+                        if (glm::dot(d, d) > toleranceSq)
+                            continue;
+                        if (uvs && uvs[other] != uvs[v])
+                            continue;
+                        found = k;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (found != NoVertex) {
+            Remap[v] = found;
+            continue;
+        }
+        uint32_t k = (uint32_t)Kept.size();
+        uint32_t& head = heads[hashCell(c.x, c.y, c.z, tableSize - 1)];
+        Kept.push_back(v);
+        next.push_back(head);
+        head = k;
+        Remap[v] = k;
+    }
+
+    Indices.reserve(idxCnt);
+    KeptBefore.resize(idxCnt / 3 + 1);
+    for (unsigned int i = 0; i < idxCnt; i += 3) {
+        KeptBefore[i / 3] = (uint32_t)Indices.size() / 3;
+        uint32_t a = Remap[indices[i]], b = Remap[indices[i + 1]], c = Remap[indices[i + 2]];
+        if (a == b || b == c || c == a)
+            continue;
+        Indices.push_back(a);
+        Indices.push_back(b);
+        Indices.push_back(c);
+    }
+    KeptBefore[idxCnt / 3] = (uint32_t)Indices.size() / 3;
+
+    Stats.vertsBefore = vertCnt;
+    Stats.vertsAfter = (unsigned int)Kept.size();
+    Stats.trianglesBefore = idxCnt / 3;
+    Stats.trianglesAfter = (unsigned int)Indices.size() / 3;
+}
+
+void VertexWelder::clear()
+{
+    VertCnt = 0;
+    SourceIndices.clear();
+    Indices.clear();
+    KeptBefore.clear();
+    Remap.clear();
+    Kept.clear();
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+template <typename T>
+static void gather(const std::vector<T>& values, const std::vector<uint32_t>& kept, std::vector<T>& out)
+{
+    out.resize(kept.size());
+    for (size_t v = 0; v < kept.size(); ++v)
+        out[v] = values[kept[v]];
+}
+
+bool VertexWelder::apply(MeshBuffer& mesh, float* drift) const
+{
+    const std::vector<uint32_t>& indices = mesh.getIndices();
+    if (mesh.getVertCnt() != VertCnt || indices.size() != SourceIndices.size())
+        return false;
+    if (!indices.empty() && memcmp(indices.data(), SourceIndices.data(), indices.size() * sizeof(uint32_t)) != 0)
+        return false;
+
+    const std::vector<glm::vec3>& source = mesh.getVerts();
+    if (drift) {
+        float furthest = 0;
+        for (unsigned int v = 0; v < VertCnt; ++v)
+            furthest = std::max(furthest, glm::length(source[v] - source[Kept[Remap[v]]]));
+        *drift = furthest;
+    }
+
+    unsigned int weldedCnt = (unsigned int)Kept.size();
+    std::vector<glm::vec3> verts;
+    gather(source, Kept, verts);
+    mesh.setVerts(std::move(verts));
+
+    if (mesh.UsesNormals && mesh.getNorms().size() == VertCnt) {
+        std::vector<glm::vec3> norms;
+        gather(mesh.getNorms(), Kept, norms);
+        mesh.setNorms(weldedCnt, (const float*)norms.data());
+    }
+
+    if (mesh.UsesUVs && mesh.getTexCoords(0).size() == VertCnt) {
+        std::vector<glm::vec2> coords;
+        gather(mesh.getTexCoords(0), Kept, coords);
+        mesh.setTexCoords(0, weldedCnt, (const float*)coords.data());
+    }
+
+    for (unsigned int i = 0; i < (unsigned int)mesh.UsesGenerics.size(); ++i) {
+        if (!mesh.UsesGenerics[i])
+            continue;
+        std::vector<glm::vec4> values;
+        gather(mesh.getGenerics(i), Kept, values);
+        mesh.setGenerics(i, values);
+    }
+
+    // dropped triangles pull the ranges after them down
+    if (validSubMeshes(mesh.getSubMeshes(), (unsigned int)SourceIndices.size()))
+        mesh.setSubMeshes(shrinkSubMeshes(mesh.getSubMeshes(), KeptBefore));
+    else
+        mesh.setSubMeshes(SubMeshList());
+
+    std::vector<uint32_t> welded(Indices);
+    mesh.setIndices(std::move(welded));
+    return true;
+}
+
+unsigned int VertexWelder::getVertCnt() const
+{
+    return (unsigned int)Kept.size();
+}
+
+const std::vector<uint32_t>& VertexWelder::getIndices() const
+{
+    return Indices;
+}
+
+const std::vector<uint32_t>& VertexWelder::getRemap() const
+{
+    return Remap;
+}
+
+const VertexWelder::Report& VertexWelder::getReport() const
+{
+    return Stats;
+}
@@ -0,0 +1,72 @@
+#ifndef VERTEX_WELDER_H_
+#define VERTEX_WELDER_H_
+
+#include <vector>
+#include <stdint.h>
+#include "glm/glm.hpp"
+
+class MeshBuffer;
+
+namespace ogle
+{
+    /**
+    *   Merges vertices whose positions lie within a tolerance of each other,
+    *   the copies exporters leave along texture and normal seams.
+    *
+    *   Positions go into a uniform grid of tolerance sized cells, hashed,
+    *   and every vertex merges into the first earlier kept vertex within
+    *   tolerance in its own or a neighbouring cell. Merging never chains,
+    *   a vertex is only ever compared against kept ones. Vertices with
+    *   texture coordinates only merge when those are the same too. Triangles
+    *   left with two corners on one vertex are dropped, the rest keep their
+    *   order and the mesh's sub-meshes shrink around the dropped ones.
+    *
+    *   Like MeshOptimizer the merge is worked out once from one topology and
+    *   applied to every mesh sharing it, so all keyframes of a sequence
+    *   come out with the same vertices and indices.
+    */
+    class VertexWelder
+    {
+    public:
+        struct Report
+        {
+            unsigned int vertsBefore;
+            unsigned int vertsAfter;
+            unsigned int trianglesBefore;
+            unsigned int trianglesAfter;
+        };
+
+        VertexWelder();
+
+        void build(const MeshBuffer& mesh, float tolerance);
+        // uvs is optional, one per vertex
+        void build(const glm::vec3* verts, const glm::vec2* uvs, unsigned int vertCnt,
+            const uint32_t* indices, unsigned int idxCnt, float tolerance);
+        void clear();
+
+        // Merges mesh's vertices (positions, normals, uvs, generics) the built
+        // way, each keeping what its kept vertex has. Returns false, leaving
+        // mesh alone, if its indices aren't the ones built from. drift gets the
+        // furthest any vertex of this mesh is from the one it merged into,
+        // more than the tolerance means the merge doesn't hold for this mesh.
+        bool apply(MeshBuffer& mesh, float* drift = 0) const;
+
+        unsigned int getVertCnt() const;
+        // triangles in the merged numbering
+        const std::vector<uint32_t>& getIndices() const;
+        // merged number of every old vertex
+        const std::vector<uint32_t>& getRemap() const;
+        const Report& getReport() const;
+
+    private:
+        unsigned int VertCnt;
+        std::vector<uint32_t> SourceIndices;
+        std::vector<uint32_t> Indices;
+        std::vector<uint32_t> KeptBefore;  // triangles kept ahead of every old one, for the sub-meshes
+        std::vector<uint32_t> Remap;
+        std::vector<uint32_t> Kept;        // old number of every merged vertex
+        Report Stats;
+    };
+}
+
+#endif // VERTEX_WELDER_H_
@@ -2,6 +2,8 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <chrono>
+#include <cctype>
 
 #include <glad/glad.h>
 
@@ -19,7 +21,20 @@
 #include "common/objloader.h"
 #include "common/meshbuffer.h"
 #include "common/meshobject.h"
+#include "common/meshsequence.h"
+#include "common/quantizedsequence.h"
+#include "common/keyframestore.h"
 #include "common/renderable.h"
+#include "common/threadpool.h"
+#include "common/framearena.h"
+#include "common/normalengine.h"
+#include "common/keyframenormals.h"
+#include "common/meshoptimizer.h"
+#include "common/meshlets.h"
+#include "common/lodchain.h"
+#include "common/trianglebvh.h"
+#include "common/planeslicer.h"
+#include "common/vertexwelder.h"
 
 using namespace std;
 using namespace ogle;
@@ -35,6 +50,7 @@ glm::mat4 SceneBase;
 
 glm::mat4 Projection;
 glm::mat4 ProjectionView;
+float FieldOfViewY;
 glm::mat3 NormalMatrix;
 
 glm::vec4 MoveToOrigin;
@@ -84,15 +100,110 @@ ProgramObject FrustumClipShader;	// the frustum clips against the rest of the an
 ProgramObject CavityClipShader;		// interior models clip against the frustum
 
 const int AnatomyFrameCount = 22;
-MeshBuffer AnimatedAnatomyFrames[AnatomyFrameCount];
+ogle::MeshSequence AnimatedAnatomyFrames;
 MeshBuffer AnimatedAnatomy;
 float AnimatedAnatomyCurrent = 0;
 float AnimatedAnatomyDuration = 1;
 
 const int FrustumFrameCount = 2;
-MeshBuffer AnimatedFrustumFrames[FrustumFrameCount];
+ogle::MeshSequence AnimatedFrustumFrames;
 MeshBuffer AnimatedFrustum;
 
+// --keyframe-error <distance> swaps the float keyframes for quantized ones
+float KeyframeErrorBound = 0;
+ogle::QuantizedSequence QuantizedAnatomyFrames;
+ogle::QuantizedSequence QuantizedFrustumFrames;
+
+// --keyframe-budget <MB> pages the anatomy keyframes in from a pack file instead of keeping them all resident
+size_t KeyframeBudget = 0;
+ogle::KeyframeStore PagedAnatomyFrames;
+std::future<bool> AnatomyPackBuild;
+
+// normals for the animated meshes, the adjacency is built once from the first frame.
+// --smooth-normals shades the anatomy with area weighted vertex normals instead of face normals
+ogle::NormalEngine AnatomyNormals;
+ogle::NormalEngine FrustumNormals;
+// every keyframe's normals, worked out once and blended alongside the positions.
+// Paged keyframes have none and get their normals worked out every frame instead
+ogle::KeyframeNormals AnatomyKeyframeNormals;
+ogle::KeyframeNormals FrustumKeyframeNormals;
+
+// scratch for anything that only lives until the end of the frame, reset by runloop()
+ogle::FrameArena FrameScratch;
+
+// --vertex-streams keeps the anatomy keyframes and mesh as aligned x/y/z streams
+bool UseVertexStreams = false;
+
+// --weld <tolerance> merges resident keyframe vertices closer than that (0 for exact copies),
+// worked out from the first keyframe and given to every one, before anything else sees them
+float WeldTolerance = -1;
+ogle::VertexWelder AnatomyWeld;
+ogle::VertexWelder FrustumWeld;
+
+// triangles and vertices of the resident keyframes go in vertex cache order, worked
+// out from the first keyframe and given to every one. --keep-mesh-order draws them as loaded
+bool OptimizeMeshOrder = true;
+ogle::MeshOptimizer AnatomyOrder;
+ogle::MeshOptimizer FrustumOrder;
+
+// the anatomy is drawn as the meshlets each pass can see, bounds follow the resident
+// keyframes (paged ones draw everything). --no-cluster-culling always draws everything
+bool ClusterCulling = true;
+ogle::MeshletSet AnatomyMeshlets;
+ogle::MeshletSet::Stats CollectCulling;     // last frame's, per pass
+ogle::MeshletSet::Stats ClipCulling;
+// clip space depth the probe frustum spans this frame, the clip pass discards anything outside it
+glm::vec2 ProbeDepthRange;
+
+// --lod <pixels> simplifies the resident anatomy keyframes into coarser index buffers on a
+// worker, then draws the coarsest one that stays within that many pixels of the full mesh
+float LodPixelError = 0;
+ogle::LodChain AnatomyLods;
+std::future<float> AnatomyLodBuild;     // milliseconds the build took
+bool AnatomyLodsReady = false;
+
+// the anatomy's obj groups are sub-meshes of its one vertex and index buffer, every pass picks
+// its structures by range. Valves (any with "valve" in the name, or named with --valves <group>)
+// go into the valve depth images instead of the cavity ones, the other passes draw everything
+std::vector<std::string> ValveNames;
+uint32_t CavityStructures = ~0u;    // sub-mesh masks, as in MeshletSet::CullView
+uint32_t ValveStructures = 0;
+
+// shift + click picks the point of the anatomy under the cursor and tells how far it is
+// from the pick before, for measuring. The triangle tree is built on the first pick and
+// refit to the anatomy's current positions on any pick after they moved
+ogle::TriangleBvh AnatomyBvh;
+bool AnatomyBvhStale = true;
+bool AnatomyPicked = false;
+glm::vec3 AnatomyPick;
+
+// the anatomy's cross section on the probe's central plane, what an echo machine images.
+// The plane is fit to the frustum at load and follows its travel and SpinRotationMatrix.
+// Each update() hands a copy of the positions it is about to draw to the slicer's own thread,
+// so slices never queue behind the loads or the lod build, and collects the lines (anatomy
+// space, ready to draw as line strips with the anatomy's model matrix) once they are done.
+// Frames that come while a slice is still running don't start another.
+ogle::PlaneSlicer AnatomySlicer;
+ogle::ThreadPool SliceWorker(1);
+std::future<void> AnatomySlice;
+std::vector<glm::vec3> AnatomySliceVerts;       // what the running slice reads
+ogle::VertexStreams AnatomySliceStreams;
+ogle::PlaneSlicer::Stats AnatomySliceStats = {};    // of the last slice collected
+glm::vec3 ProbePlaneNormal;     // frustum space
+
+// meshes are read on worker threads while the window and shaders get set up.
+// Drawing starts as soon as the first anatomy frame and the frustum are in,
+// the rest of the keyframes join the sequence from update() as they land.
+ogle::ThreadPool WorkerPool;
+std::vector<MeshBuffer> LoadingAnatomyFrames;
+std::vector<MeshBuffer> LoadingFrustumFrames;
+std::future<bool> AnatomyFrameLoads[AnatomyFrameCount];
+std::future<bool> FrustumFrameLoads[FrustumFrameCount];
+int AnatomyFramesCollected = 0;
+bool AnatomyKeyframesReady = false;
+
+const std::chrono::steady_clock::time_point LaunchTime = std::chrono::steady_clock::now();
+
 const glm::vec4 ColorGradient0(241/255.f, 219/255.f, 142/255.f, 1.f);
 const glm::vec4 ColorGradient1(45/255.f, 135/255.f, 219/255.f, 1.f);
 const glm::vec4 ColorMinimum(60/255.f, 14.f/255, 1.f/255.f, 1.f);
@@ -171,8 +282,16 @@ void cursorCallback(GLFWwindow* window, double x, double y)
     }
 }
 
+void pickAnatomy(double x, double y);
+
 void mouseCallback(GLFWwindow* window, int btn, int action, int mods)
 {
+    if (mods == GLFW_MOD_SHIFT && btn == GLFW_MOUSE_BUTTON_1 && action == GLFW_PRESS) {
+        double x,y;
+        glfwGetCursorPos(glfwWindow, &x, &y);
+        pickAnatomy(x, y);
+    }
+
     if (mods == GLFW_MOD_CONTROL){
         if (btn == GLFW_MOUSE_BUTTON_1) {
             if(action == GLFW_PRESS) {
@@ -257,28 +376,250 @@ void initGLAD(){
     glViewport( 0, 0, (GLsizei)width, (GLsizei)height );    
 }
 
+void parseOptions(int argc, char *argv[]){
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--keyframe-error" && i + 1 < argc)
+            KeyframeErrorBound = (float)atof(argv[++i]);
+        else if (arg == "--keyframe-budget" && i + 1 < argc)
+            KeyframeBudget = (size_t)(atof(argv[++i]) * 1024 * 1024);
+        else if (arg == "--vertex-streams")
+            UseVertexStreams = true;
+        else if (arg == "--smooth-normals")
+            AnatomyNormals.setMode(ogle::NormalEngine::AreaWeighted);
+        else if (arg == "--keep-mesh-order")
+            OptimizeMeshOrder = false;
+        else if (arg == "--no-cluster-culling")
+            ClusterCulling = false;
+        else if (arg == "--lod" && i + 1 < argc)
+            LodPixelError = (float)atof(argv[++i]);
+        else if (arg == "--weld" && i + 1 < argc)
+            WeldTolerance = (float)atof(argv[++i]);
+        else if (arg == "--valves" && i + 1 < argc)
+            ValveNames.push_back(argv[++i]);
+    }
+
+    // paged and quantized keyframes decode into vec3s
+    if (UseVertexStreams && (KeyframeBudget || KeyframeErrorBound > 0)) {
+        cerr << "[!] --vertex-streams only applies to resident float keyframes, ignoring it" << endl;
+        UseVertexStreams = false;
+    }
+    // paged keyframes come straight from the pack
+    if (WeldTolerance >= 0 && KeyframeBudget) {
+        cerr << "[!] --weld only applies to resident keyframes, ignoring it" << endl;
+        WeldTolerance = -1;
+    }
+}
+
 void setDataDir(int argc, char *argv[]){
     // get base directory for reading in files
 	DataDirectory = "../oit/data/";
 }
 
-void initFrustum(){
+std::string anatomyFrameFileName(int frame){
+    std::stringstream ss;
+    ss << setfill('0') << std::setw(2) << (frame + 1);
+    return DataDirectory + "Heart Interior Simple/Heart_Interior_withValves_v02_f" + ss.str() + ".obj";
+}
 
-    ogle::ObjLoader loaderA;
-    std::string fileNameA = DataDirectory + "Heart Interior Simple/3D_TEE_Frustum_MitralPosition.obj";
-    loaderA.load(fileNameA);
-    AnimatedFrustumFrames[0].setVerts(loaderA.getVertCount(), loaderA.getPositions());
-    AnimatedFrustumFrames[0].setIndices(loaderA.getIndexCount(), loaderA.getIndices());
+std::string frustumFrameFileName(int frame){
+    const char* names[FrustumFrameCount] = {
+        "3D_TEE_Frustum_MitralPosition.obj",
+        "3D_TEE_Frustum_TricuspidPosition.obj"
+    };
+    return DataDirectory + "Heart Interior Simple/" + names[frame];
+}
 
-    ogle::ObjLoader loaderB;
-    std::string fileNameB = DataDirectory + "Heart Interior Simple/3D_TEE_Frustum_TricuspidPosition.obj";
-    loaderB.load(fileNameB);
-    AnimatedFrustumFrames[1].setVerts(loaderB.getVertCount(), loaderB.getPositions());
-    AnimatedFrustumFrames[1].setIndices(loaderB.getIndexCount(), loaderB.getIndices());
+std::string anatomyPackFileName(){
+    return DataDirectory + "Heart Interior Simple/Heart_Interior_withValves_v02.keyframes";
+}
 
-    AnimatedFrustum = AnimatedFrustumFrames[0];
-    AnimatedFrustum.generateFaceNormals();
-    FrustumModel.init(AnimatedFrustum);
+// Encodes a sequence within KeyframeErrorBound and drops the float keyframes.
+void quantizeKeyframes(const char* name, ogle::MeshSequence& frames, ogle::QuantizedSequence& quantized){
+    if (KeyframeErrorBound <= 0 || frames.getFrameCnt() == 0)
+        return;
+
+    quantized.encode(frames, KeyframeErrorBound);
+    frames.clear();
+
+    const ogle::QuantizedSequence::Report& report = quantized.getReport();
+    cout << name << " keyframes: " << report.rawBytes << " -> " << report.encodedBytes << " bytes ("
+         << std::setprecision(3) << report.compressionRatio << "x), max error " << report.maxError
+         << " (bound " << report.errorBound << "), " << report.frames8Bit << " 8 bit / "
+         << report.frames16Bit << " 16 bit frames" << endl;
+}
+
+// Works out the normals of every keyframe, before the float keyframes get quantized away.
+void buildKeyframeNormals(const char* name, const ogle::MeshSequence& frames, ogle::NormalEngine& engine, ogle::KeyframeNormals& normals){
+    auto start = std::chrono::steady_clock::now();
+    normals.build(frames, engine, KeyframeErrorBound > 0 ? ogle::KeyframeNormals::QuantizedErrorBound : 0);
+    auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    cout << name << " keyframe normals: " << normals.getFrameCnt() << " frames, " << normals.getMemoryUsage()
+         << " bytes in " << took.count() << "ms" << endl;
+}
+
+// Works out which vertices of a sequence merge from its first keyframe, and what that saves
+// the vertex shader on every pass that draws it (in the order it was loaded).
+void buildWeld(const char* name, const MeshBuffer& firstFrame, ogle::VertexWelder& weld){
+    if (WeldTolerance < 0)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    weld.build(firstFrame, WeldTolerance);
+    auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    const ogle::VertexWelder::Report& report = weld.getReport();
+    ogle::MeshOptimizer::CacheStats before = ogle::MeshOptimizer::analyze(firstFrame.getIndices().data(), firstFrame.getIdxCnt(), firstFrame.getVertCnt());
+    ogle::MeshOptimizer::CacheStats after = ogle::MeshOptimizer::analyze(weld.getIndices().data(), (unsigned int)weld.getIndices().size(), weld.getVertCnt());
+    cout << name << " weld: " << report.vertsBefore << " -> " << report.vertsAfter << " vertices, "
+         << report.trianglesBefore << " -> " << report.trianglesAfter << " triangles, vertex shader runs per pass "
+         << before.transforms << " -> " << after.transforms << " in " << took.count() << "ms" << endl;
+}
+
+void weldFrame(const ogle::VertexWelder& weld, MeshBuffer& frame, const std::string& fileName){
+    if (WeldTolerance < 0)
+        return;
+
+    float drift = 0;
+    if (!weld.apply(frame, &drift))
+        cerr << "[!] Weld topology does not match: " << fileName << endl;
+    else if (drift > WeldTolerance)
+        cerr << "[!] Welded vertices are up to " << drift << " apart in: " << fileName << endl;
+}
+
+// Works out the vertex cache order of a sequence from its first keyframe.
+void buildMeshOrder(const char* name, const MeshBuffer& firstFrame, ogle::MeshOptimizer& order){
+    if (!OptimizeMeshOrder)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    order.build(firstFrame);
+    auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    const ogle::MeshOptimizer::Report& report = order.getReport();
+    cout << name << " vertex cache order: ACMR " << std::setprecision(3) << report.before.acmr << " -> " << report.after.acmr
+         << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << " (" << report.cacheSize
+         << " entry FIFO) in " << took.count() << "ms" << endl;
+}
+
+// Splits a sequence into meshlets, with bounds for every keyframe.
+void buildMeshlets(const char* name, const ogle::MeshSequence& frames, ogle::MeshletSet& meshlets){
+    if (!ClusterCulling)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    // quantized keyframes are drawn up to the error bound away from these
+    meshlets.build(frames, std::max(KeyframeErrorBound, 0.0f));
+    auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    cout << name << " meshlets: " << meshlets.getMeshletCnt() << " over " << meshlets.getFrameCnt()
+         << " keyframes in " << took.count() << "ms" << endl;
+}
+
+// Simplifies a copy of the keyframes on the worker pool, the levels get uploaded once it is done.
+void startBuildingLods(const ogle::MeshSequence& frames){
+    if (LodPixelError <= 0 || frames.getFrameCnt() == 0)
+        return;
+
+    std::shared_ptr<ogle::MeshSequence> copy(new ogle::MeshSequence(frames));
+    AnatomyLodBuild = WorkerPool.submit([copy]() {
+        auto start = std::chrono::steady_clock::now();
+        AnatomyLods.setPixelError(LodPixelError);
+        AnatomyLods.build(*copy);
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    });
+}
+
+// Uploads every level behind the full mesh once the build is in, the draw range then picks one.
+void collectLods(){
+    if (!AnatomyLodBuild.valid() || AnatomyLodBuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    float took = AnatomyLodBuild.get();
+    ArtModel.setIndices(AnatomyLods.getIndices().data(), (unsigned int)AnatomyLods.getIndices().size());
+    AnatomyLodsReady = true;
+
+    cout << "Anatomy LODs built in " << (int)took << "ms:" << endl;
+    for (unsigned int i = 0; i < AnatomyLods.getLevelCnt(); ++i) {
+        const ogle::LodChain::Level& level = AnatomyLods.getLevel(i);
+        cout << "\tLevel " << i << ": " << level.indexCount / 3 << " triangles, error " << level.error << endl;
+    }
+}
+
+// Queues every mesh file on the worker pool, each lands in its own slot of the frame arrays.
+void startLoadingMeshes(){
+    if (KeyframeBudget) {
+        // paged keyframes only need their pack to exist, it gets written one frame at a time
+        AnatomyPackBuild = WorkerPool.submit([]() {
+            std::vector<std::string> sourceFiles;
+            for (int i = 0; i < AnatomyFrameCount; ++i)
+                sourceFiles.push_back(anatomyFrameFileName(i));
+            return ogle::KeyframeStore::build(anatomyPackFileName(), sourceFiles);
+        });
+    }
+    else {
+        LoadingAnatomyFrames.resize(AnatomyFrameCount);
+        AnatomyFrameLoads[0] = WorkerPool.submit([]() {
+            return LoadingAnatomyFrames[0].loadFile(anatomyFrameFileName(0).c_str());
+        });
+    }
+
+    // the frustum goes ahead of the other keyframes, the first frame drawn needs it
+    LoadingFrustumFrames.resize(FrustumFrameCount);
+    for (int i = 0; i < FrustumFrameCount; ++i) {
+        FrustumFrameLoads[i] = WorkerPool.submit([i]() {
+            return LoadingFrustumFrames[i].loadFile(frustumFrameFileName(i).c_str());
+        });
+    }
+
+    if (!KeyframeBudget) {
+        for (int i = 1; i < AnatomyFrameCount; ++i) {
+            AnatomyFrameLoads[i] = WorkerPool.submit([i]() {
+                return LoadingAnatomyFrames[i].loadFile(anatomyFrameFileName(i).c_str());
+            });
+        }
+    }
+}
+
+float millisecondsSinceLaunch(){
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - LaunchTime).count();
+}
+
+// Moves loaded anatomy keyframes into the sequence in order. Blocks on the
+// first waitCount frames, past those it stops at the first one still loading.
+void collectAnatomyFrames(int waitCount){
+    for (; AnatomyFramesCollected < AnatomyFrameCount; ++AnatomyFramesCollected) {
+        int i = AnatomyFramesCollected;
+        std::future<bool>& load = AnatomyFrameLoads[i];
+        if (i >= waitCount && load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        if (!load.get()) {
+            cerr << "[!] Failed to load anatomy frame: " << anatomyFrameFileName(i) << endl;
+            continue;
+        }
+
+        if (i == 0)
+            buildWeld("Anatomy", LoadingAnatomyFrames[0], AnatomyWeld);
+        weldFrame(AnatomyWeld, LoadingAnatomyFrames[i], anatomyFrameFileName(i));
+        if (i == 0)
+            buildMeshOrder("Anatomy", LoadingAnatomyFrames[0], AnatomyOrder);
+        if (OptimizeMeshOrder)
+            AnatomyOrder.apply(LoadingAnatomyFrames[i]);
+        if (!AnimatedAnatomyFrames.addFrame(LoadingAnatomyFrames[i]))
+            cerr << "[!] Anatomy frame topology does not match: " << anatomyFrameFileName(i) << endl;
+    }
+
+    std::vector<MeshBuffer>().swap(LoadingAnatomyFrames);
+    AnatomyKeyframesReady = true;
+    cout << "All " << AnimatedAnatomyFrames.getFrameCnt() << " anatomy keyframes in after " << millisecondsSinceLaunch() << "ms" << endl;
+
+    buildKeyframeNormals("Anatomy", AnimatedAnatomyFrames, AnatomyNormals, AnatomyKeyframeNormals);
+    buildMeshlets("Anatomy", AnimatedAnatomyFrames, AnatomyMeshlets);
+    startBuildingLods(AnimatedAnatomyFrames);
+    quantizeKeyframes("Anatomy", AnimatedAnatomyFrames, QuantizedAnatomyFrames);
+}
+
+void initFrustum(){
 
     std::map<unsigned int, std::string> shaders;
     shaders[GL_VERTEX_SHADER] = DataDirectory + "diffuse.vert";
@@ -295,38 +636,110 @@ void initFrustum(){
 	shaders[GL_FRAGMENT_SHADER] = DataDirectory + "diffuseClipAgainstCavities.frag";
 	FrustumClipShader.init(shaders);
 
+    AnimatedFrustumFrames.reserve(FrustumFrameCount);
+    for (int i = 0; i < FrustumFrameCount; ++i) {
+        if (!FrustumFrameLoads[i].get()) {
+            cerr << "[!] Failed to load frustum: " << frustumFrameFileName(i) << endl;
+            continue;
+        }
+
+        if (i == 0)
+            buildWeld("Frustum", LoadingFrustumFrames[0], FrustumWeld);
+        weldFrame(FrustumWeld, LoadingFrustumFrames[i], frustumFrameFileName(i));
+        if (i == 0)
+            buildMeshOrder("Frustum", LoadingFrustumFrames[0], FrustumOrder);
+        if (OptimizeMeshOrder)
+            FrustumOrder.apply(LoadingFrustumFrames[i]);
+        if (!AnimatedFrustumFrames.addFrame(LoadingFrustumFrames[i]))
+            cerr << "[!] Frustum topology does not match: " << frustumFrameFileName(i) << endl;
+    }
+    std::vector<MeshBuffer>().swap(LoadingFrustumFrames);
+
+    AnimatedFrustumFrames.makeMesh(0, AnimatedFrustum);
+    glm::vec3 center;
+    ogle::PlaneSlicer::fitPlane(AnimatedFrustum.getVerts().data(), AnimatedFrustum.getVertCnt(), center, ProbePlaneNormal);
+    FrustumNormals.generate(AnimatedFrustum);
+    FrustumModel.setFrameArena(&FrameScratch);
+    FrustumModel.init(AnimatedFrustum);
+
     MeshObject objectTmp;
-    objectTmp.init(AnimatedFrustumFrames[1]);
+    objectTmp.computeBoundingBox(AnimatedFrustumFrames.getFrameView(AnimatedFrustumFrames.getFrameCnt() - 1));
     glm::vec3 start = FrustumModel.PivotPoint;
     glm::vec3 end = objectTmp.PivotPoint;
     glm::vec3 travelVector = (end - start) * 1.5f;
 
     SpinVector = glm::cross(travelVector, glm::vec3(0, 1, 0));
-}
 
-void initArt(){
-
-    //loader.load(DataDirectory + "art.obj");
-    for (int i = 0; i < AnatomyFrameCount; ++i) {
-        ogle::ObjLoader loader;
+    buildKeyframeNormals("Frustum", AnimatedFrustumFrames, FrustumNormals, FrustumKeyframeNormals);
+    quantizeKeyframes("Frustum", AnimatedFrustumFrames, QuantizedFrustumFrames);
+}
 
-        std::stringstream ss;
-        ss << setfill('0') << std::setw(2) << (i + 1);
-        std::string fileName = DataDirectory + "Heart Interior Simple/Heart_Interior_withValves_v02_f" + ss.str() + ".obj";
-        loader.load(fileName);
+// Lists the anatomy's structures and works out which pass each one goes to.
+void routeAnatomyStructures(){
+    const ogle::SubMeshList& structures = AnimatedAnatomy.getSubMeshes();
+    CavityStructures = ~0u;
+    ValveStructures = 0;
+    if (structures.empty())
+        return;
+    if (structures.size() > 32)
+        cerr << "[!] Only the first 32 anatomy structures can be routed, all " << structures.size() << " are cavities" << endl;
+
+    cout << "Anatomy structures:" << endl;
+    for (size_t i = 0; i < structures.size(); ++i) {
+        std::string lower = structures[i].name;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        bool valve = structures.size() <= 32 && (lower.find("valve") != std::string::npos
+            || std::find(ValveNames.begin(), ValveNames.end(), structures[i].name) != ValveNames.end());
+        if (valve) {
+            ValveStructures |= 1u << i;
+            CavityStructures &= ~(1u << i);
+        }
+        cout << "	" << structures[i].name << ": " << structures[i].indexCount / 3 << " triangles" << (valve ? ", valve" : "") << endl;
+    }
 
-        AnimatedAnatomyFrames[i].setVerts(loader.getVertCount(), loader.getPositions());
-        AnimatedAnatomyFrames[i].setIndices(loader.getIndexCount(), loader.getIndices());
+    for (size_t i = 0; i < ValveNames.size(); ++i) {
+        if (ogle::findSubMesh(structures, ValveNames[i]) < 0)
+            cerr << "[!] No anatomy structure called: " << ValveNames[i] << endl;
     }
-    AnimatedAnatomy = AnimatedAnatomyFrames[0];
-    AnimatedAnatomy.generateFaceNormals();
-    ArtModel.init(AnimatedAnatomy);
-    //ArtModel.updateBuffers(AnimatedAnatomy);
+}
+
+void initArt(){
 
     std::map<unsigned int, std::string> shaders;
     shaders[GL_VERTEX_SHADER] = DataDirectory + "diffuse.vert";
     shaders[GL_FRAGMENT_SHADER] = DataDirectory + "diffuse.frag";
     ArtShader.init(shaders);
+    ArtModel.setFrameArena(&FrameScratch);
+
+    //loader.load(DataDirectory + "art.obj");
+    if (KeyframeBudget) {
+        PagedAnatomyFrames.setMemoryBudget(KeyframeBudget);
+        if (!AnatomyPackBuild.get() || !PagedAnatomyFrames.open(anatomyPackFileName()))
+            cerr << "[!] Failed to page anatomy keyframes from: " << anatomyPackFileName() << endl;
+
+        PagedAnatomyFrames.makeMesh(0, AnimatedAnatomy);
+        AnatomyNormals.generate(AnimatedAnatomy);
+        ArtModel.init(AnimatedAnatomy);
+        routeAnatomyStructures();
+        AnatomySlicer.setTopology(AnimatedAnatomy);
+        AnatomyKeyframesReady = true;
+        return;
+    }
+
+    // only the first keyframe is needed to start drawing, it holds until the rest are in
+    if (UseVertexStreams)
+        AnimatedAnatomyFrames.setLayout(ogle::MeshSequence::FrameMajorStreams);
+    AnimatedAnatomyFrames.reserve(AnatomyFrameCount);
+    collectAnatomyFrames(1);
+
+    AnimatedAnatomyFrames.makeMesh(0, AnimatedAnatomy);
+    if (UseVertexStreams)
+        AnimatedAnatomy.setVertexLayout(MeshBuffer::StructOfArrays);
+    AnatomyNormals.generate(AnimatedAnatomy);
+    ArtModel.init(AnimatedAnatomy);
+    routeAnatomyStructures();
+    AnatomySlicer.setTopology(AnimatedAnatomy);
+    //ArtModel.updateBuffers(AnimatedAnatomy);
 }
 
 void initCollectDepths() {
@@ -352,6 +765,7 @@ void initClipAgainstFrustum() {
 
 void initView(){
     float fovy = glm::radians(30.f);
+    FieldOfViewY = fovy;
     Projection = glm::perspective<float>(fovy, WINDOW_WIDTH/(float)WINDOW_HEIGHT, 0.1f, 1000.0f );
 
     auto& model = FrustumModel;
@@ -471,17 +885,16 @@ void initSceneFrustumMatrices()
 }
 
 void init(int argc, char* argv[]){
+    parseOptions(argc, argv);
     setDataDir(argc, argv);
+    startLoadingMeshes();
+
     initGLFW();
     initGLAD();
     ogle::Debug::init();
 
 	initSceneFrustumMatrices();
 
-    initArt();
-    initFrustum();
-    initView();
-
     createTextures();
     createFrambuffer();
 
@@ -490,36 +903,207 @@ void init(int argc, char* argv[]){
     initCollectDepths();
     initSortDepths();
     initClipAgainstFrustum();
+
+    // these wait on the mesh loads, so they go after everything that doesn't need them
+    initArt();
+    initFrustum();
+    initView();
+}
+
+// What the vertex shaders do to a mesh turned by rotation about MoveToOrigin, as one matrix.
+glm::mat4 modelMatrix(const glm::mat4& rotation){
+    glm::vec3 pivot(MoveToOrigin);
+    glm::mat4 model = rotation;
+    model[3] = glm::vec4(pivot - glm::vec3(rotation * glm::vec4(pivot, 0)), 1);
+    return model;
+}
+
+// Smallest and largest clip space z of a mesh's vertices, the Depth the shaders pass on.
+glm::vec2 clipDepthRange(const MeshBuffer& mesh, const glm::mat4& modelViewProjection){
+    glm::vec4 depthRow(modelViewProjection[0][2], modelViewProjection[1][2], modelViewProjection[2][2], modelViewProjection[3][2]);
+    const std::vector<glm::vec3>& verts = mesh.getVerts();
+    glm::vec2 range(9e23f, -9e23f);
+    for (size_t i = 0; i < verts.size(); ++i) {
+        float depth = glm::dot(depthRow, glm::vec4(verts[i], 1));
+        range.x = std::min(range.x, depth);
+        range.y = std::max(range.y, depth);
+    }
+    return range;
+}
+
+ogle::MeshletSet::CullView anatomyCullView(){
+    glm::mat4 model = modelMatrix(RotationMatrix);
+    ogle::MeshletSet::CullView view;
+    view.modelViewProjection = ProjectionView * model;
+    view.eye = glm::vec3(glm::inverse(model) * glm::vec4(CameraPosition, 1));
+    return view;
+}
+
+// Pixels one unit of the anatomy covers where its bounds come closest to the camera.
+float anatomyPixelsPerUnit(){
+    glm::vec3 center(modelMatrix(RotationMatrix) * glm::vec4(ArtModel.PivotPoint, 1));
+    float radius = glm::length(ArtModel.AABBMax - ArtModel.AABBMin) * .5f;
+    float distance = std::max(glm::length(CameraPosition - center) - radius, .1f);
+    return WINDOW_HEIGHT / (2 * distance * tan(FieldOfViewY * .5f));
+}
+
+// Draws the anatomy's structures in mask, each a range of the level of detail being drawn.
+void renderAnatomyStructures(uint32_t mask){
+    const ogle::SubMeshList& structures = AnatomyLodsReady ? AnatomyLods.getSubMeshes(AnatomyLods.getCurrentLevel())
+                                                           : AnimatedAnatomy.getSubMeshes();
+    if (mask == ~0u || structures.empty()) {
+        ArtModel.render();
+        return;
+    }
+
+    unsigned int* starts = FrameScratch.allocate<unsigned int>(structures.size());
+    unsigned int* counts = FrameScratch.allocate<unsigned int>(structures.size());
+    unsigned int ranges = 0;
+    for (size_t i = 0; i < structures.size() && i < 32; ++i) {
+        if (!(mask & (1u << i)) || structures[i].indexCount == 0)
+            continue;
+        if (ranges && starts[ranges - 1] + counts[ranges - 1] == structures[i].indexStart) {
+            counts[ranges - 1] += structures[i].indexCount;
+        }
+        else {
+            starts[ranges] = structures[i].indexStart;
+            counts[ranges] = structures[i].indexCount;
+            ++ranges;
+        }
+    }
+    ArtModel.render(starts, counts, ranges);
+}
+
+// Draws the meshlets of the anatomy that view can see, the structures in its mask when there
+// are none. Meshlets only cover the full mesh, coarser levels are drawn by structure.
+void renderAnatomy(const ogle::MeshletSet::CullView& view, ogle::MeshletSet::Stats* stats = 0){
+    unsigned int meshlets = AnatomyMeshlets.getMeshletCnt();
+    if (!ClusterCulling || meshlets == 0 || (AnatomyLodsReady && AnatomyLods.getCurrentLevel() != 0)) {
+        renderAnatomyStructures(view.subMeshMask);
+        return;
+    }
+
+    unsigned int* starts = FrameScratch.allocate<unsigned int>(meshlets);
+    unsigned int* counts = FrameScratch.allocate<unsigned int>(meshlets);
+    unsigned int ranges = AnatomyMeshlets.cull(view, starts, counts);
+    ArtModel.render(starts, counts, ranges);
+    if (stats)
+        *stats = AnatomyMeshlets.getStats();
+}
+
+// Runs the cursor's ray, from the near to the far plane, into the anatomy as it was last
+// drawn. Everything happens in the anatomy's own space, which the model matrix only turns
+// about the pivot, so distances there are the ones on screen.
+void pickAnatomy(double x, double y){
+    auto start = std::chrono::steady_clock::now();
+    if (AnatomyBvh.getTriangleCnt() == 0) {
+        AnatomyBvh.build(AnimatedAnatomy);
+        cout << "Anatomy BVH: " << AnatomyBvh.getTriangleCnt() << " triangles in " << AnatomyBvh.getNodeCnt()
+             << " nodes, " << AnatomyBvh.getMemoryUsage() << " bytes" << endl;
+    }
+    else if (AnatomyBvhStale) {
+        AnatomyBvh.refit(AnimatedAnatomy);
+    }
+    AnatomyBvhStale = false;
+
+    int width, height;
+    glfwGetWindowSize(glfwWindow, &width, &height);
+    glm::vec2 ndc(2 * float(x) / width - 1, 1 - 2 * float(y) / height);
+    glm::mat4 toObject = glm::inverse(ProjectionView * modelMatrix(RotationMatrix));
+    glm::vec4 nearPoint = toObject * glm::vec4(ndc.x, ndc.y, -1, 1);
+    glm::vec4 farPoint = toObject * glm::vec4(ndc.x, ndc.y, 1, 1);
+    glm::vec3 from = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 to = glm::vec3(farPoint) / farPoint.w;
+
+    ogle::TriangleBvh::Hit hit;
+    bool found = AnatomyBvh.intersectSegment(from, to, hit);
+    float micros = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+    if (!found) {
+        cout << "Nothing of the anatomy under the cursor (" << micros << "us)" << endl;
+        return;
+    }
+
+    glm::vec3 point = from + (to - from) * hit.t;
+    cout << "Picked the anatomy at " << glm::to_string(point) << " on triangle " << hit.triangle;
+    int structure = ogle::findSubMesh(AnimatedAnatomy.getSubMeshes(), hit.triangle);
+    if (structure >= 0)
+        cout << " of " << AnimatedAnatomy.getSubMeshes()[structure].name;
+    if (AnatomyPicked)
+        cout << ", " << glm::distance(AnatomyPick, point) << " from the last pick";
+    cout << " (" << micros << "us)" << endl;
+    AnatomyPick = point;
+    AnatomyPicked = true;
+}
+
+// The probe's central plane in the anatomy's space, through the middle of the frustum
+// as it is this frame and turned by the spin about the pivot.
+bool probePlane(glm::vec3& point, glm::vec3& normal){
+    const std::vector<glm::vec3>& verts = AnimatedFrustum.getVerts();
+    if (verts.empty())
+        return false;
+    point = glm::vec3(0);
+    for (size_t i = 0; i < verts.size(); ++i)
+        point += verts[i];
+    point /= float(verts.size());
+
+    glm::mat4 spin = modelMatrix(SpinRotationMatrix);
+    point = glm::vec3(spin * glm::vec4(point, 1));
+    normal = glm::vec3(spin * glm::vec4(ProbePlaneNormal, 0));
+    return true;
 }
 
 void update(){
     ProjectionView = Projection * Camera;
 
+    // a slice reads its own copy of the anatomy, one that isn't done yet is left running
+    if (AnatomySlice.valid() && AnatomySlice.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        AnatomySlice.get();
+        AnatomySliceStats = AnatomySlicer.getStats();
+    }
+
     float colorCenter = glm::length(glm::vec3(MoveToOrigin) - CameraPosition);
     ColorDepthRange = glm::vec2(colorCenter - 25, colorCenter + 25);
 
-    static std::vector<float> deltas;
     static float sum_deltas = 0;
+    static int delta_count = 0;
 
     float deltaTime = (float)glfwGetTime(); // get's the amount of time since last setTime
-    deltas.push_back(deltaTime);
     sum_deltas += deltaTime;
+    ++delta_count;
 
     glfwSetTime(0);
 
     if (sum_deltas > .5f) {
+        float ave = sum_deltas / delta_count;
         sum_deltas = 0;
-
-        float ave = 0;
-        for (auto& d: deltas){
-            ave += d;
-        }
-        ave /= deltas.size();
-        deltas.clear();
+        delta_count = 0;
 
     	int fps = int(1 / ave);
     	float milliseconds = ave * 1000.f;
-    	string title = "OIT - FPS (" + std::to_string(fps) + ") / " + std::to_string(milliseconds) + "ms";
+        ogle::FrameString title("OIT - FPS (", ogle::FrameAllocator<char>(FrameScratch));
+        title += std::to_string(fps).c_str();
+        title += ") / ";
+        title += std::to_string(milliseconds).c_str();
+        title += "ms";
+        if (AnatomyMeshlets.getMeshletCnt()) {
+            title += " - meshlets drawn ";
+            title += std::to_string(CollectCulling.drawn).c_str();
+            title += " collect / ";
+            title += std::to_string(ClipCulling.drawn).c_str();
+            title += " clip of ";
+            title += std::to_string(AnatomyMeshlets.getMeshletCnt()).c_str();
+        }
+        if (AnatomySliceStats.polylines) {
+            title += " - slice ";
+            title += std::to_string(AnatomySliceStats.polylines).c_str();
+            title += " lines / ";
+            title += std::to_string(AnatomySliceStats.points).c_str();
+            title += " points";
+        }
+        if (AnatomyLodsReady) {
+            title += " - lod ";
+            title += std::to_string(AnatomyLods.getCurrentLevel()).c_str();
+        }
         glfwSetWindowTitle(glfwWindow, title.c_str());
     }
 
@@ -533,49 +1117,80 @@ void update(){
             FrustumAnimationValue += deltaTime * AnimationModifier;
         }
 
-        const std::vector<glm::vec3>& vertsA = AnimatedFrustumFrames[0].getVerts();
-        const std::vector<glm::vec3>& vertsB = AnimatedFrustumFrames[1].getVerts();
-
-        size_t count = vertsA.size();
-        std::vector<glm::vec3> animatedVerts(count);
-        for (size_t i = 0; i < count; ++i) {
-            animatedVerts[i] = percent * (vertsB[i] - vertsA[i]) + vertsA[i];
-        }
-        AnimatedFrustum.setVerts(count, (const float*)animatedVerts.data());
-        AnimatedFrustum.generateFaceNormals();
+        // blend straight into the mesh, nothing is allocated or copied per frame
+        glm::vec3* animatedVerts = AnimatedFrustum.getWritableVerts();
+        if (QuantizedFrustumFrames.getFrameCnt())
+            QuantizedFrustumFrames.sample(percent, false, animatedVerts);
+        else
+            AnimatedFrustumFrames.sample(percent, false, animatedVerts);
+        FrustumKeyframeNormals.sample(percent, false, AnimatedFrustum.getWritableNorms());
         FrustumModel.updateBuffers(AnimatedFrustum);
     }
 
     FrustumMatrix = RotationMatrix * SpinRotationMatrix;
+    ProbeDepthRange = clipDepthRange(AnimatedFrustum, ProjectionView * modelMatrix(FrustumMatrix));
 
-    // animate anatomy
-    {
+    if (!AnatomyKeyframesReady)
+        collectAnatomyFrames(0);
+
+    // animate anatomy, a static pose until every keyframe is in
+    if (AnatomyKeyframesReady) {
         AnimatedAnatomyCurrent += deltaTime;
         AnimatedAnatomyCurrent = std::fmod(AnimatedAnatomyCurrent, AnimatedAnatomyDuration);
         float percent = AnimatedAnatomyCurrent / AnimatedAnatomyDuration;
 
-        float frame = percent * (AnatomyFrameCount - 1);
-
-        float fframeA;
-        float tween = modf(frame, &fframeA);
-
-        int frameA = int(fframeA);
-        int frameB = (frameA + 1) % int(AnatomyFrameCount);
-
-        MeshBuffer meshA = AnimatedAnatomyFrames[frameA];
-        MeshBuffer meshB = AnimatedAnatomyFrames[frameB];
-
-        const std::vector<glm::vec3>& vertsA = meshA.getVerts();
-        const std::vector<glm::vec3>& vertsB = meshB.getVerts();
- 
-        size_t count = vertsA.size();
-        std::vector<glm::vec3> animatedVerts(count);
-        for (size_t i = 0; i < count; ++i) {
-            animatedVerts[i] = tween * (vertsB[i] - vertsA[i]) + vertsA[i];
+        bool streams = AnimatedAnatomy.getVertexLayout() == MeshBuffer::StructOfArrays;
+        if (PagedAnatomyFrames.getFrameCnt()) {
+            float frame = percent * (PagedAnatomyFrames.getFrameCnt() - 1);
+            PagedAnatomyFrames.setPlayhead(frame, true);
+            PagedAnatomyFrames.sample(frame, true, AnimatedAnatomy.getWritableVerts());
+            AnatomyNormals.generate(AnimatedAnatomy);
+        }
+        else {
+            // the playhead runs over the frames of whichever sequence the positions come from
+            bool quantized = !streams && QuantizedAnatomyFrames.getFrameCnt();
+            float frame = percent * ((quantized ? QuantizedAnatomyFrames.getFrameCnt() : AnimatedAnatomyFrames.getFrameCnt()) - 1);
+            if (streams)
+                AnimatedAnatomyFrames.sample(frame, true, AnimatedAnatomy.getWritableVertStreams());
+            else if (quantized)
+                QuantizedAnatomyFrames.sample(frame, true, AnimatedAnatomy.getWritableVerts());
+            else
+                AnimatedAnatomyFrames.sample(frame, true, AnimatedAnatomy.getWritableVerts());
+
+            if (AnatomyKeyframeNormals.getFrameCnt() == 0)
+                AnatomyNormals.generate(AnimatedAnatomy);
+            else if (streams)
+                AnatomyKeyframeNormals.sample(frame, true, AnimatedAnatomy.getWritableNormStreams());
+            else
+                AnatomyKeyframeNormals.sample(frame, true, AnimatedAnatomy.getWritableNorms());
+            AnatomyMeshlets.setFrame(frame, true);
         }
-        AnimatedAnatomy.setVerts(count, (const float*)animatedVerts.data());
-        AnimatedAnatomy.generateFaceNormals();
         ArtModel.updateBuffers(AnimatedAnatomy);
+        AnatomyBvhStale = true;
+    }
+
+    glm::vec3 planePoint, planeNormal;
+    if (!AnatomySlice.valid() && probePlane(planePoint, planeNormal)) {
+        // copies into storage kept from the last slice, nothing is allocated once it is sized
+        bool streams = AnimatedAnatomy.getVertexLayout() == MeshBuffer::StructOfArrays;
+        if (streams)
+            AnatomySliceStreams = AnimatedAnatomy.getVertStreams();
+        else
+            AnatomySliceVerts.assign(AnimatedAnatomy.getVerts().begin(), AnimatedAnatomy.getVerts().end());
+        AnatomySlice = SliceWorker.submit([planePoint, planeNormal, streams]() {
+            if (streams)
+                AnatomySlicer.slice(AnatomySliceStreams, planePoint, planeNormal);
+            else
+                AnatomySlicer.slice(AnatomySliceVerts.data(), planePoint, planeNormal);
+        });
+    }
+
+    if (!AnatomyLodsReady)
+        collectLods();
+    if (AnatomyLodsReady) {
+        const ogle::LodChain::Level& level = AnatomyLods.getLevel(AnatomyLods.select(anatomyPixelsPerUnit()));
+        ArtModel.IndexRangeStart = level.indexStart;
+        ArtModel.IndexRangeEnd = level.indexCount;
     }
 }
 
@@ -600,7 +1215,10 @@ void renderArtModelDiffuse(){
     
     auto color = glm::vec4(.5f,0,0,.5);
     ArtShader.setVec4((const float*)&color, "Color");
-    ArtModel.render();
+
+    ogle::MeshletSet::CullView view = anatomyCullView();
+    view.backFaces = true;
+    renderAnatomy(view);
 }
 
 void renderFrustumToFrameBuffer() {
@@ -637,7 +1255,18 @@ void renderCavitiesToImages() {
     CollectDepthsShader.setMatrix44((const float*)&ProjectionView, "ProjectionView");
 
     //VenousModel.render();
-    ArtModel.render();
+    // faces aren't culled here, every layer counts
+    ogle::MeshletSet::CullView view = anatomyCullView();
+    view.subMeshMask = CavityStructures;
+    renderAnatomy(view, &CollectCulling);
+
+    // valves are layered into their own images, out of the same buffers
+    if (ValveStructures) {
+        CollectDepthsShader.setInt(3, "CavityVolume");
+        CollectDepthsShader.setInt(4, "Counter");
+        view.subMeshMask = ValveStructures;
+        renderAnatomy(view);
+    }
 
     glDepthMask(GL_TRUE);
     glEnable(GL_DEPTH_TEST);
@@ -690,6 +1319,12 @@ void sortCavityDepths() {
     SortDepthsShader.setInt(1, "CavityVolume");
     SortDepthsShader.setInt(2, "Counter");
     Quad.render();    
+
+    if (ValveStructures) {
+        SortDepthsShader.setInt(3, "CavityVolume");
+        SortDepthsShader.setInt(4, "Counter");
+        Quad.render();
+    }
 }
 
 void renderAndClipFrustum() {
@@ -742,7 +1377,13 @@ void renderAndClipCavities() {
     auto res = glm::vec2(WINDOW_WIDTH, WINDOW_HEIGHT);
     CavityClipShader.setVec2((const float*)&res, "Resolution");
     // VenousModel.render();
-    ArtModel.render();
+    // back faces are culled, and only what is in the probe's depth range survives the clip
+    ogle::MeshletSet::CullView view = anatomyCullView();
+    view.backFaces = true;
+    view.depthRange = true;
+    view.minDepth = ProbeDepthRange.x;
+    view.maxDepth = ProbeDepthRange.y;
+    renderAnatomy(view, &ClipCulling);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -773,15 +1414,38 @@ void render(){
 
 void runloop(){
     glfwSetTime(0); // init timer
+    bool firstFrame = true;
     while (!glfwWindowShouldClose(glfwWindow)){
         glfwPollEvents();
         update();
         render();
         glfwSwapBuffers(glfwWindow);
+        FrameScratch.reset();
+
+        if (firstFrame) {
+            firstFrame = false;
+            cout << "Time to first frame: " << millisecondsSinceLaunch() << "ms" << endl;
+        }
     }
 }
 
 void shutdown(){
+    if (AnatomySlice.valid())
+        AnatomySlice.get();
+
+    ogle::FrameArena::Stats scratch = FrameScratch.getStats();
+    cout << "Frame scratch: " << scratch.allocations << " allocations over " << scratch.frames << " frames ("
+         << scratch.frameAllocations << " last frame), high water " << scratch.highWater << " of " << scratch.capacity
+         << " bytes, " << scratch.overflowAllocations << " spilled to the heap" << endl;
+
+    if (PagedAnatomyFrames.getFrameCnt()) {
+        ogle::KeyframeStore::Stats stats = PagedAnatomyFrames.getStats();
+        cout << "Paged keyframes: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.waits << " waits, "
+             << stats.prefetches << " prefetches, " << stats.evictions << " evictions, "
+             << stats.residentFrames << " frames (" << stats.residentBytes << " bytes) resident" << endl;
+        PagedAnatomyFrames.close();
+    }
+
     FrustumClipShader.shutdown();
     CavityClipShader.shutdown();
 
@@ -0,0 +1,231 @@
+// Counts heap allocations over the per-frame animation path: sampling the
+// keyframe sources into the mesh, face normals, and the vertex upload. Once
+// warm every one of them is expected to make none.
+//
+// There is no GL context, the entry points MeshObject uses are stubbed out.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "../common/meshbuffer.h"
+#include "../common/meshobject.h"
+#include "../common/meshsequence.h"
+#include "../common/quantizedsequence.h"
+#include "../common/keyframestore.h"
+#include "../common/meshcache.h"
+#include "../common/framearena.h"
+
+static std::atomic<size_t> Allocations(0);
+
+void* operator new(size_t bytes)
+{
+    ++Allocations;
+    void* p = malloc(bytes ? bytes : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t bytes)
+{
+    return operator new(bytes);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    const unsigned int GridSize = 64;
+    const unsigned int FrameCnt = 12;
+    const int WarmFrames = 100;
+    const int CountedFrames = 1000;
+
+    // gl stubs, names are handed out but nothing is kept
+    void APIENTRY genNames(GLsizei n, GLuint* names) { for (GLsizei i = 0; i < n; ++i) names[i] = (GLuint)i + 1; }
+    void APIENTRY deleteNames(GLsizei, const GLuint*) {}
+    void APIENTRY bindVertexArray(GLuint) {}
+    void APIENTRY bindBuffer(GLenum, GLuint) {}
+    void APIENTRY bufferData(GLenum, GLsizeiptr, const void*, GLenum) {}
+    void APIENTRY bufferSubData(GLenum, GLintptr, GLsizeiptr, const void*) {}
+    void APIENTRY vertexAttribArray(GLuint) {}
+    void APIENTRY vertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) {}
+
+    void stubGl()
+    {
+        glad_glGenVertexArrays = genNames;
+        glad_glGenBuffers = genNames;
+        glad_glDeleteVertexArrays = deleteNames;
+        glad_glDeleteBuffers = deleteNames;
+        glad_glBindVertexArray = bindVertexArray;
+        glad_glBindBuffer = bindBuffer;
+        glad_glBufferData = bufferData;
+        glad_glBufferSubData = bufferSubData;
+        glad_glEnableVertexAttribArray = vertexAttribArray;
+        glad_glDisableVertexAttribArray = vertexAttribArray;
+        glad_glVertexAttribPointer = vertexAttribPointer;
+    }
+
+    // A rippling grid, every frame has the same triangles.
+    void makeFrame(unsigned int frame, MeshBuffer& mesh)
+    {
+        std::vector<glm::vec3> verts;
+        std::vector<uint32_t> indices;
+        float phase = 6.2831853f * frame / FrameCnt;
+        for (unsigned int y = 0; y < GridSize; ++y) {
+            for (unsigned int x = 0; x < GridSize; ++x)
+                verts.push_back(glm::vec3((float)x, (float)y, std::sin(phase + 0.3f * x) * std::cos(0.2f * y)));
+        }
+        for (unsigned int y = 0; y + 1 < GridSize; ++y) {
+            for (unsigned int x = 0; x + 1 < GridSize; ++x) {
+                uint32_t v = y * GridSize + x;
+                uint32_t quad[6] = { v, v + 1, v + GridSize, v + 1, v + GridSize + 1, v + GridSize };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        mesh.setVerts(std::move(verts));
+        mesh.setIndices(std::move(indices));
+    }
+
+    bool writeObj(const std::string& fileName, const MeshBuffer& mesh)
+    {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file)
+            return false;
+        const std::vector<glm::vec3>& verts = mesh.getVerts();
+        const std::vector<uint32_t>& indices = mesh.getIndices();
+        for (size_t i = 0; i < verts.size(); ++i)
+            fprintf(file, "v %.9g %.9g %.9g\n", verts[i].x, verts[i].y, verts[i].z);
+        for (size_t i = 0; i < indices.size(); i += 3)
+            fprintf(file, "f %u %u %u\n", indices[i] + 1, indices[i + 1] + 1, indices[i + 2] + 1);
+        fclose(file);
+        return true;
+    }
+
+    // Runs frameStep through a warm up and then counts what the counted frames allocate.
+    bool check(const char* name, const std::function<void(float)>& frameStep, bool paged = false)
+    {
+        float playhead = 0;
+        auto step = [&]() {
+            playhead = std::fmod(playhead + 0.013f, 1.f);
+            frameStep(playhead * (FrameCnt - 1));
+            // gives the prefetch thread a chance to keep up, as a frame would
+            if (paged)
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        };
+
+        for (int i = 0; i < WarmFrames; ++i)
+            step();
+        size_t before = Allocations;
+        for (int i = 0; i < CountedFrames; ++i)
+            step();
+        size_t made = Allocations - before;
+
+        printf("%-28s %zu allocations over %d frames\n", name, made, CountedFrames);
+        return made == 0;
+    }
+}
+
+int main()
+{
+    stubGl();
+
+    ogle::MeshSequence sequence;
+    std::vector<std::string> sources;
+    for (unsigned int f = 0; f < FrameCnt; ++f) {
+        MeshBuffer frame;
+        makeFrame(f, frame);
+        sequence.addFrame(frame);
+
+        char name[64];
+        snprintf(name, sizeof(name), "allocations_f%02u.obj", f);
+        if (!writeObj(name, frame)) {
+            fprintf(stderr, "[!] Couldn't write %s\n", name);
+            return 1;
+        }
+        sources.push_back(name);
+    }
+
+    ogle::QuantizedSequence quantized;
+    quantized.encode(sequence, 0.001f);
+
+    // room for a few frames only, so playback keeps paging
+    const std::string packFile = "allocations.keyframes";
+    ogle::KeyframeStore paged;
+    paged.setMemoryBudget(4 * (size_t)GridSize * GridSize * sizeof(glm::vec3));
+    if (!ogle::KeyframeStore::build(packFile, sources) || !paged.open(packFile)) {
+        fprintf(stderr, "[!] Couldn't build the keyframe pack\n");
+        return 1;
+    }
+
+    ogle::FrameArena arena;
+    MeshBuffer mesh;
+    sequence.makeMesh(0, mesh);
+    mesh.generateFaceNormals();
+    MeshObject model;
+    model.setFrameArena(&arena);
+    model.init(mesh);
+
+    MeshBuffer streamMesh;
+    streamMesh.setVertexLayout(MeshBuffer::StructOfArrays);
+    sequence.makeMesh(0, streamMesh);
+    streamMesh.generateFaceNormals();
+    MeshObject streamModel;
+    streamModel.setFrameArena(&arena);
+    streamModel.init(streamMesh);
+
+    bool passed = true;
+    passed &= check("MeshSequence", [&](float frame) {
+        arena.reset();
+        sequence.sample(frame, true, mesh.getWritableVerts());
+        mesh.generateFaceNormals();
+        model.updateBuffers(mesh);
+    });
+    passed &= check("MeshSequence, streams", [&](float frame) {
+        arena.reset();
+        sequence.sample(frame, true, streamMesh.getWritableVertStreams());
+        streamMesh.generateFaceNormals();
+        streamModel.updateBuffers(streamMesh);
+    });
+    passed &= check("QuantizedSequence", [&](float frame) {
+        arena.reset();
+        quantized.sample(frame, true, mesh.getWritableVerts());
+        mesh.generateFaceNormals();
+        model.updateBuffers(mesh);
+    });
+    passed &= check("KeyframeStore", [&](float frame) {
+        arena.reset();
+        paged.setPlayhead(frame, true);
+        paged.sample(frame, true, mesh.getWritableVerts());
+        mesh.generateFaceNormals();
+        model.updateBuffers(mesh);
+    }, true);
+
+    paged.close();
+    remove(packFile.c_str());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        remove(ogle::MeshCache::cacheFileName(sources[i]).c_str());
+        remove(sources[i].c_str());
+    }
+
+    if (!passed)
+        fprintf(stderr, "[!] The animation path allocated once warm\n");
+    return passed ? 0 : 1;
+}